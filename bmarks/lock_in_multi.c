@@ -0,0 +1,376 @@
+/*
+ * File: lock_in_multi.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The driver of the multi-algorithm benchmark binaries (make <bmark>_multi):
+ *      the benchmark is compiled once per algorithm of MULTI_LOCKS, with its main
+ *      renamed to lock_in_main_<LOCK> (and its other symbols made local), so that
+ *      every algorithm gets its own copy of the timed loop, without indirections.
+ *
+ *        stress_test_in_multi --lock=MCS[,TICKET,...|all] [--format=text|csv|json]
+ *                             [benchmark options...]
+ *        stress_test_in_multi --list
+ *
+ *      Each algorithm runs in its own process. With csv/json, the #name : value
+ *      lines of the benchmark output become the columns of one row per algorithm.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <ctype.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#if !defined(LOCK_IN_MULTI_BENCH) || !defined(LOCK_IN_MULTI_LOCKS)
+#  error build with make <bmark>_multi
+#endif
+
+#define MULTI_MAX_FIELDS 128
+#define MULTI_KEY_LEN    64
+
+enum { FORMAT_TEXT, FORMAT_CSV, FORMAT_JSON };
+
+typedef int (*lock_in_main_t)(int argc, char** argv);
+
+#define X(l) int lock_in_main_##l(int argc, char** argv);
+LOCK_IN_MULTI_LOCKS
+#undef X
+
+typedef struct multi_lock
+{
+  const char* name;
+  lock_in_main_t main;
+} multi_lock_t;
+
+static const multi_lock_t multi_locks[] =
+  {
+#define X(l) { #l, lock_in_main_##l },
+    LOCK_IN_MULTI_LOCKS
+#undef X
+  };
+#define MULTI_NUM_LOCKS (sizeof(multi_locks) / sizeof(multi_locks[0]))
+
+typedef struct field
+{
+  char key[MULTI_KEY_LEN];
+  char val[32];
+} field_t;
+
+static char header[MULTI_MAX_FIELDS][MULTI_KEY_LEN];
+static int header_n = -1;
+
+static void
+usage(const char* prog)
+{
+  printf("%s: %s with all of the following algorithms compiled in\n", prog, LOCK_IN_MULTI_BENCH);
+  printf("Usage: %s --lock=LOCK[,LOCK...|all] [--format=text|csv|json] [%s options...]\n",
+	 prog, LOCK_IN_MULTI_BENCH);
+  printf("       %s --list\n", prog);
+  printf("Locks:");
+  size_t i;
+  for (i = 0; i < MULTI_NUM_LOCKS; i++)
+    {
+      printf(" %s", multi_locks[i].name);
+    }
+  printf("\n");
+}
+
+static const multi_lock_t*
+multi_find(const char* name)
+{
+  size_t i;
+  for (i = 0; i < MULTI_NUM_LOCKS; i++)
+    {
+      if (strcasecmp(name, multi_locks[i].name) == 0)
+	{
+	  return multi_locks + i;
+	}
+    }
+  return NULL;
+}
+
+/* "ppw (ops/W)" -> "ppw_ops_w" */
+static void
+key_clean(char* dst, const char* src, size_t len)
+{
+  size_t n = 0;
+  int sep = 0;
+  for (; *src && n < len - 1; src++)
+    {
+      if (isalnum((unsigned char) *src))
+	{
+	  if (sep && n > 0 && n < len - 2)
+	    {
+	      dst[n++] = '_';
+	    }
+	  dst[n++] = tolower((unsigned char) *src);
+	  sep = 0;
+	}
+      else
+	{
+	  sep = 1;
+	}
+    }
+  dst[n] = '\0';
+}
+
+/* the numbers of a "#name : value ..." line: they are named after the word
+   before them ("p99 123" -> name_p99), a
+   following "/ s" (name_per_s) or "%" (name_pct), or else their position
+   (name, name_1, ...) */
+static int
+parse_line(char* line, field_t* fields, int n)
+{
+  if (line[0] != '#' || line[1] == '#')
+    {
+      return n;
+    }
+  char* colon = strchr(line, ':');
+  if (colon == NULL)
+    {
+      return n;
+    }
+  *colon = '\0';
+  char key[MULTI_KEY_LEN / 2];
+  key_clean(key, line + 1, sizeof(key));
+
+  char* word = NULL;
+  int num = 0;
+  char* save;
+  char* tok = strtok_r(colon + 1, " \t\n()|=,", &save);
+  while (tok != NULL && n < MULTI_MAX_FIELDS)
+    {
+      char* end;
+      strtod(tok, &end);
+      if (end == tok)
+	{
+	  word = isalpha((unsigned char) tok[0]) ? tok : NULL;
+	  tok = strtok_r(NULL, " \t\n()|=,", &save);
+	  continue;
+	}
+
+      field_t* f = fields + n++;
+      snprintf(f->val, sizeof(f->val), "%.*s", (int) (end - tok), tok);
+      char* next = strtok_r(NULL, " \t\n()|=,", &save);
+      if (word != NULL)
+	{
+	  snprintf(f->key, sizeof(f->key), "%s_%.24s", key, word);
+	  key_clean(f->key, f->key, sizeof(f->key));
+	}
+      else if (num == 0)
+	{
+	  snprintf(f->key, sizeof(f->key), "%s", key);
+	}
+      else if (next != NULL && strcmp(next, "/") == 0)
+	{
+	  snprintf(f->key, sizeof(f->key), "%s_per_s", key);
+	  strtok_r(NULL, " \t\n()|=,", &save); /* the unit */
+	  next = strtok_r(NULL, " \t\n()|=,", &save);
+	}
+      else if (*end == '%')
+	{
+	  snprintf(f->key, sizeof(f->key), "%s_pct", key);
+	}
+      else
+	{
+	  snprintf(f->key, sizeof(f->key), "%s_%d", key, num);
+	}
+      num++;
+      word = NULL;
+      tok = next;
+    }
+  return n;
+}
+
+static void
+print_row(const char* lock, const field_t* fields, int n, int format)
+{
+  int i, h;
+  if (format == FORMAT_JSON)
+    {
+      printf("{\"bench\": \"%s\", \"lock\": \"%s\"", LOCK_IN_MULTI_BENCH, lock);
+      for (i = 0; i < n; i++)
+	{
+	  printf(", \"%s\": %s", fields[i].key,
+		 isfinite(strtod(fields[i].val, NULL)) ? fields[i].val : "null");
+	}
+      printf("}\n");
+      return;
+    }
+
+  if (header_n < 0)		/* the columns are the fields of the first row */
+    {
+      printf("bench,lock");
+      for (header_n = 0; header_n < n; header_n++)
+	{
+	  snprintf(header[header_n], MULTI_KEY_LEN, "%s", fields[header_n].key);
+	  printf(",%s", header[header_n]);
+	}
+      printf("\n");
+    }
+  printf("%s,%s", LOCK_IN_MULTI_BENCH, lock);
+  for (h = 0; h < header_n; h++)
+    {
+      printf(",");
+      for (i = 0; i < n; i++)
+	{
+	  if (strcmp(header[h], fields[i].key) == 0)
+	    {
+	      printf("%s", fields[i].val);
+	      break;
+	    }
+	}
+    }
+  printf("\n");
+}
+
+static int
+run(const multi_lock_t* l, int argc, char** argv, int format)
+{
+  int fd[2];
+  fflush(stdout);
+  if (format != FORMAT_TEXT && pipe(fd) != 0)
+    {
+      perror("pipe");
+      return 1;
+    }
+
+  pid_t pid = fork();
+  if (pid < 0)
+    {
+      perror("fork");
+      return 1;
+    }
+  if (pid == 0)
+    {
+      if (format != FORMAT_TEXT)
+	{
+	  dup2(fd[1], STDOUT_FILENO);
+	  close(fd[0]);
+	  close(fd[1]);
+	}
+      exit(l->main(argc, argv));
+    }
+
+  field_t fields[MULTI_MAX_FIELDS];
+  int n = 0;
+  if (format != FORMAT_TEXT)
+    {
+      close(fd[1]);
+      FILE* in = fdopen(fd[0], "r");
+      char line[1024];
+      while (fgets(line, sizeof(line), in) != NULL)
+	{
+	  n = parse_line(line, fields, n);
+	}
+      fclose(in);
+    }
+
+  int status;
+  waitpid(pid, &status, 0);
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+    {
+      fprintf(stderr, "%s_%s failed (status %d)\n", LOCK_IN_MULTI_BENCH, l->name, status);
+      return 1;
+    }
+  if (format != FORMAT_TEXT)
+    {
+      print_row(l->name, fields, n, format);
+    }
+  return 0;
+}
+
+int
+main(int argc, char** argv)
+{
+  char* locks = NULL;
+  int format = FORMAT_TEXT;
+  char** bargv = (char**) calloc(argc + 1, sizeof(char*));
+  int bargc = 0, i;
+
+  bargv[bargc++] = argv[0];
+  for (i = 1; i < argc; i++)
+    {
+      if (strncmp(argv[i], "--lock=", 7) == 0)
+	{
+	  locks = argv[i] + 7;
+	}
+      else if (strcmp(argv[i], "--lock") == 0 && i + 1 < argc)
+	{
+	  locks = argv[++i];
+	}
+      else if (strncmp(argv[i], "--format=", 9) == 0)
+	{
+	  const char* f = argv[i] + 9;
+	  format = !strcmp(f, "csv") ? FORMAT_CSV : !strcmp(f, "json") ? FORMAT_JSON : FORMAT_TEXT;
+	}
+      else if (strcmp(argv[i], "--list") == 0)
+	{
+	  usage(argv[0]);
+	  return 0;
+	}
+      else
+	{
+	  bargv[bargc++] = argv[i];
+	}
+    }
+
+  if (locks == NULL)
+    {
+      usage(argv[0]);
+      return 1;
+    }
+
+  int ret = 0;
+  if (strcasecmp(locks, "all") == 0)
+    {
+      size_t l;
+      for (l = 0; l < MULTI_NUM_LOCKS; l++)
+	{
+	  ret |= run(multi_locks + l, bargc, bargv, format);
+	}
+    }
+  else
+    {
+      char* save;
+      char* name = strtok_r(locks, ",", &save);
+      for (; name != NULL; name = strtok_r(NULL, ",", &save))
+	{
+	  const multi_lock_t* l = multi_find(name);
+	  if (l == NULL)
+	    {
+	      fprintf(stderr, "unknown lock: %s (see --list)\n", name);
+	      ret = 1;
+	      continue;
+	    }
+	  ret |= run(l, bargc, bargv, format);
+	}
+    }
+
+  free(bargv);
+  return ret;
+}
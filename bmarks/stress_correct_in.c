@@ -67,6 +67,7 @@ typedef struct shared_data{
 volatile shared_data* protected_data;
 int duration;
 int num_threads;
+int timed_ns = 0;		/* > 0: every 8th acquire is a timedlock with this timeout */
 
 typedef struct barrier {
     pthread_cond_t complete;
@@ -124,7 +125,22 @@ void *test_correctness(void *data)
 
   while (stop == 0) 
     {
-      if (iter++ & 7)
+      if (timed_ns > 0 && (iter & 7) == 1)
+	{
+	  iter++;
+	  struct timespec ts;
+	  clock_gettime(CLOCK_REALTIME, &ts);
+	  ts.tv_nsec += timed_ns;
+	  ts.tv_sec += ts.tv_nsec / 1000000000;
+	  ts.tv_nsec %= 1000000000;
+	  if (pthread_mutex_timedlock(&lock, &ts) == 0)
+	    {
+	      protected_data->counter++;
+	      pthread_mutex_unlock(&lock);
+	      d->num_acquires++;
+	    }
+	}
+      else if (iter++ & 7)
 	{
 	  pthread_mutex_lock(&lock);
 	  protected_data->counter++;
@@ -163,6 +179,7 @@ int main(int argc, char **argv)
     {"help",                      no_argument,       NULL, 'h'},
     {"duration",                  required_argument, NULL, 'd'},
     {"num-threads",               required_argument, NULL, 'n'},
+    {"timed",                     required_argument, NULL, 't'},
     {NULL, 0, NULL, 0}
   };
 
@@ -179,7 +196,7 @@ int main(int argc, char **argv)
 
   while(1) {
     i = 0;
-    c = getopt_long(argc, argv, "h:d:n:", long_options, &i);
+    c = getopt_long(argc, argv, "h:d:n:t:", long_options, &i);
 
     if(c == -1)
       break;
@@ -204,6 +221,8 @@ int main(int argc, char **argv)
 	     "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
 	     "  -n, --num-threads <int>\n"
 	     "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+	     "  -t, --timed <int>\n"
+	     "        Make 1 in 8 acquires a timedlock with this timeout in ns (default=0: none)\n"
 	     );
       exit(0);
     case 'd':
@@ -212,6 +231,9 @@ int main(int argc, char **argv)
     case 'n':
       num_threads = atoi(optarg);
       break;
+    case 't':
+      timed_ns = atoi(optarg);
+      break;
     case '?':
       printf("Use -h or --help for help\n");
       exit(0);
@@ -0,0 +1,413 @@
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include "utils.h"
+
+#include "rapl_read.h"
+#include "lock_in.h"
+
+/* Many small objects, each with an embedded lock (e.g., 10^6 locks):
+   reports the memory footprint of the objects and the throughput of random
+   lock/increment/unlock operations on them */
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+
+//number of concurres threads
+#define DEFAULT_NUM_THREADS 1
+//whether or not to set cpu
+#define DEFAULT_SET_CPU 1
+//total number of objects (with one lock each)
+#define DEFAULT_NUM_LOCKS 1000000
+//delay between consecutive acquire attempts in cycles
+#define DEFAULT_ACQ_DELAY 0
+//delay between lock acquire and release in cycles
+#define DEFAULT_ACQ_DURATION 0
+//the total duration of a test
+#define DEFAULT_DURATION 1000
+#define DEFAULT_VERBOSE 0
+
+static volatile int stop = 0;
+
+__thread unsigned long* seeds;
+__thread uint32_t phys_id;
+
+/* the object: the lock embedded next to the data it protects */
+typedef struct object
+{
+  pthread_mutex_t lock;
+  uint32_t value;
+} object_t;
+
+object_t* objects;
+int duration;
+int num_locks;
+int do_set_cpu;
+int num_threads;
+int acq_duration;
+int acq_delay;
+int verbose;
+
+typedef struct barrier
+{
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+
+typedef struct thread_data {
+  union
+  {
+    struct
+    {
+      barrier_t *barrier;
+      unsigned long num_acquires;
+      int id;
+    };
+    char padding[CACHE_LINE_SIZE];
+  };
+} thread_data_t;
+
+/* resident set size of the process in bytes */
+static size_t
+rss_bytes()
+{
+  size_t size = 0, resident = 0;
+  FILE* f = fopen("/proc/self/statm", "r");
+  if (f == NULL)
+    {
+      return 0;
+    }
+  if (fscanf(f, "%zu %zu", &size, &resident) != 2)
+    {
+      resident = 0;
+    }
+  fclose(f);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+void*
+test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  phys_id = the_cores[d->id];
+  if (do_set_cpu && num_threads <= 40)
+    {
+      set_cpu(phys_id);
+    }
+
+  seeds = seed_rand();
+
+  size_t num_acquires = 0;
+
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  while (stop == 0)
+    {
+      object_t* o = objects + (my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) % num_locks);
+      pthread_mutex_lock(&o->lock);
+      o->value++;
+      if (acq_duration > 0)
+	{
+	  cpause(acq_duration);
+	}
+      pthread_mutex_unlock(&o->lock);
+
+      if (acq_delay > 0)
+	{
+	  cpause(acq_delay);
+	}
+
+      num_acquires++;
+    }
+
+  d->num_acquires = num_acquires;
+  return NULL;
+}
+
+
+void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] =
+    {
+      // These options don't set a flag
+      {"help",                      no_argument,       NULL, 'h'},
+      {"verbose",                   no_argument,       NULL, 'v'},
+      {"locks",                     required_argument, NULL, 'l'},
+      {"duration",                  required_argument, NULL, 'd'},
+      {"num-threads",               required_argument, NULL, 'n'},
+      {"set-cpu",                   required_argument, NULL, 's'},
+      {"acquire",                   required_argument, NULL, 'a'},
+      {"pause",                     required_argument, NULL, 'p'},
+      {NULL, 0, NULL, 0}
+    };
+
+  int i, c;
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  struct timeval start, end;
+  struct timespec timeout;
+  duration = DEFAULT_DURATION;
+  num_locks = DEFAULT_NUM_LOCKS;
+  do_set_cpu = DEFAULT_SET_CPU;
+  num_threads = DEFAULT_NUM_THREADS;
+  acq_duration = DEFAULT_ACQ_DURATION;
+  acq_delay = DEFAULT_ACQ_DELAY;
+  verbose = DEFAULT_VERBOSE;
+
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hvd:n:s:l:a:p:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      if(c == 0 && long_options[i].flag == 0)
+	c = long_options[i].val;
+
+      switch(c)
+	{
+	case 0:
+	  /* Flag is automatically set */
+	  break;
+	case 'h':
+	  printf("lock footprint stress test\n"
+		 "\n"
+		 "Usage:\n"
+		 "  stress_footprint_in [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -l, --locks <int>\n"
+		 "        Number of objects (each with a lock) in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -d, --duration <int>\n"
+		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+		 "  -s, --set-cpu <int>\n"
+		 "        Pin threads to cores, or not (default=" XSTR(DEFAULT_SET_CPU) ")\n"
+		 "  -a, --acquire <int>\n"
+		 "        Number of cycles a lock is held (default=" XSTR(DEFAULT_ACQ_DURATION) ")\n"
+		 "  -p, --pause <int>\n"
+		 "        Number of cycles between a lock release and the next acquire (default=" XSTR(DEFAULT_ACQ_DELAY) ")\n"
+		 );
+	  exit(0);
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'l':
+	  num_locks = atoi(optarg);
+	  break;
+	case 'd':
+	  duration = atoi(optarg);
+	  break;
+	case 'n':
+	  num_threads = atoi(optarg);
+	  break;
+	case 's':
+	  do_set_cpu = atoi(optarg);
+	  break;
+	case 'a':
+	  acq_duration = atoi(optarg);
+	  break;
+	case 'p':
+	  acq_delay = atoi(optarg);
+	  break;
+	case '?':
+	  printf("Use -h or --help for help\n");
+	  exit(0);
+	default:
+	  exit(1);
+	}
+    }
+  assert(duration >= 0);
+  assert(num_locks >= 1);
+  assert(num_threads > 0);
+  assert(acq_duration >= 0);
+  assert(acq_delay >= 0);
+
+  const size_t rss_before = rss_bytes();
+  objects = (object_t*) malloc(num_locks * sizeof(object_t));
+  assert(objects != NULL);
+
+  int l;
+  for (l = 0; l < num_locks; l++)
+    {
+      pthread_mutex_init(&objects[l].lock, NULL);
+      objects[l].value = 0;
+    }
+  const size_t rss_after = rss_bytes();
+
+  if (verbose)
+    {
+      printf("Number of objects      : %d\n", num_locks);
+      printf("Duration               : %d\n", duration);
+      printf("Number of threads      : %d\n", num_threads);
+      printf("Lock is held for       : %d\n", acq_duration);
+      printf("Delay between locks    : %d\n", acq_delay);
+    }
+  timeout.tv_sec = duration / 1000;
+  timeout.tv_nsec = (duration % 1000) * 1000000;
+
+
+  if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL)
+    {
+      perror("malloc");
+      exit(1);
+    }
+  if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  printf("## lock algo : %s\n", lock_in_lock_name());
+  printf("#sizeof(lock): %10zu B ( object = %zu B)\n", sizeof(pthread_mutex_t), sizeof(object_t));
+  printf("#footprint   : %10.1f MB ( rss: %.1f MB for %d objects)\n",
+	 num_locks * sizeof(object_t) / (1024.0 * 1024),
+	 (rss_after - rss_before) / (1024.0 * 1024), num_locks);
+
+  if(duration > 0)
+    {
+      stop = 0;
+    }
+
+  /* Access set from all threads */
+  barrier_init(&barrier, num_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < num_threads; i++)
+    {
+      data[i].id = i;
+      data[i].num_acquires = 0;
+      data[i].barrier = &barrier;
+      if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0)
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR)
+    {
+      perror("signal");
+      exit(1);
+    }
+
+  RR_INIT_ALL();
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  gettimeofday(&start, NULL);
+
+  RR_START_UNPROTECTED_ALL();
+  if (duration > 0)
+    {
+      nanosleep(&timeout, NULL);
+    }
+  stop = 1;
+  RR_STOP_UNPROTECTED_ALL();
+
+  gettimeofday(&end, NULL);
+  /* Wait for thread completion */
+  for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_join(threads[i], NULL) != 0)
+	{
+	  fprintf(stderr, "Error waiting for thread completion\n");
+	  exit(1);
+	}
+    }
+
+  duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+
+  unsigned long acquires = 0;
+  for (i = 0; i < num_threads; i++)
+    {
+      if (verbose)
+	{
+	  printf("Thread: %3d : #acquire   : %lu\n", i, data[i].num_acquires);
+	}
+      acquires += data[i].num_acquires;
+    }
+
+  unsigned long total = 0;
+  for (l = 0; l < num_locks; l++)
+    {
+      total += objects[l].value;
+    }
+  if (total != acquires)
+    {
+      printf("*** error: objects total %lu != acquires %lu\n", total, acquires);
+    }
+
+  RR_PRINT_UNPROTECTED(RAPL_PRINT_ENE);
+
+  double thr = (double) (acquires * 1000.0 / duration);
+  printf("#acquires    : %10lu ( %10.0f / s)\n", acquires, thr);
+
+  rapl_stats_t s;
+  RR_STATS(&s);
+  double eop0 = (1e6 * s.energy_total[NUMBER_OF_SOCKETS]) / acquires;
+  double eop1 = (1e6 * s.energy_package[NUMBER_OF_SOCKETS]) / acquires;
+  double eop2 = (1e6 * s.energy_pp0[NUMBER_OF_SOCKETS]) / acquires;
+  printf("#eop (uJ/op) : %10f | %10f | %10f\n", eop0, eop1, eop2);
+
+  free(objects);
+  free(threads);
+  free(data);
+
+  return 0;
+}
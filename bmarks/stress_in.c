@@ -0,0 +1,559 @@
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <time.h>
+#include "utils.h"
+
+#include "lock_in.h"
+#include "stress_in.h"
+#include "stress_in_workload.h"
+#include "stress_in_measure.h"
+
+/* The parameterised stress driver: a run is composed of workload and
+   measurement modules (see stress_in.h), e.g.,
+     stress_in -n8 -l4 --cs=pause:500 --think=exp:2000 --measure=thr,lat,fair
+   or, for the convergence of the adaptive locks after load changes,
+     stress_in -n8 --cs=pause:200 --phase=steps:1000:1:1:1,1000:1:1:8,1000:20:1:4 --measure=thr,adapt
+   or, for a lock-based hash table (see ds_in.h),
+     stress_in -n8 --cs=ds:ht:1024:20 --measure=thr,lat,energy
+   New scenarios are modules in stress_in_workload.h / stress_in_measure.h */
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+
+//number of concurres threads
+#define DEFAULT_NUM_THREADS 1
+//whether or not to set cpu
+#define DEFAULT_SET_CPU 1
+//total number of locks
+#define DEFAULT_NUM_LOCKS 1
+//the total duration of a test
+#define DEFAULT_DURATION 1000
+#define DEFAULT_VERBOSE 0
+//the default modules
+#define DEFAULT_SELECT "uniform"
+#define DEFAULT_CS "pause:0"
+#define DEFAULT_THINK "pause:0"
+#define DEFAULT_MEASURE "thr"
+
+#define STRESS_NUM(t) (sizeof(t) / sizeof(t[0]))
+#define STRESS_FIND(t, spec, args)					\
+  stress_find(t, sizeof(t[0]), STRESS_NUM(t), spec, args)
+
+__thread uint32_t phys_id;
+
+stress_t stress;
+int do_set_cpu;
+int verbose;
+
+const stress_select_t* select_m;
+const stress_cs_t* cs_m;
+const stress_think_t* think_m;
+const stress_phase_t* phase_m;
+const stress_measure_t* measures[STRESS_MAX_MEASURES];
+int num_measures;
+const stress_measure_t* acquired_m[STRESS_MAX_MEASURES]; /* with an acquired callback */
+int num_acquired;
+int needs_latency;
+
+typedef struct barrier 
+{
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+barrier_t barrier;
+
+void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+/* the module of a table named as spec ("name[:args]"); the modules start
+   with their name */
+static const void*
+stress_find(const void* table, size_t size, size_t n, const char* spec, const char** args)
+{
+  const size_t len = strcspn(spec, ":");
+  *args = spec[len] ? spec + len + 1 : "";
+  size_t i;
+  for (i = 0; i < n; i++)
+    {
+      const char* name = *(const char**) ((const char*) table + i * size);
+      if (strlen(name) == len && strncmp(name, spec, len) == 0)
+	{
+	  return (const char*) table + i * size;
+	}
+    }
+  fprintf(stderr, "unknown module: %s (see -h)\n", spec);
+  exit(1);
+}
+
+static void
+stress_init_module(int (*init)(stress_t*, const char*), const char* spec, const char* args)
+{
+  if (init != NULL && init(&stress, args) != 0)
+    {
+      fprintf(stderr, "invalid module arguments: %s (see -h)\n", spec);
+      exit(1);
+    }
+}
+
+#define STRESS_HELP(t)							\
+  {									\
+    size_t m;								\
+    for (m = 0; m < STRESS_NUM(t); m++)					\
+      {									\
+	printf("          %-8s %s\n", t[m].name, t[m].help);		\
+      }									\
+  }
+
+void*
+test(void *data)
+{
+  stress_thread_t* t = (stress_thread_t*) data;
+  phys_id = the_cores[t->id];
+  if (do_set_cpu && stress.num_threads <= 40)
+    {
+      set_cpu(phys_id);
+    }
+
+  t->seeds = seed_rand();
+
+  size_t num_acquires = 0;
+  const struct timespec idle = { 0, 100000 };
+
+  /* Wait on barrier */
+  barrier_cross(&barrier);
+
+  /* after the barrier: e.g., the perf counters only count the run */
+  int m;
+  for (m = 0; m < num_measures; m++)
+    {
+      if (measures[m]->thread_start != NULL)
+	{
+	  measures[m]->thread_start(t);
+	}
+    }
+
+  while (stress.stop == 0)
+    {
+      if (t->id >= stress.active_threads)
+	{
+	  nanosleep(&idle, NULL);
+	  continue;
+	}
+
+      if (cs_m->op != NULL)
+	{
+	  const ticks start = getticks();
+	  cs_m->op(t);
+	  const ticks latency = getticks() - start;
+	  for (m = 0; m < num_acquired; m++)
+	    {
+	      acquired_m[m]->acquired(t, latency);
+	    }
+	  think_m->run(t);
+	  num_acquires++;
+	  continue;
+	}
+
+      const size_t l = select_m->next(t);
+      pthread_mutex_t* lock = stress.locks + l;
+      if (needs_latency)
+	{
+	  const ticks start = getticks();
+	  pthread_mutex_lock(lock);
+	  const ticks latency = getticks() - start;
+	  cs_m->run(t, l);
+	  pthread_mutex_unlock(lock);
+	  for (m = 0; m < num_acquired; m++)
+	    {
+	      acquired_m[m]->acquired(t, latency);
+	    }
+	}
+      else
+	{
+	  pthread_mutex_lock(lock);
+	  cs_m->run(t, l);
+	  pthread_mutex_unlock(lock);
+	  for (m = 0; m < num_acquired; m++)
+	    {
+	      acquired_m[m]->acquired(t, 0);
+	    }
+	}
+
+      think_m->run(t);
+      num_acquires++;
+    }
+
+  t->num_acquires = num_acquires;
+  for (m = 0; m < num_measures; m++)
+    {
+      if (measures[m]->thread_stop != NULL)
+	{
+	  measures[m]->thread_stop(t);
+	}
+    }
+  return NULL;
+}
+
+
+void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+static int
+elapsed_ms(struct timeval* start)
+{
+  struct timeval now;
+  gettimeofday(&now, NULL);
+  return (now.tv_sec - start->tv_sec) * 1000 + (now.tv_usec - start->tv_usec) / 1000;
+}
+
+static void
+sleep_ms(int ms)
+{
+  struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+  nanosleep(&ts, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] =
+    {
+      // These options don't set a flag
+      {"help",                      no_argument,       NULL, 'h'},
+      {"verbose",                   no_argument,       NULL, 'v'},
+      {"locks",                     required_argument, NULL, 'l'},
+      {"duration",                  required_argument, NULL, 'd'},
+      {"num-threads",               required_argument, NULL, 'n'},
+      {"set-cpu",                   required_argument, NULL, 's'},
+      {"select",                    required_argument, NULL, 'S'},
+      {"dist",                      required_argument, NULL, 'S'},
+      {"cs",                        required_argument, NULL, 'c'},
+      {"think",                     required_argument, NULL, 't'},
+      {"phase",                     required_argument, NULL, 'e'},
+      {"measure",                   required_argument, NULL, 'm'},
+      {NULL, 0, NULL, 0}
+    };
+
+  int i, c;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  struct timeval start, end;
+  const char* select_spec = DEFAULT_SELECT;
+  const char* cs_spec = DEFAULT_CS;
+  const char* think_spec = DEFAULT_THINK;
+  const char* phase_spec = NULL;
+  char measure_spec[256] = DEFAULT_MEASURE;
+  stress.duration = DEFAULT_DURATION;
+  stress.num_locks = DEFAULT_NUM_LOCKS;
+  stress.num_threads = DEFAULT_NUM_THREADS;
+  do_set_cpu = DEFAULT_SET_CPU;
+  verbose = DEFAULT_VERBOSE;
+
+  while(1) 
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hvd:n:s:l:S:c:t:e:m:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      if(c == 0 && long_options[i].flag == 0)
+	c = long_options[i].val;
+
+      switch(c) 
+	{
+	case 0:
+	  /* Flag is automatically set */
+	  break;
+	case 'h':
+	  printf("lock stress test driver, composed of workload and measurement modules\n"
+		 "\n"
+		 "Usage:\n"
+		 "  stress_in [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -l, --locks <int>\n"
+		 "        Number of locks in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -d, --duration <int>\n"
+		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+		 "  -s, --set-cpu <int>\n"
+		 "        Pin threads to cores, or not (default=" XSTR(DEFAULT_SET_CPU) ")\n"
+		 "  -S, --select, --dist <module[:args]>\n"
+		 "        Which lock an acquisition picks (default=" DEFAULT_SELECT ")\n");
+	  STRESS_HELP(stress_selects);
+	  printf("  -c, --cs <module[:args]>\n"
+		 "        The critical section (default=" DEFAULT_CS ")\n");
+	  STRESS_HELP(stress_css);
+	  printf("  -t, --think <module[:args]>\n"
+		 "        The work between a release and the next acquire (default=" DEFAULT_THINK ")\n");
+	  STRESS_HELP(stress_thinks);
+	  printf("  -e, --phase <module[:args]>\n"
+		 "        Schedule of cs/think scales and active threads (default=none)\n");
+	  STRESS_HELP(stress_phases);
+	  printf("  -m, --measure <module[:args],...>\n"
+		 "        What to measure (default=" DEFAULT_MEASURE ")\n");
+	  STRESS_HELP(stress_measures);
+	  exit(0);
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'l':
+	  stress.num_locks = atoi(optarg);
+	  break;
+	case 'd':
+	  stress.duration = atoi(optarg);
+	  break;
+	case 'n':
+	  stress.num_threads = atoi(optarg);
+	  break;
+	case 's':
+	  do_set_cpu = atoi(optarg);
+	  break;
+	case 'S':
+	  select_spec = optarg;
+	  break;
+	case 'c':
+	  cs_spec = optarg;
+	  break;
+	case 't':
+	  think_spec = optarg;
+	  break;
+	case 'e':
+	  phase_spec = optarg;
+	  break;
+	case 'm':
+	  snprintf(measure_spec, sizeof(measure_spec), "%s", optarg);
+	  break;
+	case '?':
+	  printf("Use -h or --help for help\n");
+	  exit(0);
+	default:
+	  exit(1);
+	}
+    }
+  assert(stress.duration >= 0);
+  assert(stress.num_locks >= 1);
+  assert(stress.num_threads > 0);
+
+  stress.locks = (pthread_mutex_t*) malloc(stress.num_locks * sizeof(pthread_mutex_t));
+  assert(stress.locks != NULL);
+  int l;
+  for (l = 0; l < stress.num_locks; l++)
+    {
+      pthread_mutex_init(stress.locks + l, NULL);
+    }
+
+  stress.cs_scale = stress.think_scale = 1;
+  stress.num_phases = 1;
+
+  /* the phase schedule first: it can raise the number of threads */
+  const char* args;
+  if (phase_spec != NULL)
+    {
+      phase_m = STRESS_FIND(stress_phases, phase_spec, &args);
+      stress_init_module(phase_m->init, phase_spec, args);
+    }
+  select_m = STRESS_FIND(stress_selects, select_spec, &args);
+  stress_init_module(select_m->init, select_spec, args);
+  cs_m = STRESS_FIND(stress_css, cs_spec, &args);
+  stress_init_module(cs_m->init, cs_spec, args);
+  think_m = STRESS_FIND(stress_thinks, think_spec, &args);
+  stress_init_module(think_m->init, think_spec, args);
+
+  char* save;
+  char* spec;
+  for (spec = strtok_r(measure_spec, ",", &save); spec != NULL && num_measures < STRESS_MAX_MEASURES;
+       spec = strtok_r(NULL, ",", &save))
+    {
+      const stress_measure_t* m = STRESS_FIND(stress_measures, spec, &args);
+      stress_init_module(m->init, spec, args);
+      measures[num_measures++] = m;
+      if (m->acquired != NULL)
+	{
+	  acquired_m[num_acquired++] = m;
+	}
+      needs_latency |= m->needs_latency;
+    }
+
+  /* after the modules, for the threads of the phase schedule */
+  stress.active_threads = stress.num_threads;
+  stress.threads = (stress_thread_t*) calloc(stress.num_threads, sizeof(stress_thread_t));
+  if ((threads = (pthread_t *)malloc(stress.num_threads * sizeof(pthread_t))) == NULL)
+    {
+      perror("malloc");
+      exit(1);
+    }
+
+  if (verbose)
+    {
+      printf("Number of locks        : %d\n", stress.num_locks);
+      printf("Duration               : %d\n", stress.duration);
+      printf("Number of threads      : %d\n", stress.num_threads);
+      printf("sizeof(lock)           : %zu\n", sizeof(pthread_mutex_t));
+    }
+
+  printf("## lock algo : %s\n", lock_in_lock_name());
+  printf("## workload  : select %s | cs %s | think %s | phase %s\n",
+	 select_spec, cs_spec, think_spec, phase_spec ? phase_spec : "-");
+
+  /* Access set from all threads */
+  barrier_init(&barrier, stress.num_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < stress.num_threads; i++) 
+    {
+      stress.threads[i].id = i;
+      if (pthread_create(&threads[i], &attr, test, (void *)(&stress.threads[i])) != 0) 
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR)
+    {
+      perror("signal");
+      exit(1);
+    }
+
+  if (phase_m != NULL)
+    {
+      phase_m->update(&stress, 0);
+    }
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  gettimeofday(&start, NULL);
+  for (i = 0; i < num_measures; i++)
+    {
+      if (measures[i]->start != NULL)
+	{
+	  measures[i]->start(&stress);
+	}
+    }
+
+  int ms = 0;
+  while (stress.duration == 0 || ms < stress.duration)
+    {
+      int next = (phase_m != NULL) ? phase_m->update(&stress, ms) : stress.duration - ms;
+      if (stress.duration == 0 && phase_m == NULL)
+	{
+	  next = 1000;
+	}
+      if (stress.sample_ms > 0 && stress.sample_ms - ms % stress.sample_ms < next)
+	{
+	  next = stress.sample_ms - ms % stress.sample_ms;
+	}
+      if (stress.duration > 0 && ms + next > stress.duration)
+	{
+	  next = stress.duration - ms;
+	}
+      sleep_ms(next);
+      ms = elapsed_ms(&start);
+      for (i = 0; i < num_measures && stress.sample_ms > 0; i++)
+	{
+	  if (measures[i]->sample != NULL)
+	    {
+	      measures[i]->sample(&stress, ms);
+	    }
+	}
+    }
+  stress.stop = 1;
+  if (cs_m->stop != NULL)
+    {
+      cs_m->stop(&stress);
+    }
+
+  for (i = 0; i < num_measures; i++)
+    {
+      if (measures[i]->stop != NULL)
+	{
+	  measures[i]->stop(&stress);
+	}
+    }
+  gettimeofday(&end, NULL);
+
+  /* Wait for thread completion */
+  for (i = 0; i < stress.num_threads; i++) 
+    {
+      if (pthread_join(threads[i], NULL) != 0) 
+	{
+	  fprintf(stderr, "Error waiting for thread completion\n");
+	  exit(1);
+	}
+    }
+
+  stress.duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+
+  if (verbose)
+    {
+      for (i = 0; i < stress.num_threads; i++) 
+	{
+	  printf("Thread: %3d : #acquire   : %zu\n", i, stress.threads[i].num_acquires);
+	}
+      printf("Duration      : %d (ms)\n", stress.duration);
+    }
+
+  for (i = 0; i < num_measures; i++)
+    {
+      if (measures[i]->report != NULL)
+	{
+	  measures[i]->report(&stress);
+	}
+    }
+  if (cs_m->report != NULL)
+    {
+      cs_m->report(&stress);
+    }
+
+  free(stress.locks);
+  free(stress.threads);
+  free(threads);
+
+  return 0;
+}
@@ -11,6 +11,7 @@
 
 #include "rapl_read.h"
 #include "lock_in.h"
+#include "dist.h"
 
 #define DELAY_NONE    0
 #define DELAY_NORMAL  1
@@ -29,6 +30,8 @@
 #define DEFAULT_SET_CPU 1
 //total number of locks
 #define DEFAULT_NUM_LOCKS 1
+//which lock an acquisition picks (see dist.h)
+#define DEFAULT_DIST "uniform"
 //number of lock acquisitions in this test
 #define DEFAULT_NUM_ACQ 10000
 //delay between consecutive acquire attempts in cycles
@@ -64,6 +67,8 @@ __attribute__((aligned(CACHE_LINE_SIZE))) volatile shared_data* protected_data;
 __attribute__((aligned(CACHE_LINE_SIZE))) volatile uint32_t* protected_offsets;
 int duration;
 int num_locks;
+const char* dist_spec;
+dist_t* dist;
 int do_set_cpu;
 int do_writes;
 int num_threads;
@@ -120,9 +125,11 @@ typedef struct thread_data
       unsigned long fair_delay;
       ticks ticks_lock;
       ticks ticks_unlock;
+      size_t num_futex_wait;
+      size_t num_futex_wake;
       int id;
     };
-    char padding[CACHE_LINE_SIZE];
+    char padding[2 * CACHE_LINE_SIZE];
   };
 } thread_data_t;
 
@@ -135,7 +142,6 @@ void*
 test(void *data)
 {
   thread_data_t *d = (thread_data_t *)data;
-  int rand_max = num_locks - 1;
   phys_id = the_cores[d->id];
   if (do_set_cpu)
     {
@@ -155,9 +161,13 @@ test(void *data)
   /* Wait on barrier */
   barrier_cross(d->barrier);
 
+  /* do not count the futex calls of the barrier */
+  size_t futex_wait_start, futex_wake_start;
+  lock_in_futex_stats(&futex_wait_start, &futex_wake_start);
+
   while (stop == 0) 
     {
-      int lock_to_acq = (int) my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & rand_max;
+      int lock_to_acq = (int) dist_next(dist, seeds);
 
       volatile ticks s_lock = getticks();
       pthread_mutex_lock(locks + lock_to_acq);      
@@ -219,6 +229,9 @@ test(void *data)
 #if DELAY == DELAY_FAIR
   d->num_consecutive_acq = num_consecutive_acq;
 #endif
+  lock_in_futex_stats(&d->num_futex_wait, &d->num_futex_wake);
+  d->num_futex_wait -= futex_wait_start;
+  d->num_futex_wake -= futex_wake_start;
   return NULL;
 }
 
@@ -241,6 +254,7 @@ main(int argc, char **argv)
       {"help",                      no_argument,       NULL, 'h'},
       {"verbose",                   no_argument,       NULL, 'v'},
       {"locks",                     required_argument, NULL, 'l'},
+      {"dist",                      required_argument, NULL, 'D'},
       {"duration",                  required_argument, NULL, 'd'},
       {"num-threads",               required_argument, NULL, 'n'},
       {"set-cpu",                   required_argument, NULL, 's'},
@@ -262,6 +276,7 @@ main(int argc, char **argv)
   struct timespec timeout;
   duration = DEFAULT_DURATION;
   num_locks = DEFAULT_NUM_LOCKS;
+  dist_spec = DEFAULT_DIST;
   do_set_cpu = DEFAULT_SET_CPU;
   do_writes = DEFAULT_DO_WRITES;
   num_threads = DEFAULT_NUM_THREADS;
@@ -277,7 +292,7 @@ main(int argc, char **argv)
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:", long_options, &i);
+      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:D:", long_options, &i);
 
       if(c == -1)
 	break;
@@ -301,6 +316,8 @@ main(int argc, char **argv)
 		 "        Print this message\n"
 		 "  -l, --lcoks <int>\n"
 		 "        Number of locks in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -D, --dist <spec>\n"
+		 "        Which lock an acquisition picks: " DIST_SPEC_HELP " (default=" DEFAULT_DIST ")\n"
 		 "  -d, --duration <int>\n"
 		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
 		 "  -n, --num-threads <int>\n"
@@ -327,6 +344,9 @@ main(int argc, char **argv)
 	case 'l':
 	  num_locks = atoi(optarg);
 	  break;
+	case 'D':
+	  dist_spec = optarg;
+	  break;
 	case 'd':
 	  duration = atoi(optarg);
 	  break;
@@ -374,9 +394,14 @@ main(int argc, char **argv)
   mutex_delay=(num_threads-1) * 30;
   acq_delay=acq_delay;
   acq_duration=acq_duration;
-  num_locks=pow2roundup(num_locks);
   assert(duration >= 0);
   assert(num_locks >= 1);
+  dist = dist_new(dist_spec, num_locks);
+  if (dist == NULL)
+    {
+      fprintf(stderr, "Invalid lock distribution: %s\n", dist_spec);
+      exit(1);
+    }
   assert(num_threads > 0);
   assert(acq_duration >= 0);
   assert(acq_delay >= 0);
@@ -428,6 +453,10 @@ main(int argc, char **argv)
   }
 
   printf("## lock algo : %s\n", lock_in_lock_name());
+  if (strcmp(dist_spec, DEFAULT_DIST) != 0)
+    {
+      printf("## lock dist : %s (hottest lock: %.2f%% of the acquisitions)\n", dist_spec, 100 * dist->top);
+    }
   fair_delay = ((num_threads != 1) * DEFAULT_FAIR_DELAY_BASE) + (fair_delay * (num_threads - 1));
   printf("## fair delay: %d\n", fair_delay);
 
@@ -506,6 +535,7 @@ main(int argc, char **argv)
   unsigned long acquires = 0;
   unsigned long consecutive_acq = 0;
   ticks ticks_lock = 0, ticks_unlock = 0;
+  size_t futex_wait = 0, futex_wake = 0;
   for (i = 0; i < num_threads; i++) 
     {
       if (verbose)
@@ -519,6 +549,8 @@ main(int argc, char **argv)
       consecutive_acq += data[i].num_consecutive_acq;
       ticks_lock += data[i].ticks_lock;
       ticks_unlock += data[i].ticks_unlock;
+      futex_wait += data[i].num_futex_wait;
+      futex_wake += data[i].num_futex_wake;
     }
 
   if (verbose)
@@ -537,6 +569,13 @@ main(int argc, char **argv)
   printf("#lock ticks   : %-10llu = %-10zu per core\n", 
 	 (unsigned long long) ticks_lock, ticks_lock_pc);
   printf("#unlock ticks : %-10llu\n", (unsigned long long) ticks_unlock);
+  size_t n_wait, n_wake;
+  if (lock_in_futex_stats(&n_wait, &n_wake))
+    {
+      printf("#futex calls  : %-10.4f = %-10.4f wait + %-10.4f wake per op\n",
+	     (double) (futex_wait + futex_wake) / acquires,
+	     (double) futex_wait / acquires, (double) futex_wake / acquires);
+    }
 #if DELAY == DELAY_FAIR
   double thr_q = (double) (consecutive_acq * 1000.0 / duration);
   double consecutive_acq_perc = (1-(thr - thr_q)/thr) * 100;
@@ -556,6 +595,7 @@ main(int argc, char **argv)
   printf("#eop (uJ/op)  : %10f | %10f | %10f\n", eop0, eop1, eop2);
 
   free(locks);
+  dist_destroy(dist);
   free(threads);
   free(data);
 
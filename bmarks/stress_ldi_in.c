@@ -1,17 +1,21 @@
 #include <assert.h>
+#include <errno.h>
 #include <getopt.h>
 #include <limits.h>
+#include <math.h>
 #include <pthread.h>
 #include <signal.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/time.h>
+#include <sys/prctl.h>
 #include <time.h>
 #include "utils.h"
 
 #include "cdf.h"
 #include "rapl_read.h"
 #include "lock_in.h"
+#include "dist.h"
 
 #define DELAY_NONE      0
 #define DELAY_NORMAL    1
@@ -31,6 +35,8 @@
 #define DEFAULT_SET_CPU 1
 //total number of locks
 #define DEFAULT_NUM_LOCKS 1
+//which lock an acquisition picks (see dist.h)
+#define DEFAULT_DIST "uniform"
 //number of lock acquisitions in this test
 #define DEFAULT_ACQ_DELAY 0
 //delay between lock acquire and release in cycles
@@ -48,6 +54,16 @@
 #define DEFAULT_POW_PRINT RAPL_PRINT_ENE
 #define DEFAULT_VERBOSE 0
 #define DEFAULT_BOXPLOT_PERC 95
+//number of background (low-priority) threads, out of num_threads
+#define DEFAULT_NUM_BG 0
+//delay between lock release and the next acquire of background threads
+#define DEFAULT_BG_DELAY 0
+//open loop: offered acquisitions per second, of all threads (0 = closed loop)
+#define DEFAULT_RATE 0
+//open loop: fixed-rate (0) or Poisson (1) arrivals
+#define DEFAULT_ARRIVALS 1
+//open loop: sleep until this many ns before an arrival, then spin
+#define ARRIVAL_SPIN_NS 5000
 
 static volatile int stop = 0;
 
@@ -65,6 +81,8 @@ __attribute__((aligned(CACHE_LINE_SIZE))) volatile shared_data* protected_data;
 __attribute__((aligned(CACHE_LINE_SIZE))) volatile uint32_t* protected_offsets;
 int duration;
 int num_locks;
+const char* dist_spec;
+dist_t* dist;
 int do_set_cpu;
 int do_writes;
 int num_threads;
@@ -76,6 +94,12 @@ int cl_access;
 int power_print;
 int verbose;
 double test_boxplot_perc;
+int num_bg;
+int bg_delay;
+double rate;
+int arrivals;
+double interarrival;		/* mean cycles between the arrivals of a thread */
+double cycles_ns;		/* cycles of getticks per ns */
 
 typedef struct barrier 
 {
@@ -110,8 +134,6 @@ void barrier_cross(barrier_t *b)
 }
 
 
-#define LDI_VALS_NUM ((1<<19))
-
 typedef struct thread_data 
 {
   union
@@ -124,9 +146,11 @@ typedef struct thread_data
       unsigned long fair_delay;
       ticks ticks_lock;
       ticks ticks_unlock;
-      ticks* vals_lock;
-      ticks* vals_unlock;
+      cdf_hist_t* hist_lock;
+      cdf_hist_t* hist_unlock;
+      cdf_hist_t* hist_latency;	/* open loop: from the intended start */
       int id;
+      int prio;
     };
     char padding[CACHE_LINE_SIZE];
   };
@@ -137,11 +161,60 @@ typedef struct thread_data
 size_t shared_counter = 0;
 #endif
 
+/* cycles of getticks per second on this machine */
+static double
+cycles_per_sec()
+{
+  struct timeval s, e;
+  struct timespec d = { 0, 20000000 };
+  gettimeofday(&s, NULL);
+  const ticks t0 = getticks();
+  nanosleep(&d, NULL);
+  const ticks t1 = getticks();
+  gettimeofday(&e, NULL);
+  return (t1 - t0) / ((e.tv_sec - s.tv_sec) + (e.tv_usec - s.tv_usec) / 1e6);
+}
+
+/* open loop: waits until the intended start; sleeps while it is more than
+   ARRIVAL_SPIN_NS away, so that idle threads do not steal cpu time (or
+   energy) from the lock holders, and spins for the rest */
+static inline void
+wait_arrival(const ticks intended)
+{
+  const ticks spin = (ticks) (ARRIVAL_SPIN_NS * cycles_ns);
+  const ticks now = getticks();
+  if (intended > now + spin)
+    {
+      struct timespec ts;
+      clock_gettime(CLOCK_MONOTONIC, &ts);
+      const uint64_t ns = ts.tv_nsec + (uint64_t) ((intended - now - spin) / cycles_ns);
+      ts.tv_sec += ns / 1000000000;
+      ts.tv_nsec = ns % 1000000000;
+      while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR && stop == 0)
+	;
+    }
+  while (getticks() < intended && stop == 0)
+    {
+      PAUSE_IN();
+    }
+}
+
+/* open loop: cycles until the next arrival of the thread */
+static inline ticks
+next_arrival()
+{
+  if (arrivals == 0)
+    {
+      return (ticks) interarrival;
+    }
+  const double u = (my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & 0xffffffff) / 4294967296.0;
+  return (ticks) (-log(1.0 - u) * interarrival);
+}
+
 void*
 test(void* data)
 {
   thread_data_t *d = (thread_data_t *)data;
-  int rand_max = num_locks - 1;
   phys_id = the_cores[d->id];
   if (do_set_cpu && num_threads <= 40)
     {
@@ -149,6 +222,8 @@ test(void* data)
     }
 
   seeds = seed_rand();
+  lock_in_set_prio(d->prio);
+  const int my_delay = d->prio ? bg_delay : acq_delay;
 #if DELAY >= DELAY_FAIR_PLUS
   size_t counter_prev = -1;
   size_t num_consecutive_acq = 0;
@@ -158,16 +233,35 @@ test(void* data)
   UNUSED size_t sum = 0;
   size_t num_acquires = 0;
 
-  d->vals_lock = (ticks*) calloc(LDI_VALS_NUM, sizeof(ticks));
-  d->vals_unlock = (ticks*) calloc(LDI_VALS_NUM, sizeof(ticks));
-  assert(d->vals_lock != NULL && d->vals_unlock != NULL);
+  d->hist_lock = cdf_hist_new();
+  d->hist_unlock = cdf_hist_new();
+  d->hist_latency = cdf_hist_new();
 
   /* Wait on barrier */
   barrier_cross(d->barrier);
 
+  /* open loop: the acquisitions are issued on a schedule, and the latency
+     is measured from the intended start, so that the queueing delay of a
+     thread that falls behind is not omitted */
+  ticks intended = getticks();
+  if (interarrival > 0)
+    {
+      prctl(PR_SET_TIMERSLACK, 1UL); /* wake up on time from wait_arrival */
+    }
+
   while (stop == 0) 
     {
-      int lock_to_acq = (int) my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & rand_max;
+      if (interarrival > 0)
+	{
+	  intended += next_arrival();
+	  wait_arrival(intended);
+	  if (stop)
+	    {
+	      break;
+	    }
+	}
+
+      int lock_to_acq = (int) dist_next(dist, seeds);
 
       volatile ticks s_lock = getticks();
       pthread_mutex_lock(locks + lock_to_acq);      
@@ -209,13 +303,20 @@ test(void* data)
       ticks lunlock = (e_unlock - s_unlock);
       d->ticks_lock += llock;
       d->ticks_unlock += lunlock;
-      d->vals_lock[num_acquires & (LDI_VALS_NUM - 1)] = llock;
-      d->vals_unlock[num_acquires & (LDI_VALS_NUM - 1)] = lunlock;
+      cdf_hist_add(d->hist_lock, llock);
+      cdf_hist_add(d->hist_unlock, lunlock);
+
+      if (interarrival > 0)
+	{
+	  cdf_hist_add(d->hist_latency, e_lock - intended);
+	  num_acquires++;
+	  continue;		/* the schedule replaces the delays */
+	}
 
 #if DELAY >= DELAY_NORMAL
-      if (acq_delay > 0) 
+      if (my_delay > 0) 
 	{
-	  cpause(acq_delay);
+	  cpause(my_delay);
 	}
 #endif
 
@@ -255,6 +356,7 @@ main(int argc, char **argv)
       {"help",                      no_argument,       NULL, 'h'},
       {"verbose",                   no_argument,       NULL, 'v'},
       {"locks",                     required_argument, NULL, 'l'},
+      {"dist",                      required_argument, NULL, 'D'},
       {"duration",                  required_argument, NULL, 'd'},
       {"num-threads",               required_argument, NULL, 'n'},
       {"set-cpu",                   required_argument, NULL, 's'},
@@ -265,6 +367,10 @@ main(int argc, char **argv)
       {"clines",                    required_argument, NULL, 'c'},
       {"power",                     required_argument, NULL, 'o'},
       {"boxplot",                   required_argument, NULL, 'b'},
+      {"background",                required_argument, NULL, 'g'},
+      {"bg-pause",                  required_argument, NULL, 'r'},
+      {"rate",                      required_argument, NULL, 'R'},
+      {"arrivals",                  required_argument, NULL, 'A'},
       {NULL, 0, NULL, 0}
     };
 
@@ -277,6 +383,7 @@ main(int argc, char **argv)
   struct timespec timeout;
   duration = DEFAULT_DURATION;
   num_locks = DEFAULT_NUM_LOCKS;
+  dist_spec = DEFAULT_DIST;
   do_set_cpu = DEFAULT_SET_CPU;
   do_writes = DEFAULT_DO_WRITES;
   num_threads = DEFAULT_NUM_THREADS;
@@ -287,13 +394,17 @@ main(int argc, char **argv)
   power_print = DEFAULT_POW_PRINT;
   verbose = DEFAULT_VERBOSE;
   test_boxplot_perc = DEFAULT_BOXPLOT_PERC;
+  num_bg = DEFAULT_NUM_BG;
+  bg_delay = DEFAULT_BG_DELAY;
+  rate = DEFAULT_RATE;
+  arrivals = DEFAULT_ARRIVALS;
 
   /* sigset_t block_set; */
 
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:b:", long_options, &i);
+      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:b:g:r:R:A:D:", long_options, &i);
 
       if(c == -1)
 	break;
@@ -317,6 +428,8 @@ main(int argc, char **argv)
 		 "        Print this message\n"
 		 "  -l, --locks <int>\n"
 		 "        Number of locks in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -D, --dist <spec>\n"
+		 "        Which lock an acquisition picks: " DIST_SPEC_HELP " (default=" DEFAULT_DIST ")\n"
 		 "  -d, --duration <int>\n"
 		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
 		 "  -n, --num-threads <int>\n"
@@ -337,6 +450,14 @@ main(int argc, char **argv)
 		 "        Print output level for RAPL power measurements (default=" XSTR(DEFAULT_POW_PRINT) ")\n"
 		 "  -b, --boxplot <int>\n"
 		 "        What's percentile latency values to print (default=" XSTR(DEFAULT_BOXPLOT_PERC) ")\n"
+		 "  -g, --background <int>\n"
+		 "        Number of the threads that are background (priority class 1) threads (default=" XSTR(DEFAULT_NUM_BG) ")\n"
+		 "  -r, --bg-pause <int>\n"
+		 "        Number of cycles between a lock release and the next acquire of background threads (default=" XSTR(DEFAULT_BG_DELAY) ")\n"
+		 "  -R, --rate <double>\n"
+		 "        Open loop: offered acquisitions per second of all threads, instead of -p/-f (0=closed loop, default=" XSTR(DEFAULT_RATE) ")\n"
+		 "  -A, --arrivals <int>\n"
+		 "        Open loop: fixed-rate (0) or Poisson (1) arrivals (default=" XSTR(DEFAULT_ARRIVALS) ")\n"
 		 );
 	  exit(0);
 	case 'v':
@@ -345,6 +466,9 @@ main(int argc, char **argv)
 	case 'l':
 	  num_locks = atoi(optarg);
 	  break;
+	case 'D':
+	  dist_spec = optarg;
+	  break;
 	case 'd':
 	  duration = atoi(optarg);
 	  break;
@@ -385,6 +509,18 @@ main(int argc, char **argv)
 	case 'b':
 	  test_boxplot_perc = atof(optarg);
 	  break;
+	case 'g':
+	  num_bg = atoi(optarg);
+	  break;
+	case 'r':
+	  bg_delay = atoi(optarg);
+	  break;
+	case 'R':
+	  rate = atof(optarg);
+	  break;
+	case 'A':
+	  arrivals = atoi(optarg);
+	  break;
 	case '?':
 	  printf("Use -h or --help for help\n");
 	  exit(0);
@@ -395,13 +531,24 @@ main(int argc, char **argv)
   mutex_delay=(num_threads-1) * 30;
   acq_delay=acq_delay;
   acq_duration=acq_duration;
-  num_locks=pow2roundup(num_locks);
   assert(duration >= 0);
   assert(num_locks >= 1);
+  dist = dist_new(dist_spec, num_locks);
+  if (dist == NULL)
+    {
+      fprintf(stderr, "Invalid lock distribution: %s\n", dist_spec);
+      exit(1);
+    }
   assert(num_threads > 0);
   assert(acq_duration >= 0);
   assert(acq_delay >= 0);
   assert(cl_access >= 0);
+  assert(num_bg >= 0 && num_bg <= num_threads);
+  assert(bg_delay >= 0);
+  assert(rate >= 0);
+
+  cycles_ns = (rate > 0) ? cycles_per_sec() / 1e9 : 0;
+  interarrival = (rate > 0) ? cycles_ns * 1e9 * num_threads / rate : 0;
 
   if (cl_access > 0)
     {
@@ -455,8 +602,17 @@ main(int argc, char **argv)
   }
 
   printf("## lock algo : %s\n", lock_in_lock_name());
+  if (strcmp(dist_spec, DEFAULT_DIST) != 0)
+    {
+      printf("## lock dist : %s (hottest lock: %.2f%% of the acquisitions)\n", dist_spec, 100 * dist->top);
+    }
   fair_delay = ((num_threads != 1) * DEFAULT_FAIR_DELAY_BASE) + (fair_delay * (num_threads - 1));
   printf("## fair delay: %d\n", fair_delay);
+  if (interarrival > 0)
+    {
+      printf("## open loop : %.0f acquires/s offered (%s arrivals, every %.0f cycles per thread)\n",
+	     rate, arrivals ? "poisson" : "fixed-rate", interarrival);
+    }
 
   if(duration > 0)
     {
@@ -473,6 +629,7 @@ main(int argc, char **argv)
       data[i].num_acquires = 0;
       data[i].num_consecutive_acq = 0;
       data[i].fair_delay = fair_delay;
+      data[i].prio = (i >= num_threads - num_bg); /* the last num_bg threads */
       data[i].barrier = &barrier;
       if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0) 
 	{
@@ -533,10 +690,11 @@ main(int argc, char **argv)
   unsigned long acquires = 0;
   unsigned long consecutive_acq = 0;
   ticks ticks_lock = 0, ticks_unlock = 0;
-  ticks* vals_lock = (ticks*) calloc(num_threads * LDI_VALS_NUM, sizeof(ticks));
-  ticks* vals_unlock = (ticks*) calloc(num_threads * LDI_VALS_NUM, sizeof(ticks));
-  assert(vals_lock != NULL && vals_unlock != NULL);
-  size_t vals_idx = 0;
+  cdf_hist_t* hist_lock = cdf_hist_new();
+  cdf_hist_t* hist_unlock = cdf_hist_new();
+  /* lock latencies per priority class (foreground, background) */
+  cdf_hist_t* hist_class[2] = { cdf_hist_new(), cdf_hist_new() };
+  cdf_hist_t* hist_latency = cdf_hist_new();
 
   for (i = 0; i < num_threads; i++) 
     {
@@ -551,20 +709,13 @@ main(int argc, char **argv)
       consecutive_acq += data[i].num_consecutive_acq;
       ticks_lock += data[i].ticks_lock;
       ticks_unlock += data[i].ticks_unlock;
-      int v;
-      for (v = 0; v < LDI_VALS_NUM; v++)
-	{
-	  if (data[i].vals_lock[v])
-	    {
-	      vals_lock[vals_idx] = data[i].vals_lock[v];
-	      vals_unlock[vals_idx] = data[i].vals_unlock[v];
-	      vals_idx++;
-	    }
-	  else
-	    {
-	      break;
-	    }
-	}
+      cdf_hist_merge(hist_lock, data[i].hist_lock);
+      cdf_hist_merge(hist_unlock, data[i].hist_unlock);
+      cdf_hist_merge(hist_class[data[i].prio], data[i].hist_lock);
+      cdf_hist_merge(hist_latency, data[i].hist_latency);
+      cdf_hist_destroy(data[i].hist_lock);
+      cdf_hist_destroy(data[i].hist_unlock);
+      cdf_hist_destroy(data[i].hist_latency);
     }
 
   if (verbose)
@@ -600,8 +751,8 @@ main(int argc, char **argv)
   printf("#ppw (ops/W)  : %10.1f | %10.1f | %10.1f\n", ppw0, ppw1, ppw2);
   printf("#eop (uJ/op)  : %10f | %10f | %10f\n", eop0, eop1, eop2);
 
-  cdf_t* cdf_lock = cdf_calc((size_t*) vals_lock, vals_idx);
-  cdf_t* cdf_unlock = cdf_calc((size_t*) vals_unlock, vals_idx);
+  cdf_t* cdf_lock = cdf_calc_hist(hist_lock);
+  cdf_t* cdf_unlock = cdf_calc_hist(hist_unlock);
 
   //  cdf_print(cdf_lock);
   printf("#lock\n");
@@ -610,13 +761,48 @@ main(int argc, char **argv)
   printf("#unlock\n");
   cdf_print_boxplot_limits(cdf_unlock, limits, "unlock");
 
-  free(vals_lock);
-  free(vals_unlock);
+  if (num_bg > 0)
+    {
+      const char* class_names[2] = { "lock-fg", "lock-bg" };
+      double limits_class[CDF_BOXPLOT_VALS] = {0, 50, 90, 95, 99, 99.9, 100};
+      int k;
+      for (k = 0; k < 2; k++)
+	{
+	  if (hist_class[k]->n == 0)
+	    {
+	      continue;
+	    }
+	  printf("#%s       : %10zu samples\n", class_names[k], hist_class[k]->n);
+	  cdf_t* cdf_class = cdf_calc_hist(hist_class[k]);
+	  cdf_print_boxplot_limits(cdf_class, limits_class, class_names[k]);
+	  cdf_destroy(cdf_class);
+	}
+    }
+
+  if (interarrival > 0)
+    {
+      printf("#offered      : %10.0f / s ( achieved %.2f%%)\n", rate, 100 * thr / rate);
+      printf("#latency      : p50 %zu p90 %zu p99 %zu p99.9 %zu max %zu (cycles from the intended start)\n",
+	     cdf_hist_percentile(hist_latency, 50), cdf_hist_percentile(hist_latency, 90),
+	     cdf_hist_percentile(hist_latency, 99), cdf_hist_percentile(hist_latency, 99.9),
+	     hist_latency->max);
+      cdf_t* cdf_latency = cdf_calc_hist(hist_latency);
+      double limits_latency[CDF_BOXPLOT_VALS] = {0, 50, 90, 99, 99.9, 99.99, 100};
+      cdf_print_boxplot_limits(cdf_latency, limits_latency, "latency");
+      cdf_destroy(cdf_latency);
+    }
+
+  cdf_hist_destroy(hist_lock);
+  cdf_hist_destroy(hist_unlock);
+  cdf_hist_destroy(hist_latency);
+  cdf_hist_destroy(hist_class[0]);
+  cdf_hist_destroy(hist_class[1]);
 
   cdf_destroy(cdf_lock);
   cdf_destroy(cdf_unlock);
 
   free(locks);
+  dist_destroy(dist);
   free(threads);
   free(data);
 
@@ -0,0 +1,442 @@
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include "utils.h"
+
+#include "rapl_read.h"
+#include "lock_in.h"
+#include "lock_in_replay.h"
+
+/* Re-executes a recorded lock trace (see lock_in_replay.h; exported with
+   lockin-trace -o from a LOCK_IN_TRACE=1 run): one thread per recorded
+   thread performs the recorded sequence of lock and unlock operations on
+   the recorded locks, spinning for the recorded think and hold times in
+   between. Reports the makespan (the time until the last thread is done)
+   and the average wait, next to the recorded ones, so that the lock
+   algorithms can be ranked on the recorded workload */
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+
+//whether or not to set cpu
+#define DEFAULT_SET_CPU 1
+//number of times the trace is replayed
+#define DEFAULT_REPS 1
+//factor for the recorded think and hold times
+#define DEFAULT_SCALE 1.0
+#define DEFAULT_VERBOSE 0
+
+__thread uint32_t phys_id;
+
+pthread_mutex_t* locks;
+int do_set_cpu;
+int num_threads;
+int reps;
+int verbose;
+
+typedef struct barrier
+{
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+
+typedef struct thread_data {
+  union
+  {
+    struct
+    {
+      barrier_t *barrier;
+      lock_in_replay_op_t* ops;
+      uint32_t n_ops;
+      uint32_t thread;
+      unsigned long num_acquires;
+      unsigned long recorded_acquires;
+      ticks wait;
+      ticks recorded_wait;
+      ticks end;
+      int id;
+    };
+    char padding[2 * CACHE_LINE_SIZE];
+  };
+} thread_data_t;
+
+/* cycles of getticks per microsecond on this machine */
+static double
+cycles_per_us()
+{
+  struct timeval s, e;
+  struct timespec d = { 0, 20000000 };
+  gettimeofday(&s, NULL);
+  const ticks t0 = getticks();
+  nanosleep(&d, NULL);
+  const ticks t1 = getticks();
+  gettimeofday(&e, NULL);
+  return (t1 - t0) / ((e.tv_sec - s.tv_sec) * 1e6 + (e.tv_usec - s.tv_usec));
+}
+
+static void
+read_or_die(void* buf, size_t size, size_t n, FILE* f, const char* path)
+{
+  if (fread(buf, size, n, f) != n)
+    {
+      fprintf(stderr, "%s: truncated replay file\n", path);
+      exit(1);
+    }
+}
+
+void*
+test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  phys_id = the_cores[d->id];
+  if (do_set_cpu && num_threads <= 40)
+    {
+      set_cpu(phys_id);
+    }
+
+  size_t num_acquires = 0;
+  ticks wait = 0;
+
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  int r;
+  for (r = 0; r < reps; r++)
+    {
+      uint32_t i;
+      for (i = 0; i < d->n_ops; i++)
+	{
+	  const lock_in_replay_op_t* op = d->ops + i;
+	  if (op->delay > 0)
+	    {
+	      cpause(op->delay);
+	    }
+	  pthread_mutex_t* l = locks + (op->lock & ~LOCK_IN_REPLAY_UNLOCK);
+	  if (op->lock & LOCK_IN_REPLAY_UNLOCK)
+	    {
+	      pthread_mutex_unlock(l);
+	    }
+	  else
+	    {
+	      const ticks s = getticks();
+	      pthread_mutex_lock(l);
+	      wait += getticks() - s;
+	      num_acquires++;
+	    }
+	}
+    }
+
+  d->end = getticks();
+  d->wait = wait;
+  d->num_acquires = num_acquires;
+  return NULL;
+}
+
+
+void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] =
+    {
+      // These options don't set a flag
+      {"help",                      no_argument,       NULL, 'h'},
+      {"verbose",                   no_argument,       NULL, 'v'},
+      {"file",                      required_argument, NULL, 'f'},
+      {"set-cpu",                   required_argument, NULL, 's'},
+      {"reps",                      required_argument, NULL, 'r'},
+      {"scale",                     required_argument, NULL, 'x'},
+      {NULL, 0, NULL, 0}
+    };
+
+  int i, c;
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  const char* path = NULL;
+  double scale = DEFAULT_SCALE;
+  do_set_cpu = DEFAULT_SET_CPU;
+  reps = DEFAULT_REPS;
+  verbose = DEFAULT_VERBOSE;
+
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hvf:s:r:x:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      if(c == 0 && long_options[i].flag == 0)
+	c = long_options[i].val;
+
+      switch(c)
+	{
+	case 0:
+	  /* Flag is automatically set */
+	  break;
+	case 'h':
+	  printf("lock trace replay\n"
+		 "\n"
+		 "Usage:\n"
+		 "  stress_replay_in -f <file> [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -f, --file <string>\n"
+		 "        The replay file (lockin-trace -o <file> <trace>)\n"
+		 "  -s, --set-cpu <int>\n"
+		 "        Pin threads to cores, or not (default=" XSTR(DEFAULT_SET_CPU) ")\n"
+		 "  -r, --reps <int>\n"
+		 "        Number of times the trace is replayed (default=" XSTR(DEFAULT_REPS) ")\n"
+		 "  -x, --scale <double>\n"
+		 "        Factor for the recorded think and hold times (default=" XSTR(DEFAULT_SCALE) ")\n"
+		 );
+	  exit(0);
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'f':
+	  path = optarg;
+	  break;
+	case 's':
+	  do_set_cpu = atoi(optarg);
+	  break;
+	case 'r':
+	  reps = atoi(optarg);
+	  break;
+	case 'x':
+	  scale = atof(optarg);
+	  break;
+	case '?':
+	  printf("Use -h or --help for help\n");
+	  exit(0);
+	default:
+	  exit(1);
+	}
+    }
+  if (path == NULL)
+    {
+      printf("No replay file (-f). Use -h or --help for help\n");
+      exit(1);
+    }
+  assert(reps > 0);
+  assert(scale >= 0);
+
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    {
+      perror(path);
+      exit(1);
+    }
+  lock_in_replay_hdr_t hdr;
+  read_or_die(&hdr, sizeof(hdr), 1, f, path);
+  if (hdr.magic != LOCK_IN_REPLAY_MAGIC || hdr.version != LOCK_IN_REPLAY_VERSION)
+    {
+      fprintf(stderr, "%s: not a (version %d) replay file\n", path, LOCK_IN_REPLAY_VERSION);
+      exit(1);
+    }
+  num_threads = hdr.n_threads;
+  assert(num_threads > 0);
+  if (num_threads > sysconf(_SC_NPROCESSORS_ONLN))
+    {
+      printf("# warning: replaying %d threads on %ld cores\n", num_threads,
+	     sysconf(_SC_NPROCESSORS_ONLN));
+    }
+
+  if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL)
+    {
+      perror("malloc");
+      exit(1);
+    }
+  if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  /* the recorded times in the cycles of this machine */
+  const double cpu = cycles_per_us();
+  const double factor = scale * cpu / hdr.cycles_per_us;
+  for (i = 0; i < num_threads; i++)
+    {
+      lock_in_replay_thread_t th;
+      read_or_die(&th, sizeof(th), 1, f, path);
+      data[i].thread = th.thread;
+      data[i].n_ops = th.n_ops;
+      data[i].ops = (lock_in_replay_op_t*) malloc(th.n_ops * sizeof(lock_in_replay_op_t));
+      assert(data[i].ops != NULL);
+      read_or_die(data[i].ops, sizeof(lock_in_replay_op_t), th.n_ops, f, path);
+
+      data[i].recorded_wait = 0;
+      data[i].recorded_acquires = 0;
+      uint32_t o;
+      for (o = 0; o < th.n_ops; o++)
+	{
+	  lock_in_replay_op_t* op = data[i].ops + o;
+	  assert((op->lock & ~LOCK_IN_REPLAY_UNLOCK) < hdr.n_locks);
+	  const double delay = op->delay * factor;
+	  op->delay = (delay > UINT32_MAX) ? UINT32_MAX : (uint32_t) delay;
+	  data[i].recorded_wait += op->wait;
+	  data[i].recorded_acquires += !(op->lock & LOCK_IN_REPLAY_UNLOCK);
+	}
+    }
+  fclose(f);
+
+  locks = (pthread_mutex_t*) malloc(hdr.n_locks * sizeof(pthread_mutex_t));
+  assert(locks != NULL);
+  uint32_t l;
+  for (l = 0; l < hdr.n_locks; l++)
+    {
+      pthread_mutex_init(locks + l, NULL);
+    }
+
+  if (verbose)
+    {
+      printf("Replay file            : %s\n", path);
+      printf("Number of threads      : %d\n", num_threads);
+      printf("Number of locks        : %u\n", hdr.n_locks);
+      printf("Repetitions            : %d\n", reps);
+      printf("Time scale             : %f\n", scale);
+      printf("Cycles per us          : %.1f (recorded %.1f)\n", cpu, hdr.cycles_per_us);
+    }
+
+  /* Access set from all threads */
+  barrier_init(&barrier, num_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < num_threads; i++)
+    {
+      data[i].id = i;
+      data[i].num_acquires = 0;
+      data[i].barrier = &barrier;
+      if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0)
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR)
+    {
+      perror("signal");
+      exit(1);
+    }
+
+  RR_INIT_ALL();
+
+  /* Start threads */
+  barrier_cross(&barrier);
+  const ticks start = getticks();
+  RR_START_UNPROTECTED_ALL();
+
+  /* Wait for thread completion */
+  for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_join(threads[i], NULL) != 0)
+	{
+	  fprintf(stderr, "Error waiting for thread completion\n");
+	  exit(1);
+	}
+    }
+  RR_STOP_UNPROTECTED_ALL();
+
+  ticks end = start, wait = 0, recorded_wait = 0;
+  unsigned long acquires = 0;
+  for (i = 0; i < num_threads; i++)
+    {
+      if (verbose)
+	{
+	  printf("Thread: %3d : (recorded %3u) #acquire : %-10lu wait-avg : %10.3f us ( recorded %10.3f us) done : %10.3f ms\n",
+		 i, data[i].thread, data[i].num_acquires,
+		 data[i].num_acquires ? data[i].wait / cpu / data[i].num_acquires : 0,
+		 data[i].recorded_acquires ? data[i].recorded_wait / hdr.cycles_per_us / data[i].recorded_acquires : 0,
+		 (data[i].end - start) / cpu / 1000);
+	}
+      if (data[i].end > end)
+	{
+	  end = data[i].end;
+	}
+      acquires += data[i].num_acquires;
+      wait += data[i].wait;
+      recorded_wait += data[i].recorded_wait;
+    }
+
+  RR_PRINT_UNPROTECTED(RAPL_PRINT_ENE);
+
+  const double makespan_ms = (end - start) / cpu / 1000;
+  printf("## lock algo : %s\n", lock_in_lock_name());
+  printf("## trace     : %s ( %s : %u threads : %u locks : %llu ops)\n", path, hdr.algo,
+	 hdr.n_threads, hdr.n_locks, (unsigned long long) hdr.n_ops);
+  printf("#makespan    : %10.3f ms ( recorded %10.3f ms x %d)\n", makespan_ms,
+	 hdr.span / hdr.cycles_per_us / 1000, reps);
+  printf("#acquires    : %10lu ( %10.0f / s)\n", acquires, acquires * 1000.0 / makespan_ms);
+  printf("#wait-avg    : %10.3f us ( recorded %10.3f us)\n",
+	 acquires ? wait / cpu / acquires : 0,
+	 acquires ? recorded_wait * reps / hdr.cycles_per_us / acquires : 0);
+
+  rapl_stats_t s;
+  RR_STATS(&s);
+  double eop0 = (1e6 * s.energy_total[NUMBER_OF_SOCKETS]) / acquires;
+  double eop1 = (1e6 * s.energy_package[NUMBER_OF_SOCKETS]) / acquires;
+  double eop2 = (1e6 * s.energy_pp0[NUMBER_OF_SOCKETS]) / acquires;
+  printf("#eop (uJ/op) : %10f | %10f | %10f\n", eop0, eop1, eop2);
+
+  for (i = 0; i < num_threads; i++)
+    {
+      free(data[i].ops);
+    }
+  free(locks);
+  free(threads);
+  free(data);
+
+  return 0;
+}
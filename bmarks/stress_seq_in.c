@@ -0,0 +1,505 @@
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <time.h>
+#include "utils.h"
+
+#include "rapl_read.h"
+#include "lock_in.h"
+#include "lock_in_seq.h"
+
+/* Read-mostly access to one shared object of -c cache lines: the readers
+   copy the object, the writers overwrite it with a new version. The object
+   is protected by a seqlock (lock_in_seq.h, default), a reader-writer lock
+   (pthread_rwlock_*), or a plain mutex (-m). Reports the read and write
+   throughput (and the read retries of the seqlock), and checks that every
+   read copy is consistent */
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+
+#define MODE_SEQ   0
+#define MODE_RW    1
+#define MODE_MUTEX 2
+
+//number of concurres threads
+#define DEFAULT_NUM_THREADS 1
+//whether or not to set cpu
+#define DEFAULT_SET_CPU 1
+//size of the object in cache lines
+#define DEFAULT_NUM_LINES 4
+//percentage of writes
+#define DEFAULT_WRITES 1
+//synchronization of the object
+#define DEFAULT_MODE MODE_SEQ
+//delay between consecutive operations in cycles
+#define DEFAULT_ACQ_DELAY 0
+//the total duration of a test
+#define DEFAULT_DURATION 1000
+#define DEFAULT_VERBOSE 0
+
+#define WORDS_PER_LINE (CACHE_LINE_SIZE / sizeof(uint64_t))
+
+static volatile int stop = 0;
+
+__thread unsigned long* seeds;
+__thread uint32_t phys_id;
+
+lock_in_seq_t seq;
+pthread_rwlock_t rwlock;
+pthread_mutex_t mutex;
+volatile uint64_t* object;
+int duration;
+int num_lines;
+int num_words;
+int writes;
+int mode;
+int do_set_cpu;
+int num_threads;
+int acq_delay;
+int verbose;
+
+typedef struct barrier
+{
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+
+typedef struct thread_data {
+  union
+  {
+    struct
+    {
+      barrier_t *barrier;
+      unsigned long num_reads;
+      unsigned long num_writes;
+      unsigned long num_retries;
+      unsigned long num_errors;
+      int id;
+    };
+    char padding[CACHE_LINE_SIZE];
+  };
+} thread_data_t;
+
+static inline void
+object_write(const uint64_t val)
+{
+  int w;
+  for (w = 0; w < num_words; w++)
+    {
+      object[w] = val;
+    }
+}
+
+static inline void
+object_read(uint64_t* copy)
+{
+  int w;
+  for (w = 0; w < num_words; w++)
+    {
+      copy[w] = object[w];
+    }
+}
+
+/* a consistent copy has the same version in all words */
+static inline int
+object_torn(const uint64_t* copy)
+{
+  int w;
+  for (w = 1; w < num_words; w++)
+    {
+      if (copy[w] != copy[0])
+	{
+	  return 1;
+	}
+    }
+  return 0;
+}
+
+void*
+test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  phys_id = the_cores[d->id];
+  if (do_set_cpu && num_threads <= 40)
+    {
+      set_cpu(phys_id);
+    }
+
+  seeds = seed_rand();
+
+  uint64_t* copy = (uint64_t*) malloc(num_words * sizeof(uint64_t));
+  assert(copy != NULL);
+  size_t num_reads = 0, num_writes = 0, num_retries = 0, num_errors = 0;
+  uint64_t my_version = d->id;
+
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  while (stop == 0)
+    {
+      const int do_write = (my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) % 100) < writes;
+      if (do_write)
+	{
+	  my_version += num_threads; /* unique per thread */
+	  switch (mode)
+	    {
+	    case MODE_SEQ:
+	      lock_in_seq_write_lock(&seq);
+	      object_write(my_version);
+	      lock_in_seq_write_unlock(&seq);
+	      break;
+	    case MODE_RW:
+	      pthread_rwlock_wrlock(&rwlock);
+	      object_write(my_version);
+	      pthread_rwlock_unlock(&rwlock);
+	      break;
+	    default:
+	      pthread_mutex_lock(&mutex);
+	      object_write(my_version);
+	      pthread_mutex_unlock(&mutex);
+	      break;
+	    }
+	  num_writes++;
+	}
+      else
+	{
+	  switch (mode)
+	    {
+	    case MODE_SEQ:
+	      {
+		uint64_t v;
+		int retries = -1;
+		do
+		  {
+		    retries++;
+		    v = lock_in_seq_read_begin(&seq);
+		    object_read(copy);
+		  }
+		while (lock_in_seq_read_retry(&seq, v));
+		num_retries += retries;
+	      }
+	      break;
+	    case MODE_RW:
+	      pthread_rwlock_rdlock(&rwlock);
+	      object_read(copy);
+	      pthread_rwlock_unlock(&rwlock);
+	      break;
+	    default:
+	      pthread_mutex_lock(&mutex);
+	      object_read(copy);
+	      pthread_mutex_unlock(&mutex);
+	      break;
+	    }
+	  num_errors += object_torn(copy);
+	  num_reads++;
+	}
+
+      if (acq_delay > 0)
+	{
+	  cpause(acq_delay);
+	}
+    }
+
+  free(copy);
+  d->num_reads = num_reads;
+  d->num_writes = num_writes;
+  d->num_retries = num_retries;
+  d->num_errors = num_errors;
+  return NULL;
+}
+
+
+void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] =
+    {
+      // These options don't set a flag
+      {"help",                      no_argument,       NULL, 'h'},
+      {"verbose",                   no_argument,       NULL, 'v'},
+      {"lines",                     required_argument, NULL, 'c'},
+      {"writes",                    required_argument, NULL, 'w'},
+      {"mode",                      required_argument, NULL, 'm'},
+      {"duration",                  required_argument, NULL, 'd'},
+      {"num-threads",               required_argument, NULL, 'n'},
+      {"set-cpu",                   required_argument, NULL, 's'},
+      {"pause",                     required_argument, NULL, 'p'},
+      {NULL, 0, NULL, 0}
+    };
+
+  int i, c;
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  struct timeval start, end;
+  struct timespec timeout;
+  duration = DEFAULT_DURATION;
+  num_lines = DEFAULT_NUM_LINES;
+  writes = DEFAULT_WRITES;
+  mode = DEFAULT_MODE;
+  do_set_cpu = DEFAULT_SET_CPU;
+  num_threads = DEFAULT_NUM_THREADS;
+  acq_delay = DEFAULT_ACQ_DELAY;
+  verbose = DEFAULT_VERBOSE;
+
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hvc:w:m:d:n:s:p:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      if(c == 0 && long_options[i].flag == 0)
+	c = long_options[i].val;
+
+      switch(c)
+	{
+	case 0:
+	  /* Flag is automatically set */
+	  break;
+	case 'h':
+	  printf("seqlock read-scaling stress test\n"
+		 "\n"
+		 "Usage:\n"
+		 "  stress_seq_in [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -c, --lines <int>\n"
+		 "        Size of the shared object in cache lines (default=" XSTR(DEFAULT_NUM_LINES) ")\n"
+		 "  -w, --writes <int>\n"
+		 "        Percentage of write operations (default=" XSTR(DEFAULT_WRITES) ")\n"
+		 "  -m, --mode <int>\n"
+		 "        Synchronization: 0 = seqlock, 1 = rwlock, 2 = mutex (default=" XSTR(DEFAULT_MODE) ")\n"
+		 "  -d, --duration <int>\n"
+		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+		 "  -s, --set-cpu <int>\n"
+		 "        Pin threads to cores, or not (default=" XSTR(DEFAULT_SET_CPU) ")\n"
+		 "  -p, --pause <int>\n"
+		 "        Number of cycles between consecutive operations (default=" XSTR(DEFAULT_ACQ_DELAY) ")\n"
+		 );
+	  exit(0);
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'c':
+	  num_lines = atoi(optarg);
+	  break;
+	case 'w':
+	  writes = atoi(optarg);
+	  break;
+	case 'm':
+	  mode = atoi(optarg);
+	  break;
+	case 'd':
+	  duration = atoi(optarg);
+	  break;
+	case 'n':
+	  num_threads = atoi(optarg);
+	  break;
+	case 's':
+	  do_set_cpu = atoi(optarg);
+	  break;
+	case 'p':
+	  acq_delay = atoi(optarg);
+	  break;
+	case '?':
+	  printf("Use -h or --help for help\n");
+	  exit(0);
+	default:
+	  exit(1);
+	}
+    }
+  assert(duration >= 0);
+  assert(num_lines >= 1);
+  assert(writes >= 0 && writes <= 100);
+  assert(mode >= MODE_SEQ && mode <= MODE_MUTEX);
+  assert(num_threads > 0);
+  assert(acq_delay >= 0);
+
+  num_words = num_lines * WORDS_PER_LINE;
+  object = (volatile uint64_t*) aligned_alloc(CACHE_LINE_SIZE, num_lines * CACHE_LINE_SIZE);
+  assert(object != NULL);
+  object_write(0);
+
+  lock_in_seq_init(&seq);
+  pthread_rwlock_init(&rwlock, NULL);
+  pthread_mutex_init(&mutex, NULL);
+
+  if (verbose)
+    {
+      printf("Object size (lines)    : %d\n", num_lines);
+      printf("Write percentage       : %d\n", writes);
+      printf("Duration               : %d\n", duration);
+      printf("Number of threads      : %d\n", num_threads);
+      printf("Delay between ops      : %d\n", acq_delay);
+    }
+  timeout.tv_sec = duration / 1000;
+  timeout.tv_nsec = (duration % 1000) * 1000000;
+
+
+  if ((data = (thread_data_t *)malloc(num_threads * sizeof(thread_data_t))) == NULL)
+    {
+      perror("malloc");
+      exit(1);
+    }
+  if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  const char* mode_names[] = { "seqlock", "rwlock", "mutex" };
+  printf("## lock algo : %s\n", lock_in_lock_name());
+  printf("## mode      : %s ( %d%% writes, %d lines)\n", mode_names[mode], writes, num_lines);
+
+  if(duration > 0)
+    {
+      stop = 0;
+    }
+
+  /* Access set from all threads */
+  barrier_init(&barrier, num_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < num_threads; i++)
+    {
+      data[i].id = i;
+      data[i].num_reads = 0;
+      data[i].num_writes = 0;
+      data[i].num_retries = 0;
+      data[i].num_errors = 0;
+      data[i].barrier = &barrier;
+      if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0)
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR)
+    {
+      perror("signal");
+      exit(1);
+    }
+
+  RR_INIT_ALL();
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  gettimeofday(&start, NULL);
+
+  RR_START_UNPROTECTED_ALL();
+  if (duration > 0)
+    {
+      nanosleep(&timeout, NULL);
+    }
+  stop = 1;
+  RR_STOP_UNPROTECTED_ALL();
+
+  gettimeofday(&end, NULL);
+  /* Wait for thread completion */
+  for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_join(threads[i], NULL) != 0)
+	{
+	  fprintf(stderr, "Error waiting for thread completion\n");
+	  exit(1);
+	}
+    }
+
+  duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+
+  unsigned long reads = 0, writes_done = 0, retries = 0, errors = 0;
+  for (i = 0; i < num_threads; i++)
+    {
+      if (verbose)
+	{
+	  printf("Thread: %3d : #reads %-10lu #writes %-10lu #retries %lu\n",
+		 i, data[i].num_reads, data[i].num_writes, data[i].num_retries);
+	}
+      reads += data[i].num_reads;
+      writes_done += data[i].num_writes;
+      retries += data[i].num_retries;
+      errors += data[i].num_errors;
+    }
+
+  if (errors)
+    {
+      printf("*** error: %lu torn reads\n", errors);
+    }
+
+  RR_PRINT_UNPROTECTED(RAPL_PRINT_ENE);
+
+  const unsigned long ops = reads + writes_done;
+  printf("#reads       : %10lu ( %10.0f / s)\n", reads, reads * 1000.0 / duration);
+  printf("#writes      : %10lu ( %10.0f / s)\n", writes_done, writes_done * 1000.0 / duration);
+  printf("#retries     : %10lu ( %10.4f / read)\n", retries, reads ? (double) retries / reads : 0.0);
+  printf("#ops         : %10lu ( %10.0f / s)\n", ops, ops * 1000.0 / duration);
+
+  rapl_stats_t s;
+  RR_STATS(&s);
+  double eop0 = (1e6 * s.energy_total[NUMBER_OF_SOCKETS]) / ops;
+  double eop1 = (1e6 * s.energy_package[NUMBER_OF_SOCKETS]) / ops;
+  double eop2 = (1e6 * s.energy_pp0[NUMBER_OF_SOCKETS]) / ops;
+  printf("#eop (uJ/op) : %10f | %10f | %10f\n", eop0, eop1, eop2);
+
+  lock_in_seq_destroy(&seq);
+  free((void*) object);
+  free(threads);
+  free(data);
+
+  return 0;
+}
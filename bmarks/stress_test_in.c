@@ -11,6 +11,9 @@
 
 #include "rapl_read.h"
 #include "lock_in.h"
+#include "dist.h"
+#include "lock_in_exec.h"
+#include "perf_in.h"
 
 #define DELAY_NONE    0
 #define DELAY_NORMAL  1
@@ -29,6 +32,8 @@
 #define DEFAULT_SET_CPU 1
 //total number of locks
 #define DEFAULT_NUM_LOCKS 1
+//which lock an acquisition picks (see dist.h)
+#define DEFAULT_DIST "uniform"
 //number of lock acquisitions in this test
 #define DEFAULT_NUM_ACQ 10000
 //delay between consecutive acquire attempts in cycles
@@ -47,6 +52,14 @@
 //which level of prints to do with RAPL
 #define DEFAULT_POW_PRINT RAPL_PRINT_ENE
 #define DEFAULT_VERBOSE 0
+//0: acquire the locks, 1: delegate the critical sections (flat combining), 2: delegate to a server thread
+#define DEFAULT_DELEGATE 0
+//count hardware events per acquire with perf_event_open
+#define DEFAULT_PERF 0
+
+#define DELEGATE_NONE    0
+#define DELEGATE_COMBINE 1
+#define DELEGATE_SERVER  2
 
 static volatile int stop = 0;
 
@@ -64,6 +77,8 @@ __attribute__((aligned(CACHE_LINE_SIZE))) volatile shared_data* protected_data;
 __attribute__((aligned(CACHE_LINE_SIZE))) volatile uint32_t* protected_offsets;
 int duration;
 int num_locks;
+const char* dist_spec;
+dist_t* dist;
 int do_set_cpu;
 int do_writes;
 int num_threads;
@@ -74,6 +89,9 @@ int mutex_delay;
 int cl_access;
 int power_print;
 int verbose;
+int delegate;
+int do_perf;
+perf_in_t* perfs;
 
 typedef struct barrier 
 {
@@ -117,6 +135,8 @@ typedef struct thread_data {
       unsigned long num_acquires;
       unsigned long num_consecutive_acq;
       unsigned long fair_delay;
+      unsigned long num_batches;
+      unsigned long num_combined;
       int id;
     };
     char padding[CACHE_LINE_SIZE];
@@ -128,11 +148,55 @@ typedef struct thread_data {
 size_t shared_counter = 0;
 #endif
 
+/* the critical section, as a closure for lock_in_execute */
+typedef struct cs_arg
+{
+  int lock_to_acq;
+  int id;
+  size_t sum;
+#if DELAY == DELAY_FAIR
+  size_t counter_prev;
+  size_t num_consecutive_acq;
+#endif
+} cs_arg_t;
+
+void*
+cs_execute(void* arg)
+{
+  cs_arg_t* a = (cs_arg_t*) arg;
+#if DELAY == DELAY_FAIR
+  if (shared_counter++ == a->counter_prev)
+    {
+      a->num_consecutive_acq++;
+    }
+  a->counter_prev = shared_counter;
+#endif
+
+#if DELAY >= DELAY_NORMAL
+  if (acq_duration > 0)
+    {
+      cpause(acq_duration);
+    }
+  uint32_t i;
+  for (i = 0; i < cl_access; i++)
+    {
+      if (do_writes == 1) 
+	{
+	  protected_data[i + protected_offsets[a->lock_to_acq]].the_data[0] += a->id;
+	} 
+      else 
+	{
+	  a->sum += protected_data[i + protected_offsets[a->lock_to_acq]].the_data[0];
+	}
+    }
+#endif
+  return NULL;
+}
+
 void*
 test(void *data)
 {
   thread_data_t *d = (thread_data_t *)data;
-  int rand_max = num_locks - 1;
   phys_id = the_cores[d->id];
   if (do_set_cpu && num_threads <= 40)
     {
@@ -156,9 +220,46 @@ test(void *data)
   /* Wait on barrier */
   barrier_cross(d->barrier);
 
-  while (stop == 0) 
+  if (do_perf)
+    {
+      perf_in_start(perfs + d->id);
+    }
+
+  if (delegate != DELEGATE_NONE)
     {
-      int lock_to_acq = (int) my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & rand_max;
+      cs_arg_t a = { .id = d->id, .sum = 0 };
+#if DELAY == DELAY_FAIR
+      a.counter_prev = -1;
+      a.num_consecutive_acq = 0;
+#endif
+      while (stop == 0) 
+	{
+	  a.lock_to_acq = (int) dist_next(dist, seeds);
+	  lock_in_execute(locks + a.lock_to_acq, cs_execute, &a);
+
+#if DELAY >= DELAY_NORMAL
+	  if (acq_delay > 0) 
+	    {
+	      cpause(acq_delay);
+	    }
+#endif
+#if DELAY == DELAY_FAIR
+	  if (d->fair_delay)
+	    {
+	      cpause(d->fair_delay);
+	    }
+#endif
+	  num_acquires++;
+	}
+#if DELAY == DELAY_FAIR
+      num_consecutive_acq = a.num_consecutive_acq;
+#endif
+      sum = a.sum;
+    }
+
+  while (stop == 0 && delegate == DELEGATE_NONE) 
+    {
+      int lock_to_acq = (int) dist_next(dist, seeds);
       pthread_mutex_t* lock = locks + lock_to_acq;
       pthread_mutex_lock(lock);      
 
@@ -209,10 +310,17 @@ test(void *data)
       num_acquires++;
     }
 
+  if (do_perf)
+    {
+      perf_in_stop(perfs + d->id);
+    }
+
   d->num_acquires = num_acquires;
 #if DELAY == DELAY_FAIR
   d->num_consecutive_acq = num_consecutive_acq;
 #endif
+  d->num_batches = lock_in_exec_n_batches;
+  d->num_combined = lock_in_exec_n_ops;
   return NULL;
 }
 
@@ -235,6 +343,7 @@ main(int argc, char **argv)
       {"help",                      no_argument,       NULL, 'h'},
       {"verbose",                   no_argument,       NULL, 'v'},
       {"locks",                     required_argument, NULL, 'l'},
+      {"dist",                      required_argument, NULL, 'D'},
       {"duration",                  required_argument, NULL, 'd'},
       {"num-threads",               required_argument, NULL, 'n'},
       {"set-cpu",                   required_argument, NULL, 's'},
@@ -244,6 +353,8 @@ main(int argc, char **argv)
       {"do_writes",                 required_argument, NULL, 'w'},
       {"clines",                    required_argument, NULL, 'c'},
       {"power",                     required_argument, NULL, 'o'},
+      {"delegate",                  required_argument, NULL, 'e'},
+      {"perf",                      required_argument, NULL, 'P'},
       {NULL, 0, NULL, 0}
     };
 
@@ -256,6 +367,7 @@ main(int argc, char **argv)
   struct timespec timeout;
   duration = DEFAULT_DURATION;
   num_locks = DEFAULT_NUM_LOCKS;
+  dist_spec = DEFAULT_DIST;
   do_set_cpu = DEFAULT_SET_CPU;
   do_writes = DEFAULT_DO_WRITES;
   num_threads = DEFAULT_NUM_THREADS;
@@ -265,13 +377,15 @@ main(int argc, char **argv)
   cl_access = DEFAULT_CL_ACCESS;
   power_print = DEFAULT_POW_PRINT;
   verbose = DEFAULT_VERBOSE;
+  delegate = DEFAULT_DELEGATE;
+  do_perf = DEFAULT_PERF;
 
   /* sigset_t block_set; */
 
   while(1) 
     {
       i = 0;
-      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:", long_options, &i);
+      c = getopt_long(argc, argv, "hvd:n:s:l:w:a:p:c:o:f:e:D:P:", long_options, &i);
 
       if(c == -1)
 	break;
@@ -295,6 +409,8 @@ main(int argc, char **argv)
 		 "        Print this message\n"
 		 "  -l, --lcoks <int>\n"
 		 "        Number of locks in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -D, --dist <spec>\n"
+		 "        Which lock an acquisition picks: " DIST_SPEC_HELP " (default=" DEFAULT_DIST ")\n"
 		 "  -d, --duration <int>\n"
 		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
 		 "  -n, --num-threads <int>\n"
@@ -313,6 +429,11 @@ main(int argc, char **argv)
 		 "        Number of cache lines written in every critical section (default=" XSTR(DEFAULT_CL_ACCESS) ")\n"
 		 "  -p, --power <int>\n"
 		 "        Print output level for RAPL power measurements (default=" XSTR(DEFAULT_POW_PRINT) ")\n"
+		 "  -e, --delegate <int>\n"
+		 "        Delegate the critical sections instead of acquiring the locks: 0 = no,\n"
+		 "        1 = flat combining, 2 = dedicated server thread (default=" XSTR(DEFAULT_DELEGATE) ")\n"
+		 "  -P, --perf <int>\n"
+		 "        Count hardware events per acquire, see perf_in.h (default=" XSTR(DEFAULT_PERF) ")\n"
 		 );
 	  exit(0);
 	case 'v':
@@ -321,6 +442,9 @@ main(int argc, char **argv)
 	case 'l':
 	  num_locks = atoi(optarg);
 	  break;
+	case 'D':
+	  dist_spec = optarg;
+	  break;
 	case 'd':
 	  duration = atoi(optarg);
 	  break;
@@ -358,6 +482,12 @@ main(int argc, char **argv)
 	case 'o':
 	  power_print = atoi(optarg);
 	  break;
+	case 'e':
+	  delegate = atoi(optarg);
+	  break;
+	case 'P':
+	  do_perf = atoi(optarg);
+	  break;
 	case '?':
 	  printf("Use -h or --help for help\n");
 	  exit(0);
@@ -368,13 +498,19 @@ main(int argc, char **argv)
   mutex_delay=(num_threads-1) * 30;
   acq_delay=acq_delay;
   acq_duration=acq_duration;
-  num_locks=pow2roundup(num_locks);
   assert(duration >= 0);
   assert(num_locks >= 1);
+  dist = dist_new(dist_spec, num_locks);
+  if (dist == NULL)
+    {
+      fprintf(stderr, "Invalid lock distribution: %s\n", dist_spec);
+      exit(1);
+    }
   assert(num_threads > 0);
   assert(acq_duration >= 0);
   assert(acq_delay >= 0);
   assert(cl_access >= 0);
+  assert(delegate >= DELEGATE_NONE && delegate <= DELEGATE_SERVER);
 
   if (cl_access > 0)
     {
@@ -423,6 +559,14 @@ main(int argc, char **argv)
   }
 
   printf("## lock algo : %s\n", lock_in_lock_name());
+  if (strcmp(dist_spec, DEFAULT_DIST) != 0)
+    {
+      printf("## lock dist : %s (hottest lock: %.2f%% of the acquisitions)\n", dist_spec, 100 * dist->top);
+    }
+  if (delegate != DELEGATE_NONE)
+    {
+      printf("## delegate  : %s\n", (delegate == DELEGATE_COMBINE) ? "flat combining" : "server");
+    }
 #if DELAY == DELAY_FAIR
   fair_delay = ((num_threads != 1) * DEFAULT_FAIR_DELAY_BASE) + (fair_delay * (num_threads - 1));
   printf("## fair delay: %d\n", fair_delay);
@@ -433,6 +577,13 @@ main(int argc, char **argv)
       stop = 0;
     }
 
+  if (do_perf)
+    {
+      perf_in_init();
+      perfs = (perf_in_t*) calloc(num_threads, sizeof(perf_in_t));
+      assert(perfs != NULL);
+    }
+
   /* Access set from all threads */
   barrier_init(&barrier, num_threads + 1);
   pthread_attr_init(&attr);
@@ -461,6 +612,25 @@ main(int argc, char **argv)
       exit(1);
     }
 
+  pthread_t server;
+  if (delegate == DELEGATE_SERVER)
+    {
+      for (l = 0; l < num_locks; l++)
+	{
+	  lock_in_exec_serve(locks + l);
+	}
+      /* the server gets the core after the threads, if there is one */
+      const int ncores = hw_ctx_nr_get();
+      const int pin = do_set_cpu && num_threads < ncores
+	&& num_threads < (int) (sizeof(the_cores) / sizeof(the_cores[0]));
+      int server_core = pin ? (int) the_cores[num_threads] : -1;
+      if (lock_in_exec_server_start(&server, server_core) != 0)
+	{
+	  fprintf(stderr, "Error creating server thread\n");
+	  exit(1);
+	}
+    }
+
   RR_INIT_ALL();
 
   /* Start threads */
@@ -486,6 +656,10 @@ main(int argc, char **argv)
 	  exit(1);
 	}
     }
+  if (delegate == DELEGATE_SERVER)
+    {
+      lock_in_exec_server_stop(server);
+    }
 
   if (verbose)
     {
@@ -502,6 +676,7 @@ main(int argc, char **argv)
 
   unsigned long acquires = 0;
   unsigned long consecutive_acq = 0;
+  unsigned long batches = 0, combined = 0;
   for (i = 0; i < num_threads; i++) 
     {
       if (verbose)
@@ -513,6 +688,8 @@ main(int argc, char **argv)
 	}
       acquires += data[i].num_acquires;
       consecutive_acq += data[i].num_consecutive_acq;
+      batches += data[i].num_batches;
+      combined += data[i].num_combined;
     }
 
   if (verbose)
@@ -529,6 +706,28 @@ main(int argc, char **argv)
   double consecutive_acq_perc = (1-(thr - thr_q)/thr) * 100;
   printf("#consequtive  : %10lu ( %10.0f / s) = %.2f%%\n", consecutive_acq, thr_q, consecutive_acq_perc);
 #endif
+  if (delegate == DELEGATE_COMBINE && batches > 0)
+    {
+      printf("#combined     : %10lu ( %10lu batches = %.1f per batch)\n", 
+	     combined, batches, (double) combined / batches);
+    }
+  if (delegate == DELEGATE_SERVER && lock_in_exec_server_n_batches > 0)
+    {
+      printf("#server       : %10zu ops in %10zu batches (%.1f per batch)\n", 
+	     lock_in_exec_server_n_ops, lock_in_exec_server_n_batches,
+	     (double) lock_in_exec_server_n_ops / lock_in_exec_server_n_batches);
+    }
+  if (do_perf)
+    {
+      perf_in_t perf;
+      memset(&perf, 0, sizeof(perf));
+      for (i = 0; i < num_threads; i++)
+	{
+	  perf_in_merge(&perf, perfs + i);
+	}
+      perf_in_report(&perf, acquires);
+      free(perfs);
+    }
   rapl_stats_t s;
   RR_STATS(&s);
 
@@ -545,6 +744,7 @@ main(int argc, char **argv)
   dvfs_freq_set_all_max();
 #endif
  free(locks);
+  dist_destroy(dist);
   free(threads);
   free(data);
 
@@ -0,0 +1,626 @@
+#include <assert.h>
+#include <getopt.h>
+#include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <time.h>
+#include "utils.h"
+
+#include "rapl_read.h"
+#include "lock_in.h"
+#include "lock_in_uring.h"
+
+/* Mixes io_uring disk reads with lock acquisitions: every thread keeps -q
+   reads in flight on its own ring and acquires the locks with
+   lock_in_uring_lock. While a thread waits for a lock (in the ring), it keeps
+   reaping and re-issuing its reads. */
+
+#define STR(s) #s
+#define XSTR(s) STR(s)
+
+//number of concurres threads
+#define DEFAULT_NUM_THREADS 1
+//whether or not to set cpu
+#define DEFAULT_SET_CPU 1
+//total number of locks
+#define DEFAULT_NUM_LOCKS 1
+//delay between consecutive acquire attempts in cycles
+#define DEFAULT_ACQ_DELAY 0
+//delay between lock acquire and release in cycles
+#define DEFAULT_ACQ_DURATION 0
+//the total duration of a test
+#define DEFAULT_DURATION 1000
+//number of reads in flight per thread
+#define DEFAULT_IO_DEPTH 4
+//size of each read in bytes
+#define DEFAULT_IO_SIZE 4096
+//size of the file to create (if none is given) in MB
+#define DEFAULT_FILE_SIZE_MB 64
+//use O_DIRECT for the reads
+#define DEFAULT_IO_DIRECT 0
+#define DEFAULT_FILE "/tmp/stress_uring_in.dat"
+#define DEFAULT_VERBOSE 0
+
+static volatile int stop = 0;
+
+__thread unsigned long* seeds;
+__thread uint32_t phys_id;
+__thread int io_inflight;
+
+pthread_mutex_t* locks;
+int duration;
+int num_locks;
+int do_set_cpu;
+int num_threads;
+int acq_duration;
+int acq_delay;
+int io_depth;
+int io_size;
+int io_direct;
+size_t file_size_mb;
+char* file_name;
+size_t file_blocks;
+int verbose;
+
+typedef struct barrier
+{
+  pthread_cond_t complete;
+  pthread_mutex_t mutex;
+  int count;
+  int crossing;
+} barrier_t;
+
+void barrier_init(barrier_t *b, int n)
+{
+  pthread_cond_init(&b->complete, NULL);
+  pthread_mutex_init(&b->mutex, NULL);
+  b->count = n;
+  b->crossing = 0;
+}
+
+void barrier_cross(barrier_t *b)
+{
+  pthread_mutex_lock(&b->mutex);
+  /* One more thread through */
+  b->crossing++;
+  /* If not all here, wait */
+  if (b->crossing < b->count) {
+    pthread_cond_wait(&b->complete, &b->mutex);
+  } else {
+    pthread_cond_broadcast(&b->complete);
+    /* Reset for next time */
+    b->crossing = 0;
+  }
+  pthread_mutex_unlock(&b->mutex);
+}
+
+
+typedef struct thread_data
+{
+  union
+  {
+    struct
+    {
+      barrier_t *barrier;
+      unsigned long num_acquires;
+      unsigned long num_lock_waits;
+      unsigned long num_futex_waits;
+      unsigned long num_ios;
+      unsigned long num_ios_waiting;
+      ticks ticks_lock;
+      int id;
+    };
+    char padding[2 * CACHE_LINE_SIZE];
+  };
+} thread_data_t;
+
+static inline void
+io_submit_read(struct io_uring* ring, int fd, char* buf, const int i)
+{
+  struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+  assert(sqe != NULL);
+  size_t block = my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & (file_blocks - 1);
+  io_uring_prep_read(sqe, fd, buf + (size_t) i * io_size, io_size, block * io_size);
+  io_inflight++;
+  /* lock-wait tokens use the lowest bit of user_data */
+  io_uring_sqe_set_data64(sqe, ((uint64_t) i) << 1);
+}
+
+static inline void
+io_complete(thread_data_t* d, struct io_uring* ring, int fd, char* buf, struct io_uring_cqe* cqe)
+{
+  if (cqe->res < 0)
+    {
+      fprintf(stderr, "[%d] read failed: %s\n", d->id, strerror(-cqe->res));
+      exit(1);
+    }
+  const int i = io_uring_cqe_get_data64(cqe) >> 1;
+  io_uring_cqe_seen(ring, cqe);
+  io_inflight--;
+  d->num_ios++;
+  if (!stop)
+    {
+      io_submit_read(ring, fd, buf, i);
+      io_uring_submit(ring);
+    }
+}
+
+void*
+test(void *data)
+{
+  thread_data_t *d = (thread_data_t *)data;
+  int rand_max = num_locks - 1;
+  phys_id = the_cores[d->id];
+  if (do_set_cpu)
+    {
+      set_cpu(phys_id);
+    }
+
+  seeds = seed_rand();
+
+  struct io_uring ring;
+  int ret = io_uring_queue_init(2 * io_depth + 2, &ring, 0);
+  if (ret < 0)
+    {
+      fprintf(stderr, "io_uring_queue_init: %s\n", strerror(-ret));
+      exit(1);
+    }
+
+  int fd = open(file_name, O_RDONLY | (io_direct ? O_DIRECT : 0));
+  if (fd < 0)
+    {
+      perror("open");
+      exit(1);
+    }
+
+  char* buf;
+  if (posix_memalign((void**) &buf, 4096, (size_t) io_depth * io_size))
+    {
+      perror("posix_memalign");
+      exit(1);
+    }
+
+  int i;
+  for (i = 0; i < io_depth; i++)
+    {
+      io_submit_read(&ring, fd, buf, i);
+    }
+  io_uring_submit(&ring);
+
+  size_t num_acquires = 0;
+  lock_in_uring_t token;
+  struct io_uring_cqe* cqe;
+
+  /* Wait on barrier */
+  barrier_cross(d->barrier);
+
+  while (stop == 0)
+    {
+      int lock_to_acq = (int) my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) & rand_max;
+
+      volatile ticks s_lock = getticks();
+      if (lock_in_uring_lock(&ring, locks + lock_to_acq, &token) == EINPROGRESS)
+	{
+	  d->num_lock_waits++;
+	  int acquired = 0;
+	  while (!acquired)
+	    {
+	      io_uring_wait_cqe(&ring, &cqe);
+	      if (lock_in_uring_token(cqe) == &token)
+		{
+		  const int res = cqe->res;
+		  io_uring_cqe_seen(&ring, cqe);
+		  acquired = (lock_in_uring_complete(&ring, &token, res) == 0);
+		}
+	      else
+		{
+		  d->num_ios_waiting++;
+		  io_complete(d, &ring, fd, buf, cqe);
+		}
+	    }
+	  d->num_futex_waits += token.num_waits;
+	}
+      volatile ticks e_lock = getticks();
+
+      if (acq_duration > 0)
+	{
+	  cpause(acq_duration);
+	}
+
+      pthread_mutex_unlock(locks + lock_to_acq);
+
+      d->ticks_lock += (e_lock - s_lock);
+
+      /* reap (at most io_depth) ready reads; cached reads complete inline */
+      for (i = 0; i < io_depth && io_uring_peek_cqe(&ring, &cqe) == 0; i++)
+	{
+	  io_complete(d, &ring, fd, buf, cqe);
+	}
+
+      if (acq_delay > 0)
+	{
+	  cpause(acq_delay);
+	}
+
+      num_acquires++;
+    }
+
+  /* drain the reads that are still in flight */
+  size_t num_ios = d->num_ios;
+  while (io_inflight > 0)
+    {
+      io_uring_wait_cqe(&ring, &cqe);
+      io_complete(d, &ring, fd, buf, cqe);
+    }
+  d->num_ios = num_ios;
+
+  io_uring_queue_exit(&ring);
+  close(fd);
+  free(buf);
+
+  d->num_acquires = num_acquires;
+  return NULL;
+}
+
+static void
+file_create(const char* name, const size_t size)
+{
+  struct stat st;
+  if (stat(name, &st) == 0 && (size_t) st.st_size >= size)
+    {
+      return;
+    }
+
+  int fd = open(name, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      perror("open");
+      exit(1);
+    }
+  char* block = calloc(1, 1 << 20);
+  assert(block != NULL);
+  size_t w;
+  for (w = 0; w < size; w += (1 << 20))
+    {
+      memset(block, (int) (w >> 20), 1 << 20);
+      if (write(fd, block, 1 << 20) != (1 << 20))
+	{
+	  perror("write");
+	  exit(1);
+	}
+    }
+  fsync(fd);
+  close(fd);
+  free(block);
+}
+
+
+void catcher(int sig)
+{
+  static int nb = 0;
+  printf("CAUGHT SIGNAL %d\n", sig);
+  if (++nb >= 3)
+    exit(1);
+}
+
+
+int
+main(int argc, char **argv)
+{
+  struct option long_options[] =
+    {
+      // These options don't set a flag
+      {"help",                      no_argument,       NULL, 'h'},
+      {"verbose",                   no_argument,       NULL, 'v'},
+      {"locks",                     required_argument, NULL, 'l'},
+      {"duration",                  required_argument, NULL, 'd'},
+      {"num-threads",               required_argument, NULL, 'n'},
+      {"set-cpu",                   required_argument, NULL, 's'},
+      {"acquire",                   required_argument, NULL, 'a'},
+      {"pause",                     required_argument, NULL, 'p'},
+      {"io-depth",                  required_argument, NULL, 'q'},
+      {"io-size",                   required_argument, NULL, 'b'},
+      {"io-direct",                 required_argument, NULL, 'D'},
+      {"file",                      required_argument, NULL, 'F'},
+      {"file-size",                 required_argument, NULL, 'S'},
+      {NULL, 0, NULL, 0}
+    };
+
+  int i, c;
+  thread_data_t *data;
+  pthread_t *threads;
+  pthread_attr_t attr;
+  barrier_t barrier;
+  struct timeval start, end;
+  struct timespec timeout;
+  duration = DEFAULT_DURATION;
+  num_locks = DEFAULT_NUM_LOCKS;
+  do_set_cpu = DEFAULT_SET_CPU;
+  num_threads = DEFAULT_NUM_THREADS;
+  acq_duration = DEFAULT_ACQ_DURATION;
+  acq_delay = DEFAULT_ACQ_DELAY;
+  io_depth = DEFAULT_IO_DEPTH;
+  io_size = DEFAULT_IO_SIZE;
+  io_direct = DEFAULT_IO_DIRECT;
+  file_size_mb = DEFAULT_FILE_SIZE_MB;
+  file_name = NULL;
+  verbose = DEFAULT_VERBOSE;
+
+  while(1)
+    {
+      i = 0;
+      c = getopt_long(argc, argv, "hvd:n:s:l:a:p:q:b:D:F:S:", long_options, &i);
+
+      if(c == -1)
+	break;
+
+      if(c == 0 && long_options[i].flag == 0)
+	c = long_options[i].val;
+
+      switch(c)
+	{
+	case 0:
+	  /* Flag is automatically set */
+	  break;
+	case 'h':
+	  printf("lock stress test with io_uring reads and async lock waits\n"
+		 "\n"
+		 "Usage:\n"
+		 "  stress_uring_in [options...]\n"
+		 "\n"
+		 "Options:\n"
+		 "  -h, --help\n"
+		 "        Print this message\n"
+		 "  -l, --locks <int>\n"
+		 "        Number of locks in the test (default=" XSTR(DEFAULT_NUM_LOCKS) ")\n"
+		 "  -d, --duration <int>\n"
+		 "        Test duration in milliseconds (0=infinite, default=" XSTR(DEFAULT_DURATION) ")\n"
+		 "  -n, --num-threads <int>\n"
+		 "        Number of threads (default=" XSTR(DEFAULT_NUM_THREADS) ")\n"
+		 "  -s, --set-cpu <int>\n"
+		 "        Pin threads to cores, or not (default=" XSTR(DEFAULT_SET_CPU) ")\n"
+		 "  -a, --acquire <int>\n"
+		 "        Number of cycles a lock is held (default=" XSTR(DEFAULT_ACQ_DURATION) ")\n"
+		 "  -p, --pause <int>\n"
+		 "        Number of cycles between a lock release and the next acquire (default=" XSTR(DEFAULT_ACQ_DELAY) ")\n"
+		 "  -q, --io-depth <int>\n"
+		 "        Number of reads in flight per thread (default=" XSTR(DEFAULT_IO_DEPTH) ")\n"
+		 "  -b, --io-size <int>\n"
+		 "        Size of every read in bytes (default=" XSTR(DEFAULT_IO_SIZE) ")\n"
+		 "  -D, --io-direct <int>\n"
+		 "        Bypass the page cache with O_DIRECT, or not (default=" XSTR(DEFAULT_IO_DIRECT) ")\n"
+		 "  -F, --file <string>\n"
+		 "        File to read from (default: create " DEFAULT_FILE ")\n"
+		 "  -S, --file-size <int>\n"
+		 "        Size in MB of the file to create (default=" XSTR(DEFAULT_FILE_SIZE_MB) ")\n"
+		 );
+	  exit(0);
+	case 'v':
+	  verbose = 1;
+	  break;
+	case 'l':
+	  num_locks = atoi(optarg);
+	  break;
+	case 'd':
+	  duration = atoi(optarg);
+	  break;
+	case 'n':
+	  num_threads = atoi(optarg);
+	  break;
+	case 's':
+	  do_set_cpu = atoi(optarg);
+	  break;
+	case 'a':
+	  acq_duration = atoi(optarg);
+	  break;
+	case 'p':
+	  acq_delay = atoi(optarg);
+	  break;
+	case 'q':
+	  io_depth = atoi(optarg);
+	  break;
+	case 'b':
+	  io_size = atoi(optarg);
+	  break;
+	case 'D':
+	  io_direct = atoi(optarg);
+	  break;
+	case 'F':
+	  file_name = strdup(optarg);
+	  break;
+	case 'S':
+	  file_size_mb = atol(optarg);
+	  break;
+	case '?':
+	  printf("Use -h or --help for help\n");
+	  exit(0);
+	default:
+	  exit(1);
+	}
+    }
+  num_locks = pow2roundup(num_locks);
+  assert(duration >= 0);
+  assert(num_locks >= 1);
+  assert(num_threads > 0);
+  assert(acq_duration >= 0);
+  assert(acq_delay >= 0);
+  assert(io_depth > 0);
+  assert(io_size > 0 && (io_size & 511) == 0);
+
+  if (file_name == NULL)
+    {
+      file_name = DEFAULT_FILE;
+      file_create(file_name, file_size_mb << 20);
+    }
+
+  struct stat st;
+  if (stat(file_name, &st) != 0)
+    {
+      perror("stat");
+      exit(1);
+    }
+  file_blocks = st.st_size / io_size;
+  if (file_blocks == 0)
+    {
+      fprintf(stderr, "File %s is smaller than one read (%d bytes)\n", file_name, io_size);
+      exit(1);
+    }
+  /* my_random() & (file_blocks - 1) must stay within the file */
+  if (file_blocks & (file_blocks - 1))
+    {
+      file_blocks = pow2roundup(file_blocks) >> 1;
+    }
+
+  locks = (pthread_mutex_t*) malloc(num_locks * sizeof(pthread_mutex_t));
+  assert(locks != NULL);
+
+  int l;
+  for (l = 0; l < num_locks; l++)
+    {
+      pthread_mutex_init(locks + l, NULL);
+    }
+
+  if (verbose)
+    {
+      printf("Number of locks        : %d\n", num_locks);
+      printf("Duration               : %d\n", duration);
+      printf("Number of threads      : %d\n", num_threads);
+      printf("Lock is held for       : %d\n", acq_duration);
+      printf("Delay between locks    : %d\n", acq_delay);
+      printf("Reads in flight        : %d x %d bytes\n", io_depth, io_size);
+      printf("File                   : %s (%zu blocks)%s\n", file_name, file_blocks,
+	     io_direct ? " O_DIRECT" : "");
+      printf("Async lock waits       : %d\n", LOCK_IN_URING_ASYNC);
+    }
+  timeout.tv_sec = duration / 1000;
+  timeout.tv_nsec = (duration % 1000) * 1000000;
+
+  if ((data = (thread_data_t *)calloc(num_threads, sizeof(thread_data_t))) == NULL)
+    {
+      perror("malloc");
+      exit(1);
+    }
+  if ((threads = (pthread_t *)malloc(num_threads * sizeof(pthread_t))) == NULL) {
+    perror("malloc");
+    exit(1);
+  }
+
+  printf("## lock algo : %s\n", lock_in_lock_name());
+
+  if(duration > 0)
+    {
+      stop = 0;
+    }
+
+  /* Access set from all threads */
+  barrier_init(&barrier, num_threads + 1);
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_JOINABLE);
+  for (i = 0; i < num_threads; i++)
+    {
+      data[i].id = i;
+      data[i].barrier = &barrier;
+      if (pthread_create(&threads[i], &attr, test, (void *)(&data[i])) != 0)
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+  pthread_attr_destroy(&attr);
+
+  /* Catch some signals */
+  if (signal(SIGHUP, catcher) == SIG_ERR ||
+      signal(SIGINT, catcher) == SIG_ERR ||
+      signal(SIGTERM, catcher) == SIG_ERR)
+    {
+      perror("signal");
+      exit(1);
+    }
+
+  RR_INIT_ALL();
+
+  /* Start threads */
+  barrier_cross(&barrier);
+
+  gettimeofday(&start, NULL);
+
+  RR_START_UNPROTECTED_ALL();
+  if (duration > 0)
+    {
+      nanosleep(&timeout, NULL);
+    }
+  stop = 1;
+  RR_STOP_UNPROTECTED_ALL();
+
+  gettimeofday(&end, NULL);
+  /* Wait for thread completion */
+  for (i = 0; i < num_threads; i++)
+    {
+      if (pthread_join(threads[i], NULL) != 0)
+	{
+	  fprintf(stderr, "Error waiting for thread completion\n");
+	  exit(1);
+	}
+    }
+
+  duration = (end.tv_sec * 1000 + end.tv_usec / 1000) - (start.tv_sec * 1000 + start.tv_usec / 1000);
+
+  unsigned long acquires = 0, lock_waits = 0, futex_waits = 0, ios = 0, ios_waiting = 0;
+  ticks ticks_lock = 0;
+  for (i = 0; i < num_threads; i++)
+    {
+      if (verbose)
+	{
+	  printf("Thread: %3d : #acquire   : %lu\n", i, data[i].num_acquires);
+	  printf("              #lock waits: %lu\n", data[i].num_lock_waits);
+	  printf("              #ios       : %lu\n", data[i].num_ios);
+	}
+      acquires += data[i].num_acquires;
+      lock_waits += data[i].num_lock_waits;
+      futex_waits += data[i].num_futex_waits;
+      ios += data[i].num_ios;
+      ios_waiting += data[i].num_ios_waiting;
+      ticks_lock += data[i].ticks_lock;
+    }
+
+  if (verbose)
+    {
+      printf("Duration      : %d (ms)\n", duration);
+    }
+
+  RR_PRINT_UNPROTECTED(RAPL_PRINT_ENE);
+
+  double thr = (double) (acquires * 1000.0 / duration);
+  printf("#acquires     : %10lu ( %10.0f / s)\n", acquires, thr);
+  printf("#lock waits   : %10lu ( %5.2f%% of acquires, %.2f futex waits each)\n",
+	 lock_waits, 100.0 * lock_waits / (acquires ? acquires : 1),
+	 (double) futex_waits / (lock_waits ? lock_waits : 1));
+  printf("#ios          : %10lu ( %10.0f / s)\n", ios, ios * 1000.0 / duration);
+  printf("#ios in waits : %10lu ( %5.2f%% of ios)\n",
+	 ios_waiting, 100.0 * ios_waiting / (ios ? ios : 1));
+  printf("#lock ticks   : %-10llu\n", (unsigned long long) (ticks_lock / (acquires ? acquires : 1)));
+
+  rapl_stats_t s;
+  RR_STATS(&s);
+
+  double ppw0 = thr / s.power_total[NUMBER_OF_SOCKETS];
+  double ppw1 = thr / s.power_package[NUMBER_OF_SOCKETS];
+  double ppw2 = thr / s.power_pp0[NUMBER_OF_SOCKETS];
+  double eop0 = (1e6 * s.energy_total[NUMBER_OF_SOCKETS]) / acquires;
+  double eop1 = (1e6 * s.energy_package[NUMBER_OF_SOCKETS]) / acquires;
+  double eop2 = (1e6 * s.energy_pp0[NUMBER_OF_SOCKETS]) / acquires;
+  printf("#ppw (ops/W)  : %10.1f | %10.1f | %10.1f\n", ppw0, ppw1, ppw2);
+  printf("#eop (uJ/op)  : %10f | %10f | %10f\n", eop0, eop1, eop2);
+
+  free(locks);
+  free(threads);
+  free(data);
+
+  return 0;
+}
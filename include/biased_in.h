@@ -0,0 +1,300 @@
+/*
+ * File: biased_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Biased (thread-affine) locking on top of any LOCK_IN algorithm
+ *      (LOCK_IN_BIASED=1).
+ *
+ *      The first thread that acquires a lock becomes its bias owner. It then
+ *      acquires and releases the lock with plain loads and stores (owner_in).
+ *      The first other thread that tries to acquire the lock revokes the bias.
+ *      It sets revoke, issues an asymmetric fence (membarrier(
+ *      MEMBARRIER_CMD_PRIVATE_EXPEDITED)) to serialize with the owner's plain
+ *      store-load, and waits for the owner to leave its critical section.
+ *      From then on, all threads (the owner included) use the underlying
+ *      LOCK_IN algorithm. If membarrier is not available, the owner falls back
+ *      to a full fence instead of the lock-prefixed instruction. A trylock
+ *      only starts the revocation and returns EBUSY while the owner is in.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _BIASED_IN_H_
+#define _BIASED_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/syscall.h>
+#include <linux/membarrier.h>
+#include "wrap_in.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error biased_in.h is included by lock_in.h (with LOCK_IN_BIASED=1)
+#endif
+#if LOCK_IN == GLS
+#  error LOCK_IN_BIASED does not support GLS
+#endif
+
+#define BIASED_REVOKED      ((uintptr_t) 1) /* owner of a revoked lock */
+#define BIASED_YIELD_EVERY  1024 /* a revoker yields every 1024 polls of owner_in */
+
+  LOCK_IN_WRAP_BASE(biased)
+
+  typedef struct biased_lock
+  {
+    volatile uintptr_t owner;	/* 0, the bias owner, or BIASED_REVOKED */
+    volatile uint32_t owner_in;	/* the owner holds the lock through the bias */
+    volatile uint32_t revoke;	/* a revocation has started */
+    volatile uint32_t base_ready;	/* base is initialized */
+    biased_base_t base;
+  } biased_lock_t;
+
+#define BIASED_LOCK_INITIALIZER { .owner = 0, .owner_in = 0, .revoke = 0, .base_ready = 0 }
+
+  /* the address of a thread-local variable identifies the thread; these are
+     defined once, in biased_in.c (liblockin) */
+  extern __thread uint8_t biased_me;
+  /* 1: revokers use membarrier, 0: owners use a full fence */
+  extern volatile int biased_asym;
+  /* registers the process for membarrier (once) and sets biased_asym */
+  extern void biased_asym_init(void);
+
+  static inline uintptr_t
+  biased_self()
+  {
+    return (uintptr_t) &biased_me;
+  }
+
+  static inline int
+  biased_lock_init(biased_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->owner = 0;
+    l->owner_in = 0;
+    l->revoke = 0;
+    l->base_ready = 1;
+    return biased_base_init(&l->base);
+  }
+
+  static inline int
+  biased_lock_destroy(biased_lock_t* l)
+  {
+    if (l->base_ready)
+      {
+	return biased_base_destroy(&l->base);
+      }
+    return 0;
+  }
+
+  /* returns 1 if the calling thread is (or just became) the bias owner */
+  static inline int
+  biased_is_owner(biased_lock_t* l, const uintptr_t me)
+  {
+    const uintptr_t o = l->owner;
+    if (__builtin_expect(o == me, 1))
+      {
+	return 1;
+      }
+    if (o == 0)
+      {
+	biased_asym_init();
+	return __sync_val_compare_and_swap(&l->owner, 0, me) == 0;
+      }
+    return 0;
+  }
+
+  /* the owner enters through the bias, unless a revocation has started */
+  static inline int
+  biased_owner_enter(biased_lock_t* l)
+  {
+    l->owner_in = 1;
+    if (biased_asym)
+      {
+	asm volatile ("" ::: "memory");
+      }
+    else
+      {
+	__sync_synchronize();
+      }
+    if (__builtin_expect(!l->revoke, 1))
+      {
+	return 1;
+      }
+    l->owner_in = 0;
+    return 0;
+  }
+
+  /* starts the revocation (revoke: 1 fencing, 2 fenced, 3 finishing) and
+     completes it if the owner is not in its critical section; returns 1 once
+     the lock is revoked */
+  static inline int
+  biased_revoke_try(biased_lock_t* l)
+  {
+    if (__builtin_expect(l->owner == BIASED_REVOKED, 1))
+      {
+	return 1;
+      }
+
+    if (__sync_val_compare_and_swap(&l->revoke, 0, 1) == 0)
+      {
+	biased_asym_init();
+	if (biased_asym)
+	  {
+	    syscall(__NR_membarrier, MEMBARRIER_CMD_PRIVATE_EXPEDITED, 0, 0);
+	  }
+	else
+	  {
+	    __sync_synchronize();
+	  }
+	l->revoke = 2;
+      }
+
+    if (l->revoke == 2 && !l->owner_in
+	&& __sync_val_compare_and_swap(&l->revoke, 2, 3) == 2)
+      {
+	if (!l->base_ready)
+	  {
+	    biased_base_init(&l->base);
+	    l->base_ready = 1;
+	  }
+	asm volatile ("" ::: "memory");
+	l->owner = BIASED_REVOKED;
+      }
+    return l->owner == BIASED_REVOKED;
+  }
+
+  /* waits until the lock is revoked, and revokes it if nobody has */
+  static inline void
+  biased_revoke(biased_lock_t* l)
+  {
+    uint32_t polls = 0;
+    while (!biased_revoke_try(l))
+      {
+	PAUSE_IN();
+	if ((++polls & (BIASED_YIELD_EVERY - 1)) == 0)
+	  {
+	    sched_yield();
+	  }
+      }
+  }
+
+  static inline int
+  biased_lock_lock(biased_lock_t* l)
+  {
+    if (biased_is_owner(l, biased_self()) && biased_owner_enter(l))
+      {
+	return 0;
+      }
+    biased_revoke(l);
+    return biased_base_lock(&l->base);
+  }
+
+  static inline int
+  biased_lock_timedlock(biased_lock_t* l, const struct timespec* ts)
+  {
+    if (biased_is_owner(l, biased_self()) && biased_owner_enter(l))
+      {
+	return 0;
+      }
+    biased_revoke(l);
+    return biased_base_timedlock(&l->base, ts);
+  }
+
+  static inline int
+  biased_lock_trylock(biased_lock_t* l)
+  {
+    if (biased_is_owner(l, biased_self()) && biased_owner_enter(l))
+      {
+	return 0;
+      }
+    /* never waits for the bias owner: the revocation completes later */
+    if (!biased_revoke_try(l))
+      {
+	return EBUSY;
+      }
+    return biased_base_trylock(&l->base);
+  }
+
+  static inline int
+  biased_lock_unlock(biased_lock_t* l)
+  {
+    if (l->owner == biased_self() && l->owner_in)
+      {
+	asm volatile ("" ::: "memory");
+	l->owner_in = 0;
+	return 0;
+      }
+    return biased_base_unlock(&l->base);
+  }
+
+  /* the condition variables are the ones of the underlying algorithm: a
+     holder through the bias first moves to the underlying lock (nobody 
+     else can hold it while owner_in is set) */
+  static inline void
+  biased_cond_prepare(biased_lock_t* l)
+  {
+    if (l->owner == biased_self() && l->owner_in)
+      {
+	if (!l->base_ready)
+	  {
+	    biased_base_init(&l->base);
+	    l->base_ready = 1;
+	  }
+	biased_base_lock(&l->base);
+	l->owner_in = 0;
+      }
+  }
+
+  static inline int
+  biased_cond_wait(pthread_cond_t* c, biased_lock_t* l)
+  {
+    biased_cond_prepare(l);
+    return biased_base_cond_wait(c, &l->base);
+  }
+
+  static inline int
+  biased_cond_timedwait(pthread_cond_t* c, biased_lock_t* l, const struct timespec* ts)
+  {
+    biased_cond_prepare(l);
+    return biased_base_cond_timedwait(c, &l->base, ts);
+  }
+
+#undef  LOCK_IN_WRAP
+#undef  LOCK_IN_WRAP_INITIALIZER
+#define LOCK_IN_WRAP             biased
+#define LOCK_IN_WRAP_INITIALIZER BIASED_LOCK_INITIALIZER
+#define LOCK_IN_WRAP_REDIRECT
+#include "wrap_in.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _BIASED_IN_H_ */
@@ -48,6 +48,52 @@ typedef struct
   cdf_stats_plus_t plus;
 } cdf_t;
 
+/* log-linear (HDR-like) histogram: the values below 2^CDF_HIST_SUB_BITS
+   are counted exactly, and every higher power-of-2 range is split in
+   2^CDF_HIST_SUB_BITS linear buckets (relative error < 2^-CDF_HIST_SUB_BITS).
+   Fixed memory, O(1) recording, and histograms can be merged */
+#define CDF_HIST_SUB_BITS 7
+#define CDF_HIST_SUB      (1 << CDF_HIST_SUB_BITS)
+#define CDF_HIST_BUCKETS  ((64 - CDF_HIST_SUB_BITS + 1) * CDF_HIST_SUB)
+
+typedef struct cdf_hist
+{
+  size_t n;
+  size_t min;
+  size_t max;
+  double sum;
+  double sum_sq;
+  size_t counts[CDF_HIST_BUCKETS];
+} cdf_hist_t;
+
+static inline size_t
+cdf_hist_index(const size_t v)
+{
+  if (v < CDF_HIST_SUB)
+    {
+      return v;
+    }
+  const int shift = 63 - __builtin_clzll(v) - CDF_HIST_SUB_BITS;
+  return ((size_t) (shift + 1) << CDF_HIST_SUB_BITS) + ((v >> shift) - CDF_HIST_SUB);
+}
+
+static inline void
+cdf_hist_add(cdf_hist_t* h, const size_t v)
+{
+  h->counts[cdf_hist_index(v)]++;
+  h->n++;
+  if (v < h->min)
+    {
+      h->min = v;
+    }
+  if (v > h->max)
+    {
+      h->max = v;
+    }
+  h->sum += v;
+  h->sum_sq += (double) v * v;
+}
+
 typedef struct 
 {
   size_t x_min;
@@ -73,6 +119,12 @@ size_t cdf_clust_get_val(const cdf_clustering_t* c, const size_t val);
 void cdf_destroy(cdf_t* e);
 void cdf_clustering_destroy(cdf_clustering_t* c);
 
+cdf_hist_t* cdf_hist_new();
+void cdf_hist_merge(cdf_hist_t* dst, const cdf_hist_t* src);
+cdf_t* cdf_calc_hist(const cdf_hist_t* h);
+size_t cdf_hist_percentile(const cdf_hist_t* h, const double perc);
+void cdf_hist_destroy(cdf_hist_t* h);
+
 void cdf_boxplot_print(const cdf_boxplot_t* b, const char* title);
 void cdf_boxplot_get(cdf_boxplot_t* b, const cdf_t* e, const double perc);
 size_t cdf_boxplot_get_median(cdf_boxplot_t* b);
@@ -0,0 +1,236 @@
+/*
+ * File: dist.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Samplers of lock indices in [0, n) for the benchmarks, with O(1) draws:
+ *        uniform          multiply-shift (no power-of-two lock counts needed)
+ *        zipf:S           Zipf with exponent S (e.g., 0.99), index 0 the hottest,
+ *                         via a precomputed alias table (Vose)
+ *        hotspot:F:P      the first F fraction of the indices get a P fraction of
+ *                         the draws (e.g., hotspot:0.1:0.9), uniformly within each part
+ *
+ *      Usage:
+ *        dist_t* d = dist_new("zipf:0.99", num_locks);  (NULL if the spec is invalid)
+ *        size_t l = dist_next(d, seeds);
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _DIST_H_
+#define _DIST_H_
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utils.h"
+
+#define DIST_UNIFORM  0
+#define DIST_ALIAS    1
+#define DIST_HOTSPOT  2
+
+#define DIST_SPEC_HELP "uniform, zipf:S (e.g., zipf:0.99), or hotspot:F:P (e.g., hotspot:0.1:0.9)"
+
+typedef struct dist
+{
+  int type;
+  size_t n;
+  uint64_t* prob;		/* alias: keep i with probability prob[i] / 2^32 */
+  uint32_t* alias;		/* alias: else take alias[i] */
+  size_t hot_n;			/* hotspot: [0, hot_n) drawn w/ prob. hot_p / 2^32 */
+  uint64_t hot_p;
+  double top;			/* the probability of index 0 (for reporting) */
+} dist_t;
+
+/* the alias table of the probabilities p[0..n) (summing to 1) */
+static inline int
+dist_alias_build(dist_t* d, const double* p)
+{
+  const size_t n = d->n;
+  double* scaled = (double*) malloc(n * sizeof(double));
+  size_t* small = (size_t*) malloc(n * sizeof(size_t));
+  size_t* large = (size_t*) malloc(n * sizeof(size_t));
+  d->prob = (uint64_t*) malloc(n * sizeof(uint64_t));
+  d->alias = (uint32_t*) malloc(n * sizeof(uint32_t));
+  if (scaled == NULL || small == NULL || large == NULL || d->prob == NULL || d->alias == NULL)
+    {
+      free(scaled);
+      free(small);
+      free(large);
+      return 1;
+    }
+
+  size_t ns = 0, nl = 0, i;
+  for (i = 0; i < n; i++)
+    {
+      scaled[i] = p[i] * n;
+      if (scaled[i] < 1.0)
+	{
+	  small[ns++] = i;
+	}
+      else
+	{
+	  large[nl++] = i;
+	}
+    }
+
+  while (ns > 0 && nl > 0)
+    {
+      const size_t s = small[--ns];
+      const size_t l = large[nl - 1];
+      d->prob[s] = (uint64_t) (scaled[s] * 4294967296.0);
+      d->alias[s] = l;
+      scaled[l] -= 1.0 - scaled[s];
+      if (scaled[l] < 1.0)
+	{
+	  nl--;
+	  small[ns++] = l;
+	}
+    }
+  /* the rest are 1, up to rounding */
+  while (nl > 0)
+    {
+      const size_t l = large[--nl];
+      d->prob[l] = 1ULL << 32;
+      d->alias[l] = l;
+    }
+  while (ns > 0)
+    {
+      const size_t s = small[--ns];
+      d->prob[s] = 1ULL << 32;
+      d->alias[s] = s;
+    }
+
+  free(scaled);
+  free(small);
+  free(large);
+  return 0;
+}
+
+static inline void
+dist_destroy(dist_t* d)
+{
+  if (d != NULL)
+    {
+      free(d->prob);
+      free(d->alias);
+      free(d);
+    }
+}
+
+static inline dist_t*
+dist_new(const char* spec, const size_t n)
+{
+  if (n == 0 || n > UINT32_MAX)
+    {
+      return NULL;
+    }
+  dist_t* d = (dist_t*) calloc(1, sizeof(dist_t));
+  d->n = n;
+
+  if (spec == NULL || strcmp(spec, "uniform") == 0)
+    {
+      d->type = DIST_UNIFORM;
+      d->top = 1.0 / n;
+    }
+  else if (strncmp(spec, "zipf:", 5) == 0)
+    {
+      char* end;
+      const double s = strtod(spec + 5, &end);
+      double* p = (double*) malloc(n * sizeof(double));
+      double sum = 0;
+      size_t i;
+      if (end == spec + 5 || *end != '\0' || s < 0 || p == NULL)
+	{
+	  free(p);
+	  dist_destroy(d);
+	  return NULL;
+	}
+      for (i = 0; i < n; i++)
+	{
+	  p[i] = 1.0 / pow((double) (i + 1), s);
+	  sum += p[i];
+	}
+      for (i = 0; i < n; i++)
+	{
+	  p[i] /= sum;
+	}
+      d->type = DIST_ALIAS;
+      d->top = p[0];
+      const int ret = dist_alias_build(d, p);
+      free(p);
+      if (ret != 0)
+	{
+	  dist_destroy(d);
+	  return NULL;
+	}
+    }
+  else if (strncmp(spec, "hotspot:", 8) == 0)
+    {
+      double f = 0, hp = 0;
+      if (sscanf(spec + 8, "%lf:%lf", &f, &hp) != 2 || f <= 0 || f > 1 || hp < 0 || hp > 1)
+	{
+	  dist_destroy(d);
+	  return NULL;
+	}
+      d->type = DIST_HOTSPOT;
+      d->hot_n = (size_t) (f * n + 0.5);
+      d->hot_n = (d->hot_n == 0) ? 1 : d->hot_n;
+      if (d->hot_n == n)
+	{
+	  hp = 1;
+	}
+      d->hot_p = (uint64_t) (hp * 4294967296.0);
+      d->top = hp / d->hot_n;
+    }
+  else
+    {
+      dist_destroy(d);
+      return NULL;
+    }
+  return d;
+}
+
+static inline size_t
+dist_next(const dist_t* d, unsigned long* seeds)
+{
+  const uint64_t r = my_random(&(seeds[0]),&(seeds[1]),&(seeds[2]));
+  const uint64_t lo = r & 0xffffffff, hi = r >> 32;
+  if (d->type == DIST_ALIAS)
+    {
+      const size_t i = (lo * d->n) >> 32;
+      return (hi < d->prob[i]) ? i : d->alias[i];
+    }
+  else if (d->type == DIST_HOTSPOT)
+    {
+      if (hi < d->hot_p)
+	{
+	  return (lo * d->hot_n) >> 32;
+	}
+      return d->hot_n + ((lo * (d->n - d->hot_n)) >> 32);
+    }
+  return (lo * d->n) >> 32;
+}
+
+#endif	/* _DIST_H_ */
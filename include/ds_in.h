@@ -0,0 +1,717 @@
+/*
+ * File: ds_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Lock-based concurrent data structures over the LOCK_IN locks, for the
+ *      application-level benchmarks (stress_in --cs=ds, see stress_in_workload.h):
+ *        ds_ht_*     hash table with one lock per bucket
+ *        ds_list_*   sorted linked list with hand-over-hand (lock coupling) locking
+ *        ds_sl_*     lazy skip list (Herlihy et al.): optimistic wait-free searches,
+ *                    and per-node locks of the predecessors on updates
+ *        ds_queue_*  two-lock MPMC queue (Michael & Scott)
+ *
+ *      With LOCK_IN == GLS, the structures have no embedded locks: GLS locks the
+ *      addresses of the buckets/nodes themselves.
+ *      The keys are in [1, 2^64 - 2] (0 and 2^64 - 1 are the list sentinels).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _DS_IN_H_
+#define _DS_IN_H_
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "utils.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error include lock_in.h before ds_in.h
+#endif
+
+#if LOCK_IN == GLS
+#  define DS_LOCK_FIELD
+#  define DS_LOCK_INIT(o)
+#  define DS_LOCK_DESTROY(o)
+#  define DS_LOCK(o)          gls_lock((void*) (o))
+#  define DS_UNLOCK(o)        gls_unlock((void*) (o))
+#else
+#  define DS_LOCK_FIELD       pthread_mutex_t lock;
+#  define DS_LOCK_INIT(o)     pthread_mutex_init(&(o)->lock, NULL)
+#  define DS_LOCK_DESTROY(o)  pthread_mutex_destroy(&(o)->lock)
+#  define DS_LOCK(o)          pthread_mutex_lock(&(o)->lock)
+#  define DS_UNLOCK(o)        pthread_mutex_unlock(&(o)->lock)
+#endif
+
+#define DS_KEY_MIN  0
+#define DS_KEY_MAX  UINT64_MAX
+
+/* ******************************************************************************** */
+/* hash table ********************************************************************* */
+
+typedef struct ds_ht_node
+{
+  uint64_t key;
+  uint64_t val;
+  struct ds_ht_node* next;
+} ds_ht_node_t;
+
+typedef struct ds_ht_bucket
+{
+  DS_LOCK_FIELD
+  ds_ht_node_t* head;
+} ds_ht_bucket_t;
+
+typedef struct ds_ht
+{
+  size_t num_buckets;
+  ds_ht_bucket_t* buckets;
+} ds_ht_t;
+
+static inline ds_ht_t*
+ds_ht_new(size_t num_buckets)
+{
+  ds_ht_t* ht = (ds_ht_t*) malloc(sizeof(ds_ht_t));
+  ht->num_buckets = num_buckets;
+  ht->buckets = (ds_ht_bucket_t*) calloc(num_buckets, sizeof(ds_ht_bucket_t));
+  size_t b;
+  for (b = 0; b < num_buckets; b++)
+    {
+      DS_LOCK_INIT(ht->buckets + b);
+    }
+  return ht;
+}
+
+static inline ds_ht_bucket_t*
+ds_ht_bucket(ds_ht_t* ht, uint64_t key)
+{
+  const uint64_t h = (key * 0x9E3779B97F4A7C15ULL) >> 32;
+  return ht->buckets + ((h * ht->num_buckets) >> 32);
+}
+
+static inline int
+ds_ht_search(ds_ht_t* ht, uint64_t key, uint64_t* val)
+{
+  ds_ht_bucket_t* b = ds_ht_bucket(ht, key);
+  int found = 0;
+  DS_LOCK(b);
+  ds_ht_node_t* n;
+  for (n = b->head; n != NULL; n = n->next)
+    {
+      if (n->key == key)
+	{
+	  *val = n->val;
+	  found = 1;
+	  break;
+	}
+    }
+  DS_UNLOCK(b);
+  return found;
+}
+
+static inline int
+ds_ht_insert(ds_ht_t* ht, uint64_t key, uint64_t val)
+{
+  ds_ht_bucket_t* b = ds_ht_bucket(ht, key);
+  ds_ht_node_t* new = (ds_ht_node_t*) malloc(sizeof(ds_ht_node_t));
+  new->key = key;
+  new->val = val;
+  DS_LOCK(b);
+  ds_ht_node_t* n;
+  for (n = b->head; n != NULL; n = n->next)
+    {
+      if (n->key == key)
+	{
+	  DS_UNLOCK(b);
+	  free(new);
+	  return 0;
+	}
+    }
+  new->next = b->head;
+  b->head = new;
+  DS_UNLOCK(b);
+  return 1;
+}
+
+static inline int
+ds_ht_remove(ds_ht_t* ht, uint64_t key)
+{
+  ds_ht_bucket_t* b = ds_ht_bucket(ht, key);
+  DS_LOCK(b);
+  ds_ht_node_t** p;
+  for (p = &b->head; *p != NULL; p = &(*p)->next)
+    {
+      if ((*p)->key == key)
+	{
+	  ds_ht_node_t* n = *p;
+	  *p = n->next;
+	  DS_UNLOCK(b);
+	  free(n);
+	  return 1;
+	}
+    }
+  DS_UNLOCK(b);
+  return 0;
+}
+
+static inline size_t
+ds_ht_size(ds_ht_t* ht)
+{
+  size_t s = 0, b;
+  for (b = 0; b < ht->num_buckets; b++)
+    {
+      ds_ht_node_t* n;
+      for (n = ht->buckets[b].head; n != NULL; n = n->next)
+	{
+	  s++;
+	}
+    }
+  return s;
+}
+
+static inline void
+ds_ht_destroy(ds_ht_t* ht)
+{
+  size_t b;
+  for (b = 0; b < ht->num_buckets; b++)
+    {
+      ds_ht_node_t* n = ht->buckets[b].head;
+      while (n != NULL)
+	{
+	  ds_ht_node_t* next = n->next;
+	  free(n);
+	  n = next;
+	}
+      DS_LOCK_DESTROY(ht->buckets + b);
+    }
+  free(ht->buckets);
+  free(ht);
+}
+
+/* ******************************************************************************** */
+/* hand-over-hand list ************************************************************ */
+
+typedef struct ds_list_node
+{
+  DS_LOCK_FIELD
+  uint64_t key;
+  uint64_t val;
+  struct ds_list_node* next;
+} ds_list_node_t;
+
+typedef struct ds_list
+{
+  ds_list_node_t* head;		/* sentinels: DS_KEY_MIN -> ... -> DS_KEY_MAX */
+} ds_list_t;
+
+static inline ds_list_node_t*
+ds_list_node_new(uint64_t key, uint64_t val, ds_list_node_t* next)
+{
+  ds_list_node_t* n = (ds_list_node_t*) malloc(sizeof(ds_list_node_t));
+  n->key = key;
+  n->val = val;
+  n->next = next;
+  DS_LOCK_INIT(n);
+  return n;
+}
+
+static inline ds_list_t*
+ds_list_new()
+{
+  ds_list_t* l = (ds_list_t*) malloc(sizeof(ds_list_t));
+  l->head = ds_list_node_new(DS_KEY_MIN, 0, ds_list_node_new(DS_KEY_MAX, 0, NULL));
+  return l;
+}
+
+/* returns with pred and curr (the first node with key >= key) locked */
+static inline void
+ds_list_locate(ds_list_t* l, uint64_t key, ds_list_node_t** pred, ds_list_node_t** curr)
+{
+  ds_list_node_t* p = l->head;
+  DS_LOCK(p);
+  ds_list_node_t* c = p->next;
+  DS_LOCK(c);
+  while (c->key < key)
+    {
+      DS_UNLOCK(p);
+      p = c;
+      c = c->next;
+      DS_LOCK(c);
+    }
+  *pred = p;
+  *curr = c;
+}
+
+static inline int
+ds_list_search(ds_list_t* l, uint64_t key, uint64_t* val)
+{
+  ds_list_node_t* pred, * curr;
+  ds_list_locate(l, key, &pred, &curr);
+  const int found = (curr->key == key);
+  if (found)
+    {
+      *val = curr->val;
+    }
+  DS_UNLOCK(curr);
+  DS_UNLOCK(pred);
+  return found;
+}
+
+static inline int
+ds_list_insert(ds_list_t* l, uint64_t key, uint64_t val)
+{
+  ds_list_node_t* new = ds_list_node_new(key, val, NULL);
+  ds_list_node_t* pred, * curr;
+  ds_list_locate(l, key, &pred, &curr);
+  const int ok = (curr->key != key);
+  if (ok)
+    {
+      new->next = curr;
+      pred->next = new;
+    }
+  DS_UNLOCK(curr);
+  DS_UNLOCK(pred);
+  if (!ok)
+    {
+      DS_LOCK_DESTROY(new);
+      free(new);
+    }
+  return ok;
+}
+
+static inline int
+ds_list_remove(ds_list_t* l, uint64_t key)
+{
+  ds_list_node_t* pred, * curr;
+  ds_list_locate(l, key, &pred, &curr);
+  const int ok = (curr->key == key);
+  if (ok)
+    {
+      pred->next = curr->next;
+    }
+  DS_UNLOCK(curr);
+  DS_UNLOCK(pred);
+  if (ok)
+    {
+      /* unreachable: reaching curr requires the lock of pred */
+      DS_LOCK_DESTROY(curr);
+      free(curr);
+    }
+  return ok;
+}
+
+static inline size_t
+ds_list_size(ds_list_t* l)
+{
+  size_t s = 0;
+  ds_list_node_t* n;
+  for (n = l->head->next; n->key != DS_KEY_MAX; n = n->next)
+    {
+      s++;
+    }
+  return s;
+}
+
+static inline void
+ds_list_destroy(ds_list_t* l)
+{
+  ds_list_node_t* n = l->head;
+  while (n != NULL)
+    {
+      ds_list_node_t* next = n->next;
+      DS_LOCK_DESTROY(n);
+      free(n);
+      n = next;
+    }
+  free(l);
+}
+
+/* ******************************************************************************** */
+/* lazy skip list ***************************************************************** */
+
+#define DS_SL_LEVELS 24
+
+typedef struct ds_sl_node
+{
+  DS_LOCK_FIELD
+  uint64_t key;
+  uint64_t val;
+  int top;			/* the highest level of the node */
+  volatile int marked;		/* logically removed */
+  volatile int linked;		/* linked in all its levels */
+  struct ds_sl_node* retired;
+  struct ds_sl_node* volatile next[];
+} ds_sl_node_t;
+
+typedef struct ds_sl
+{
+  ds_sl_node_t* head;
+  ds_sl_node_t* volatile retired; /* removed nodes, freed by ds_sl_destroy
+				     (searches do not lock) */
+} ds_sl_t;
+
+static inline ds_sl_node_t*
+ds_sl_node_new(uint64_t key, uint64_t val, int top)
+{
+  ds_sl_node_t* n = (ds_sl_node_t*) malloc(sizeof(ds_sl_node_t) + (top + 1) * sizeof(ds_sl_node_t*));
+  n->key = key;
+  n->val = val;
+  n->top = top;
+  n->marked = 0;
+  n->linked = 0;
+  DS_LOCK_INIT(n);
+  return n;
+}
+
+static inline ds_sl_t*
+ds_sl_new()
+{
+  ds_sl_t* sl = (ds_sl_t*) malloc(sizeof(ds_sl_t));
+  sl->head = ds_sl_node_new(DS_KEY_MIN, 0, DS_SL_LEVELS - 1);
+  ds_sl_node_t* tail = ds_sl_node_new(DS_KEY_MAX, 0, DS_SL_LEVELS - 1);
+  int i;
+  for (i = 0; i < DS_SL_LEVELS; i++)
+    {
+      sl->head->next[i] = tail;
+      tail->next[i] = NULL;
+    }
+  sl->head->linked = tail->linked = 1;
+  sl->retired = NULL;
+  return sl;
+}
+
+/* geometric, p = 1/2 */
+static inline int
+ds_sl_level(unsigned long* seeds)
+{
+  const unsigned long r = my_random(&(seeds[0]),&(seeds[1]),&(seeds[2]));
+  return __builtin_ctzl(r | (1UL << (DS_SL_LEVELS - 1)));
+}
+
+/* the highest level where key was found, or -1 */
+static inline int
+ds_sl_find(ds_sl_t* sl, uint64_t key, ds_sl_node_t** preds, ds_sl_node_t** succs)
+{
+  int found = -1, i;
+  ds_sl_node_t* pred = sl->head;
+  for (i = DS_SL_LEVELS - 1; i >= 0; i--)
+    {
+      ds_sl_node_t* curr = pred->next[i];
+      while (curr->key < key)
+	{
+	  pred = curr;
+	  curr = pred->next[i];
+	}
+      if (found == -1 && curr->key == key)
+	{
+	  found = i;
+	}
+      preds[i] = pred;
+      succs[i] = curr;
+    }
+  return found;
+}
+
+static inline int
+ds_sl_search(ds_sl_t* sl, uint64_t key, uint64_t* val)
+{
+  ds_sl_node_t* preds[DS_SL_LEVELS], * succs[DS_SL_LEVELS];
+  const int l = ds_sl_find(sl, key, preds, succs);
+  if (l != -1 && succs[l]->linked && !succs[l]->marked)
+    {
+      *val = succs[l]->val;
+      return 1;
+    }
+  return 0;
+}
+
+/* unlocks the distinct preds[0..highest] */
+static inline void
+ds_sl_unlock_preds(ds_sl_node_t** preds, int highest)
+{
+  ds_sl_node_t* prev = NULL;
+  int i;
+  for (i = 0; i <= highest; i++)
+    {
+      if (preds[i] != prev)
+	{
+	  DS_UNLOCK(preds[i]);
+	  prev = preds[i];
+	}
+    }
+}
+
+/* locks the distinct preds[0..top] and validates them (succs can be marked
+   only by a remove of them); returns the highest locked level, and valid = 0
+   if the caller must unlock and retry */
+static inline int
+ds_sl_lock_preds(ds_sl_node_t** preds, ds_sl_node_t** succs, int top, int removing, int* valid)
+{
+  ds_sl_node_t* prev = NULL;
+  int highest = -1, i;
+  *valid = 1;
+  for (i = 0; *valid && i <= top; i++)
+    {
+      if (preds[i] != prev)
+	{
+	  DS_LOCK(preds[i]);
+	  highest = i;
+	  prev = preds[i];
+	}
+      *valid = !preds[i]->marked && (removing || !succs[i]->marked) && preds[i]->next[i] == succs[i];
+    }
+  return highest;
+}
+
+static inline int
+ds_sl_insert(ds_sl_t* sl, uint64_t key, uint64_t val, unsigned long* seeds)
+{
+  ds_sl_node_t* preds[DS_SL_LEVELS], * succs[DS_SL_LEVELS];
+  const int top = ds_sl_level(seeds);
+  while (1)
+    {
+      const int l = ds_sl_find(sl, key, preds, succs);
+      if (l != -1)
+	{
+	  ds_sl_node_t* found = succs[l];
+	  if (!found->marked)
+	    {
+	      while (!found->linked)
+		{
+		  PAUSE_IN();
+		}
+	      return 0;
+	    }
+	  continue;		/* being removed: retry */
+	}
+
+      int valid;
+      const int highest = ds_sl_lock_preds(preds, succs, top, 0, &valid);
+      if (!valid)
+	{
+	  ds_sl_unlock_preds(preds, highest);
+	  continue;
+	}
+
+      ds_sl_node_t* new = ds_sl_node_new(key, val, top);
+      int i;
+      for (i = 0; i <= top; i++)
+	{
+	  new->next[i] = succs[i];
+	}
+      __asm volatile ("" ::: "memory");	/* publish the node before linking it */
+      for (i = 0; i <= top; i++)
+	{
+	  preds[i]->next[i] = new;
+	}
+      new->linked = 1;
+      ds_sl_unlock_preds(preds, highest);
+      return 1;
+    }
+}
+
+static inline int
+ds_sl_remove(ds_sl_t* sl, uint64_t key)
+{
+  ds_sl_node_t* preds[DS_SL_LEVELS], * succs[DS_SL_LEVELS];
+  ds_sl_node_t* victim = NULL;
+  int is_marked = 0, top = -1;
+  while (1)
+    {
+      const int l = ds_sl_find(sl, key, preds, succs);
+      if (!is_marked)
+	{
+	  if (l == -1)
+	    {
+	      return 0;
+	    }
+	  victim = succs[l];
+	  if (!victim->linked || victim->top != l || victim->marked)
+	    {
+	      return 0;
+	    }
+	  top = victim->top;
+	  DS_LOCK(victim);
+	  if (victim->marked)
+	    {
+	      DS_UNLOCK(victim);
+	      return 0;
+	    }
+	  victim->marked = 1;
+	  is_marked = 1;
+	}
+
+      int valid, i;
+      const int highest = ds_sl_lock_preds(preds, succs, top, 1, &valid);
+      if (!valid)
+	{
+	  ds_sl_unlock_preds(preds, highest);
+	  continue;
+	}
+
+      for (i = top; i >= 0; i--)
+	{
+	  preds[i]->next[i] = victim->next[i];
+	}
+      DS_UNLOCK(victim);
+      ds_sl_unlock_preds(preds, highest);
+
+      ds_sl_node_t* r;
+      do
+	{
+	  r = sl->retired;
+	  victim->retired = r;
+	}
+      while (!__sync_bool_compare_and_swap(&sl->retired, r, victim));
+      return 1;
+    }
+}
+
+static inline size_t
+ds_sl_size(ds_sl_t* sl)
+{
+  size_t s = 0;
+  ds_sl_node_t* n;
+  for (n = sl->head->next[0]; n->key != DS_KEY_MAX; n = n->next[0])
+    {
+      s += !n->marked;
+    }
+  return s;
+}
+
+static inline void
+ds_sl_destroy(ds_sl_t* sl)
+{
+  ds_sl_node_t* n = sl->head;
+  while (n != NULL)
+    {
+      ds_sl_node_t* next = n->next[0];
+      DS_LOCK_DESTROY(n);
+      free(n);
+      n = next;
+    }
+  n = sl->retired;
+  while (n != NULL)
+    {
+      ds_sl_node_t* next = n->retired;
+      DS_LOCK_DESTROY(n);
+      free(n);
+      n = next;
+    }
+  free(sl);
+}
+
+/* ******************************************************************************** */
+/* two-lock queue ***************************************************************** */
+
+typedef struct ds_queue_node
+{
+  uint64_t val;
+  struct ds_queue_node* volatile next;
+} ds_queue_node_t;
+
+typedef struct ds_queue_end
+{
+  DS_LOCK_FIELD
+  ds_queue_node_t* node;
+} __attribute__((aligned(CACHE_LINE_SIZE))) ds_queue_end_t;
+
+typedef struct ds_queue
+{
+  ds_queue_end_t head;		/* the dummy node */
+  ds_queue_end_t tail;
+} ds_queue_t;
+
+static inline ds_queue_t*
+ds_queue_new()
+{
+  ds_queue_t* q;
+  if (posix_memalign((void**) &q, CACHE_LINE_SIZE, sizeof(ds_queue_t)) != 0)
+    {
+      return NULL;
+    }
+  ds_queue_node_t* dummy = (ds_queue_node_t*) malloc(sizeof(ds_queue_node_t));
+  dummy->next = NULL;
+  q->head.node = q->tail.node = dummy;
+  DS_LOCK_INIT(&q->head);
+  DS_LOCK_INIT(&q->tail);
+  return q;
+}
+
+static inline void
+ds_queue_enqueue(ds_queue_t* q, uint64_t val)
+{
+  ds_queue_node_t* n = (ds_queue_node_t*) malloc(sizeof(ds_queue_node_t));
+  n->val = val;
+  n->next = NULL;
+  DS_LOCK(&q->tail);
+  q->tail.node->next = n;
+  q->tail.node = n;
+  DS_UNLOCK(&q->tail);
+}
+
+static inline int
+ds_queue_dequeue(ds_queue_t* q, uint64_t* val)
+{
+  DS_LOCK(&q->head);
+  ds_queue_node_t* dummy = q->head.node;
+  ds_queue_node_t* first = dummy->next;
+  if (first == NULL)
+    {
+      DS_UNLOCK(&q->head);
+      return 0;
+    }
+  *val = first->val;
+  q->head.node = first;
+  DS_UNLOCK(&q->head);
+  free(dummy);
+  return 1;
+}
+
+static inline size_t
+ds_queue_size(ds_queue_t* q)
+{
+  size_t s = 0;
+  ds_queue_node_t* n;
+  for (n = q->head.node->next; n != NULL; n = n->next)
+    {
+      s++;
+    }
+  return s;
+}
+
+static inline void
+ds_queue_destroy(ds_queue_t* q)
+{
+  ds_queue_node_t* n = q->head.node;
+  while (n != NULL)
+    {
+      ds_queue_node_t* next = n->next;
+      free(n);
+      n = next;
+    }
+  DS_LOCK_DESTROY(&q->head);
+  DS_LOCK_DESTROY(&q->tail);
+  free(q);
+}
+
+#endif	/* _DS_IN_H_ */
@@ -0,0 +1,349 @@
+/*
+ * File: gcr_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Generic concurrency restriction (GCR) on top of any LOCK_IN algorithm
+ *      (LOCK_IN_GCR=1).
+ *
+ *      At most GCR_MAX_ACTIVE threads per lock are active, i.e., contend on (or
+ *      hold) the underlying lock. The other threads join a passive MCS-like queue
+ *      and do not touch the underlying lock: they spin on their own queue node
+ *      for GCR_SPIN_TRIES and then sleep on it (futex). Only the head of the
+ *      passive queue watches the number of active threads, and it becomes active
+ *      as soon as there is room. With more threads than cores, the spin locks
+ *      thus keep a small set of spinning threads instead of collapsing.
+ *
+ *      For long-term fairness, every GCR_PROMOTE_EVERY releases of a lock, the
+ *      releasing thread promotes the head of the passive queue to active, even
+ *      if the active set is full.
+ *
+ *      A thread that waits on a condition variable leaves the active set while
+ *      sleeping and rejoins it (unconditionally) when it gets the lock back.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _GCR_IN_H_
+#define _GCR_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include "wrap_in.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error gcr_in.h is included by lock_in.h (with LOCK_IN_GCR=1)
+#endif
+#if LOCK_IN == GLS
+#  error LOCK_IN_GCR does not support GLS
+#endif
+
+#if !defined(GCR_MAX_ACTIVE)
+#  define GCR_MAX_ACTIVE     4	/* max threads contending on a lock */
+#endif
+#if !defined(GCR_PROMOTE_EVERY)
+#  define GCR_PROMOTE_EVERY  0x1000 /* must be a power of 2 */
+#endif
+#if !defined(GCR_SPIN_TRIES)
+#  define GCR_SPIN_TRIES     1024 /* spins of a passive thread before sleeping */
+#endif
+
+  LOCK_IN_WRAP_BASE(gcr)
+
+  /* a thread is passive on at most one lock at a time, thus one node per
+     thread is enough */
+  typedef struct gcr_node
+  {
+    struct gcr_node* volatile next;
+    volatile uint32_t head;	/* the node is the head of the passive queue */
+    volatile uint32_t sleeping;
+  } gcr_node_t;
+
+  typedef struct gcr_lock
+  {
+    volatile uint32_t active;	/* threads contending on or holding base */
+    volatile uint32_t promote;	/* the head may become active regardless of active */
+    volatile uint32_t head_sleeping;	/* the head sleeps on active */
+    volatile uint32_t base_ready;	/* LOCK_IN_WRAP_BASE_READY once base is initialized */
+    uint32_t n_releases;	/* protected by base */
+    gcr_node_t* volatile tail;	/* of the passive queue */
+    gcr_base_t base;
+  } gcr_lock_t;
+
+  /* the underlying lock of a statically initialized lock is initialized by
+     its first user */
+#define GCR_LOCK_INITIALIZER { .active = 0, .promote = 0, .head_sleeping = 0, \
+			       .base_ready = 0, .n_releases = 0, .tail = NULL }
+
+  static __thread gcr_node_t gcr_my_node;
+
+  static inline void
+  gcr_futex_wait(volatile uint32_t* w, const uint32_t val)
+  {
+    syscall(SYS_futex, w, FUTEX_WAIT_PRIVATE, val, NULL, NULL, 0);
+  }
+
+  static inline void
+  gcr_futex_wake(volatile uint32_t* w)
+  {
+    syscall(SYS_futex, w, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+  }
+
+  static inline int
+  gcr_lock_init(gcr_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->active = 0;
+    l->promote = 0;
+    l->head_sleeping = 0;
+    l->n_releases = 0;
+    l->tail = NULL;
+    l->base_ready = LOCK_IN_WRAP_BASE_READY;
+    return gcr_base_init(&l->base);
+  }
+
+  static inline int
+  gcr_lock_destroy(gcr_lock_t* l)
+  {
+    if (l->base_ready == LOCK_IN_WRAP_BASE_READY)
+      {
+	return gcr_base_destroy(&l->base);
+      }
+    return 0;
+  }
+
+  LOCK_IN_WRAP_BASE_ENSURE(gcr)
+
+  /* returns 1 if the calling thread joined the active set */
+  static inline int
+  gcr_try_active(gcr_lock_t* l)
+  {
+    uint32_t a;
+    while ((a = l->active) < GCR_MAX_ACTIVE)
+      {
+	if (__sync_val_compare_and_swap(&l->active, a, a + 1) == a)
+	  {
+	    return 1;
+	  }
+      }
+    return 0;
+  }
+
+  /* the head of the passive queue waits for room in the active set, or for
+     a promotion */
+  static inline void
+  gcr_head_wait(gcr_lock_t* l)
+  {
+    uint32_t spins = 0;
+    while (1)
+      {
+	if (l->promote)
+	  {
+	    l->promote = 0;
+	    __sync_fetch_and_add(&l->active, 1);
+	    return;
+	  }
+	if (gcr_try_active(l))
+	  {
+	    return;
+	  }
+
+	if (++spins < GCR_SPIN_TRIES)
+	  {
+	    PAUSE_IN();
+	    continue;
+	  }
+
+	const uint32_t a = l->active;
+	l->head_sleeping = 1;
+	__sync_synchronize();
+	if (a >= GCR_MAX_ACTIVE && l->active == a && !l->promote)
+	  {
+	    gcr_futex_wait(&l->active, a);
+	  }
+	l->head_sleeping = 0;
+	spins = 0;
+      }
+  }
+
+  /* waits in the passive queue until the caller is active */
+  static inline void
+  gcr_passive(gcr_lock_t* l)
+  {
+    gcr_node_t* me = &gcr_my_node;
+    me->next = NULL;
+    me->head = 0;
+    me->sleeping = 0;
+
+    gcr_node_t* pred = __sync_lock_test_and_set(&l->tail, me);
+    if (pred != NULL)
+      {
+	pred->next = me;
+	uint32_t spins = 0;
+	while (!me->head)
+	  {
+	    if (++spins < GCR_SPIN_TRIES)
+	      {
+		PAUSE_IN();
+		continue;
+	      }
+	    me->sleeping = 1;
+	    __sync_synchronize();
+	    if (!me->head)
+	      {
+		gcr_futex_wait(&me->head, 0);
+	      }
+	    me->sleeping = 0;
+	    spins = 0;
+	  }
+      }
+
+    gcr_head_wait(l);
+
+    /* leave the queue: the successor becomes the head */
+    gcr_node_t* next = me->next;
+    if (next == NULL)
+      {
+	if (__sync_val_compare_and_swap(&l->tail, me, NULL) == me)
+	  {
+	    return;
+	  }
+	while ((next = me->next) == NULL)
+	  {
+	    PAUSE_IN();
+	  }
+      }
+    next->head = 1;
+    __sync_synchronize();
+    if (next->sleeping)
+      {
+	gcr_futex_wake(&next->head);
+      }
+  }
+
+  static inline void
+  gcr_enter(gcr_lock_t* l)
+  {
+    if (__builtin_expect(!gcr_try_active(l), 0))
+      {
+	gcr_passive(l);
+      }
+    gcr_base_ensure(l);
+  }
+
+  static inline void
+  gcr_leave(gcr_lock_t* l)
+  {
+    __sync_fetch_and_sub(&l->active, 1);
+    if (l->head_sleeping)
+      {
+	gcr_futex_wake(&l->active);
+      }
+  }
+
+  static inline int
+  gcr_lock_lock(gcr_lock_t* l)
+  {
+    gcr_enter(l);
+    return gcr_base_lock(&l->base);
+  }
+
+  static inline int
+  gcr_lock_timedlock(gcr_lock_t* l, const struct timespec* ts)
+  {
+    gcr_enter(l);
+    const int ret = gcr_base_timedlock(&l->base, ts);
+    if (ret != 0)
+      {
+	gcr_leave(l);
+      }
+    return ret;
+  }
+
+  /* a trylock does not wait to become active */
+  static inline int
+  gcr_lock_trylock(gcr_lock_t* l)
+  {
+    if (!gcr_try_active(l))
+      {
+	return EBUSY;
+      }
+    gcr_base_ensure(l);
+    const int ret = gcr_base_trylock(&l->base);
+    if (ret != 0)
+      {
+	gcr_leave(l);
+      }
+    return ret;
+  }
+
+  static inline int
+  gcr_lock_unlock(gcr_lock_t* l)
+  {
+    const int promote = ((++l->n_releases & (GCR_PROMOTE_EVERY - 1)) == 0) && (l->tail != NULL);
+    gcr_base_unlock(&l->base);
+    if (promote)
+      {
+	l->promote = 1;
+      }
+    gcr_leave(l);
+    return 0;
+  }
+
+  static inline int
+  gcr_cond_wait(pthread_cond_t* c, gcr_lock_t* l)
+  {
+    gcr_leave(l);
+    const int ret = gcr_base_cond_wait(c, &l->base);
+    __sync_fetch_and_add(&l->active, 1);
+    return ret;
+  }
+
+  static inline int
+  gcr_cond_timedwait(pthread_cond_t* c, gcr_lock_t* l, const struct timespec* ts)
+  {
+    gcr_leave(l);
+    const int ret = gcr_base_cond_timedwait(c, &l->base, ts);
+    __sync_fetch_and_add(&l->active, 1);
+    return ret;
+  }
+
+#undef  LOCK_IN_WRAP
+#undef  LOCK_IN_WRAP_INITIALIZER
+#define LOCK_IN_WRAP             gcr
+#define LOCK_IN_WRAP_INITIALIZER GCR_LOCK_INITIALIZER
+#define LOCK_IN_WRAP_REDIRECT
+#include "wrap_in.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _GCR_IN_H_ */
@@ -64,6 +64,7 @@
 #endif
 
 #include "atomic_ops.h"
+#include "lock_in_trace.h"
 
 #define GLK_DEBUG_PRINT              1
 #define GLK_DO_ADAP                  1
@@ -104,8 +105,13 @@
 #define GLK_MP_NUM_ZERO_MAX          8192 // * 100 ~= 0.8 s
 #define GLK_MP_SLEEP_SHIFT           3
 #define GLK_MP_CHECK_PERIOD_US       100
-#define GLK_MP_CHECK_THRESHOLD_HIGH  2 /* how many running threads > hw_ctx allow before switching */
-#define GLK_MP_CHECK_THRESHOLD_LOW   5 /* how many running threads < hw_ctx allow before switching */
+/* the thresholds can be set at compile time (e.g., make GLK_MP_HIGH=4 GLK_MP_LOW=2) */
+#if !defined(GLK_MP_CHECK_THRESHOLD_HIGH)
+#  define GLK_MP_CHECK_THRESHOLD_HIGH 2 /* how many running threads > hw_ctx allow before switching */
+#endif
+#if !defined(GLK_MP_CHECK_THRESHOLD_LOW)
+#  define GLK_MP_CHECK_THRESHOLD_LOW  5 /* how many running threads < hw_ctx allow before switching */
+#endif
 #define GLK_MP_MAX_ADAP_PER_SEC      8 
 #define GLK_MP_LOW_ADAP_PER_SEC      2
 #define GLK_MP_FIXED_SLEEP_MAX_LOG   5 /* sleep up to 2^GLK_MP_FIXED_SLEEP_MAX_LOG seconds */
@@ -276,6 +282,11 @@ extern int glk_unlock(glk_t *lock);
 
 extern int glk_is_free(glk_t *lock);
 
+/* non-blocking halves of glk_lock in MUTEX mode; 0 or EBUSY (see glk.c) */
+extern int glk_lock_spin(glk_t *lock);
+extern int glk_lock_retry(glk_t *lock);
+#define glk_lock_futex_word(lock) (&(lock)->mutex_lock.l.u)
+
 extern int glk_init(glk_t *lock, const pthread_mutexattr_t* a);
 extern int glk_destroy(glk_t *lock);
 
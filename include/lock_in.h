@@ -165,6 +165,10 @@ lock_in_cs_lat_getticks(void)
 #define TTASSHARED   20		
 #define GLK          21
 #define GLS          22		
+#define MUTEXEEO     23		/* MUTEXEE that spins only while the holder runs */
+#define MUTEXEEH     24		/* MUTEXEE with direct handoff to old sleepers */
+#define PARKING      25		/* 1-byte lock on a global parking lot */
+#define PRIO         26		/* waiter classes, served by priority */
 
 #if LOCK_IN == CLH
 #  if LOCK_IN_VERBOSE == 1
@@ -284,6 +288,32 @@ lock_in_cs_lat_getticks(void)
 #  define MUTEXEE_FAIR 1
 #  include "mutexee_in.h"
 #  include "ttas_rw_in.h"
+#elif LOCK_IN == MUTEXEEO
+#  if LOCK_IN_VERBOSE == 1
+#    warning using mutexeeo
+#  endif
+#  define MUTEXEE_OWNER 1
+#  include "mutexee_in.h"
+#  include "ttas_rw_in.h"
+#elif LOCK_IN == MUTEXEEH
+#  if LOCK_IN_VERBOSE == 1
+#    warning using mutexeeh
+#  endif
+#  define MUTEXEE_FAIR 2
+#  include "mutexee_in.h"
+#  include "ttas_rw_in.h"
+#elif LOCK_IN == PARKING
+#  if LOCK_IN_VERBOSE == 1
+#    warning using parking
+#  endif
+#  include "parking_in.h"
+#  include "ttas_rw_in.h"
+#elif LOCK_IN == PRIO
+#  if LOCK_IN_VERBOSE == 1
+#    warning using prio
+#  endif
+#  include "prio_in.h"
+#  include "ttas_rw_in.h"
 #elif LOCK_IN == GLK
 #  include "glk_in.h"
 #elif LOCK_IN == GLS
@@ -292,10 +322,81 @@ lock_in_cs_lat_getticks(void)
 #  error tell me which lock to use
 #endif
 
+#if !defined(LOCK_IN_BIASED)
+#  define LOCK_IN_BIASED 0	/* bias every lock to its first user (biased_in.h) */
+#endif
+#if LOCK_IN_BIASED == 1
+#  include "biased_in.h"
+#endif
+
+#if !defined(LOCK_IN_GCR)
+#  define LOCK_IN_GCR 0	/* cap the contending threads per lock (gcr_in.h) */
+#endif
+#if LOCK_IN_GCR == 1
+#  if LOCK_IN_BIASED == 1
+#    error LOCK_IN_GCR and LOCK_IN_BIASED cannot be combined
+#  endif
+#  include "gcr_in.h"
+#endif
+
+#if !defined(LOCK_IN_STATS)
+#  define LOCK_IN_STATS 0	/* sampled per-lock stats in shared memory (stats_in.h) */
+#endif
+#if LOCK_IN_STATS == 1
+#  include "stats_in.h"
+#endif
+
+#if !defined(LOCK_IN_PROFILE)
+#  define LOCK_IN_PROFILE 0	/* call-site wait/hold histograms (profile_in.h) */
+#endif
+#if LOCK_IN_PROFILE == 1
+#  include "profile_in.h"
+#endif
+
+#if !defined(LOCK_IN_TRACE)
+#  define LOCK_IN_TRACE 0	/* binary lock-event tracing (trace_in.h) */
+#endif
+#if LOCK_IN_TRACE == 1
+#  include "trace_in.h"
+#endif
+
 static inline const char*
 lock_in_lock_name()
 {
+#if LOCK_IN_BIASED == 1
+  return "BIASED-" LOCK_IN_NAME;
+#elif LOCK_IN_GCR == 1
+  return "GCR-" LOCK_IN_NAME;
+#else
   return LOCK_IN_NAME;
+#endif
+}
+
+/* sets the priority class of the calling thread (0 is the highest). Only
+   the PRIO lock serves waiters by class; the other locks ignore it. */
+static inline void
+lock_in_set_prio(int c)
+{
+#if defined(LOCK_IN_SET_PRIO)
+  LOCK_IN_SET_PRIO(c);
+#else
+  (void) c;
+#endif
+}
+
+/* number of futex wait and wake calls (incl. requeue) of the calling thread
+   so far. Returns 0 if the lock algorithm does not count them. */
+static inline int
+lock_in_futex_stats(size_t* n_wait, size_t* n_wake)
+{
+#if defined(LOCK_IN_FUTEX_STATS)
+  LOCK_IN_FUTEX_STATS(n_wait, n_wake);
+  return 1;
+#else
+  *n_wait = 0;
+  *n_wake = 0;
+  return 0;
+#endif
 }
 
 #ifdef __cplusplus
@@ -0,0 +1,290 @@
+/*
+ * File: lock_in_exec.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Delegation (flat combining) on top of any lock_in.h algorithm.
+ *
+ *      lock_in_execute(lock, fn, arg) runs fn(arg) under lock, but instead of
+ *      acquiring the lock, the calling thread publishes the closure in its
+ *      (per-thread) record. Whichever thread gets the lock (the combiner) runs
+ *      the published closures of all the threads that wait on the same lock in
+ *      a batch, so that the protected data stay in the cache of the combiner.
+ *
+ *      With lock_in_exec_serve(lock) and lock_in_exec_server_start(core), the
+ *      closures of the served locks are executed by a dedicated server thread
+ *      (RCL/ffwd style) and the clients never combine.
+ *
+ *      The closures must not block on, or execute, the same lock. Direct
+ *      pthread_mutex_lock users of the lock remain correct, as the combiner and
+ *      the server hold the lock while they execute the closures.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_EXEC_H_
+#define _LOCK_IN_EXEC_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+#define LOCK_IN_EXEC_MAX_THREADS  4096
+#define LOCK_IN_EXEC_MAX_SERVED   64
+#define LOCK_IN_EXEC_TRY_EVERY    64 /* a waiter tries to combine every 64 polls */
+#define LOCK_IN_EXEC_PASSES       4  /* max scans of the records by a combiner */
+#define LOCK_IN_EXEC_YIELD_EVERY  4096 /* waiters and an idle server yield the 
+					  cpu every 4096 polls (oversubscription) */
+
+#define LOCK_IN_EXEC_CACHE_LINE_SIZE 64
+
+  typedef void* (*lock_in_exec_fn_t)(void* arg);
+
+  typedef struct lock_in_exec_rec
+  {
+    volatile void* lock;
+    lock_in_exec_fn_t fn;
+    void* arg;
+    void* ret;
+    volatile uint32_t pending;
+    volatile uint32_t in_use;
+    uint8_t padding[LOCK_IN_EXEC_CACHE_LINE_SIZE - 4 * sizeof(void*) - 2 * sizeof(uint32_t)];
+  } __attribute__((aligned(LOCK_IN_EXEC_CACHE_LINE_SIZE))) lock_in_exec_rec_t;
+
+  extern lock_in_exec_rec_t lock_in_exec_recs[LOCK_IN_EXEC_MAX_THREADS];
+  extern volatile uint32_t lock_in_exec_n; /* high-water mark of used recs */
+  extern __thread lock_in_exec_rec_t* lock_in_exec_me;
+  extern void* volatile lock_in_exec_served[LOCK_IN_EXEC_MAX_SERVED];
+  extern volatile uint32_t lock_in_exec_n_served;
+  extern volatile int lock_in_exec_server_stop_now;
+
+  /* per-thread stats: closures executed as combiner / server, and batches */
+  extern __thread size_t lock_in_exec_n_ops;
+  extern __thread size_t lock_in_exec_n_batches;
+  /* the stats of the server thread (set once it stops) */
+  extern size_t lock_in_exec_server_n_ops;
+  extern size_t lock_in_exec_server_n_batches;
+
+  /* registers the calling thread (exits if the table is full) */
+  extern lock_in_exec_rec_t* lock_in_exec_register(void);
+
+#if !defined(LOCK_IN_EXEC_RECS_ONLY)	/* only the records (src/lock_in_exec.c) */
+#  if !defined(_LOCK_IN_H_)
+#    error include lock_in.h before lock_in_exec.h
+#  endif
+
+  static inline lock_in_exec_rec_t*
+  lock_in_exec_self()
+  {
+    lock_in_exec_rec_t* r = lock_in_exec_me;
+    if (__builtin_expect(r != NULL, 1))
+      {
+	return r;
+      }
+    return lock_in_exec_register();
+  }
+
+  static inline int
+  lock_in_exec_is_served(pthread_mutex_t* lock)
+  {
+    const uint32_t n = lock_in_exec_n_served;
+    uint32_t i;
+    for (i = 0; i < n; i++)
+      {
+	if (lock_in_exec_served[i] == (void*) lock)
+	  {
+	    return 1;
+	  }
+      }
+    return 0;
+  }
+
+  /* run the pending closures on lock (which the caller holds). Returns the
+     number of executed closures */
+  static inline size_t
+  lock_in_exec_combine(pthread_mutex_t* lock)
+  {
+    size_t done = 0;
+    int pass;
+    for (pass = 0; pass < LOCK_IN_EXEC_PASSES; pass++)
+      {
+	size_t done_pass = 0;
+	const uint32_t n = lock_in_exec_n;
+	uint32_t i;
+	for (i = 0; i < n; i++)
+	  {
+	    lock_in_exec_rec_t* r = lock_in_exec_recs + i;
+	    if (r->pending && r->lock == (void*) lock)
+	      {
+		r->ret = r->fn(r->arg);
+		asm volatile ("" ::: "memory");
+		r->pending = 0;
+		done_pass++;
+	      }
+	  }
+	if (done_pass == 0)
+	  {
+	    break;
+	  }
+	done += done_pass;
+      }
+
+    lock_in_exec_n_ops += done;
+    lock_in_exec_n_batches += (done > 0);
+    return done;
+  }
+
+  static inline void*
+  lock_in_execute(pthread_mutex_t* lock, lock_in_exec_fn_t fn, void* arg)
+  {
+    lock_in_exec_rec_t* me = lock_in_exec_self();
+    me->lock = lock;
+    me->fn = fn;
+    me->arg = arg;
+    asm volatile ("" ::: "memory");
+    me->pending = 1;
+
+    const int served = lock_in_exec_is_served(lock);
+    uint32_t polls = 0;
+    while (me->pending)
+      {
+	if (!served && (polls & (LOCK_IN_EXEC_TRY_EVERY - 1)) == 0 
+	    && pthread_mutex_trylock(lock) == 0)
+	  {
+	    /* our closure was published before, thus it is in the batch */
+	    lock_in_exec_combine(lock);
+	    pthread_mutex_unlock(lock);
+	    break;
+	  }
+	PAUSE_IN();
+	if ((++polls & (LOCK_IN_EXEC_YIELD_EVERY - 1)) == 0)
+	  {
+	    sched_yield();
+	  }
+      }
+
+    asm volatile ("" ::: "memory");
+    return me->ret;
+  }
+
+  /* ******************************************************************************** */
+  /* dedicated server */
+  /* ******************************************************************************** */
+
+  /* to be called before any thread executes on lock */
+  static inline void
+  lock_in_exec_serve(pthread_mutex_t* lock)
+  {
+    const uint32_t n = __sync_fetch_and_add(&lock_in_exec_n_served, 1);
+    if (n >= LOCK_IN_EXEC_MAX_SERVED)
+      {
+	fprintf(stderr, "[LOCK_IN_EXEC] too many served locks (max %d)\n", 
+		LOCK_IN_EXEC_MAX_SERVED);
+	exit(1);
+      }
+    lock_in_exec_served[n] = (void*) lock;
+  }
+
+  static void*
+  lock_in_exec_server(void* arg)
+  {
+    const long core = (long) arg;
+    if (core >= 0)
+      {
+	cpu_set_t mask;
+	CPU_ZERO(&mask);
+	CPU_SET(core, &mask);
+	if (sched_setaffinity(0, sizeof(cpu_set_t), &mask) != 0)
+	  {
+	    fprintf(stderr, "[LOCK_IN_EXEC] could not pin the server to core %ld\n", core);
+	  }
+      }
+
+    uint32_t idle = 0;
+    while (!lock_in_exec_server_stop_now)
+      {
+	const uint32_t ns = lock_in_exec_n_served;
+	uint32_t i, done = 0;
+	for (i = 0; i < ns; i++)
+	  {
+	    pthread_mutex_t* lock = (pthread_mutex_t*) lock_in_exec_served[i];
+	    if (lock == NULL)
+	      {
+		continue;
+	      }
+	    const uint32_t n = lock_in_exec_n;
+	    uint32_t j;
+	    for (j = 0; j < n; j++)
+	      {
+		lock_in_exec_rec_t* r = lock_in_exec_recs + j;
+		if (r->pending && r->lock == (void*) lock)
+		  {
+		    pthread_mutex_lock(lock);
+		    done += lock_in_exec_combine(lock);
+		    pthread_mutex_unlock(lock);
+		    break;
+		  }
+	      }
+	  }
+	if (done == 0)
+	  {
+	    PAUSE_IN();
+	    if ((++idle & (LOCK_IN_EXEC_YIELD_EVERY - 1)) == 0)
+	      {
+		sched_yield();
+	      }
+	  }
+      }
+
+    lock_in_exec_server_n_ops = lock_in_exec_n_ops;
+    lock_in_exec_server_n_batches = lock_in_exec_n_batches;
+    return NULL;
+  }
+
+  /* start the server thread, pinned on core (-1: not pinned) */
+  static inline int
+  lock_in_exec_server_start(pthread_t* thread, int core)
+  {
+    lock_in_exec_server_stop_now = 0;
+    return pthread_create(thread, NULL, lock_in_exec_server, (void*) (long) core);
+  }
+
+  static inline int
+  lock_in_exec_server_stop(pthread_t thread)
+  {
+    lock_in_exec_server_stop_now = 1;
+    return pthread_join(thread, NULL);
+  }
+
+#endif	/* !LOCK_IN_EXEC_RECS_ONLY */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_EXEC_H_ */
@@ -0,0 +1,143 @@
+/*
+ * File: lock_in_profile.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The data of the call-site-attributed lock profiler (LOCK_IN_PROFILE=1, see
+ *      profile_in.h) and its dump (src/lock_in_profile.c).
+ *
+ *      Every thread owns a table of (lock, call site) entries with log2-bucketed
+ *      histograms of the wait and the hold times (in cycles). Only the owner
+ *      writes to its table; the dump merges the tables of all threads (also of
+ *      the threads that have exited). The profile is dumped at exit and whenever
+ *      the process receives SIGUSR2, to stderr or to the file in the
+ *      LOCKIN_PROFILE environment variable (appended).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_PROFILE_H_
+#define _LOCK_IN_PROFILE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LOCK_IN_PROF_BUCKETS     40 /* bucket b: [2^(b-1), 2^b) cycles */
+#define LOCK_IN_PROF_TABLE       512 /* (lock, call site) entries per thread */
+#define LOCK_IN_PROF_MAX_HELD    8 /* sampled locks held at the same time */
+#if !defined(LOCK_IN_PROF_SAMPLE)
+#  define LOCK_IN_PROF_SAMPLE    64 /* one out of 64 acquisitions (power of 2) */
+#endif
+
+  typedef struct lock_in_prof_site
+  {
+    const char* file;
+    const char* func;
+    int line;
+  } lock_in_prof_site_t;
+
+  typedef struct lock_in_prof_entry
+  {
+    const void* lock;
+    const lock_in_prof_site_t* site;
+    uint64_t n_wait;
+    uint64_t n_hold;
+    uint64_t wait_sum;
+    uint64_t hold_sum;
+    uint64_t wait_hist[LOCK_IN_PROF_BUCKETS];
+    uint64_t hold_hist[LOCK_IN_PROF_BUCKETS];
+  } lock_in_prof_entry_t;
+
+  typedef struct lock_in_prof_thread
+  {
+    struct lock_in_prof_thread* next;
+    int id;
+    uint32_t n_dropped;		/* samples without an entry (table full) */
+    lock_in_prof_entry_t table[LOCK_IN_PROF_TABLE];
+  } lock_in_prof_thread_t;
+
+  typedef struct lock_in_prof_held
+  {
+    const void* lock;
+    lock_in_prof_entry_t* e;
+    uint64_t start;
+  } lock_in_prof_held_t;
+
+  extern __thread lock_in_prof_thread_t* lock_in_prof_me;
+  extern __thread uint32_t lock_in_prof_tick;
+  extern __thread uint32_t lock_in_prof_n_held;
+  extern __thread lock_in_prof_held_t lock_in_prof_held[LOCK_IN_PROF_MAX_HELD];
+
+  /* allocates the table of the calling thread (and, the first time, sets up
+     the dump at exit and on SIGUSR2) */
+  extern lock_in_prof_thread_t* lock_in_prof_register(void);
+  /* merges the tables of all threads and prints them */
+  extern void lock_in_prof_dump(FILE* f);
+
+  static inline uint32_t
+  lock_in_prof_bucket(const uint64_t cycles)
+  {
+    const uint32_t b = (cycles == 0) ? 0 : 64 - __builtin_clzll(cycles);
+    return (b < LOCK_IN_PROF_BUCKETS) ? b : LOCK_IN_PROF_BUCKETS - 1;
+  }
+
+  /* the entry of (lock, site) in the table of the calling thread, or NULL 
+     if the table is full */
+  static inline lock_in_prof_entry_t*
+  lock_in_prof_entry(const void* lock, const lock_in_prof_site_t* site)
+  {
+    lock_in_prof_thread_t* t = lock_in_prof_me;
+    if (__builtin_expect(t == NULL, 0))
+      {
+	t = lock_in_prof_register();
+      }
+    uint32_t h = (uint32_t) ((((uintptr_t) lock) >> 4) ^ (((uintptr_t) site) >> 3));
+    h ^= h >> 11;
+    uint32_t i;
+    for (i = 0; i < LOCK_IN_PROF_TABLE; i++)
+      {
+	lock_in_prof_entry_t* e = t->table + ((h + i) & (LOCK_IN_PROF_TABLE - 1));
+	if (e->lock == lock && e->site == site)
+	  {
+	    return e;
+	  }
+	if (e->lock == NULL)
+	  {
+	    e->site = site;
+	    asm volatile ("" ::: "memory");
+	    e->lock = lock;
+	    return e;
+	  }
+      }
+    t->n_dropped++;
+    return NULL;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_PROFILE_H_ */
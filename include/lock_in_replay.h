@@ -0,0 +1,84 @@
+/*
+ * File: lock_in_replay.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Compact on-disk format of the lock traces that stress_replay_in
+ *      re-executes against any LOCK_IN algorithm.
+ *
+ *      A replay file is exported from a binary lock-event trace of
+ *      LOCK_IN_TRACE=1 (lockin-trace -o FILE TRACE). For every thread it keeps
+ *      the sequence of its lock and unlock operations on dense lock ids, each
+ *      with the delay since the previous operation of the thread completed
+ *      (think time before a lock, hold time before an unlock) and, for locks,
+ *      the recorded wait. Nesting is preserved; condition waits are replayed as
+ *      unlock + lock.
+ *
+ *      File: lock_in_replay_hdr_t, then for every thread lock_in_replay_thread_t
+ *      followed by n_ops lock_in_replay_op_t.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_REPLAY_H_
+#define _LOCK_IN_REPLAY_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#define LOCK_IN_REPLAY_MAGIC      0x50524b4cu /* "LKRP" */
+#define LOCK_IN_REPLAY_VERSION    1
+#define LOCK_IN_REPLAY_UNLOCK     0x80000000u /* op.lock flag */
+
+  typedef struct lock_in_replay_hdr
+  {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t n_threads;
+    uint32_t n_locks;
+    uint64_t n_ops;		/* of all threads */
+    uint64_t span;		/* recorded duration in cycles */
+    double cycles_per_us;	/* of the recording machine */
+    char algo[48];		/* recorded with */
+  } lock_in_replay_hdr_t;
+
+  typedef struct lock_in_replay_thread
+  {
+    uint32_t thread;
+    uint32_t n_ops;
+  } lock_in_replay_thread_t;
+
+  typedef struct lock_in_replay_op
+  {
+    uint32_t lock;		/* lock id, | LOCK_IN_REPLAY_UNLOCK for unlocks */
+    uint32_t delay;		/* cycles since the previous op of the thread */
+    uint32_t wait;		/* recorded cycles to acquire (locks only) */
+  } lock_in_replay_op_t;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_REPLAY_H_ */
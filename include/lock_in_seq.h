@@ -0,0 +1,165 @@
+/*
+ * File: lock_in_seq.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Sequence locks (optimistic versioned locks) for read-mostly data, on top of
+ *      any lock_in.h algorithm.
+ *
+ *      A lock_in_seq_t is a version counter plus a writer lock (the LOCK_IN
+ *      algorithm). Writers take the lock and make the version odd while they
+ *      update the data. Readers never write shared memory: they read the version,
+ *      read the data optimistically, and validate that the version did not change
+ *      (else they retry). Readers can thus see torn data before validation; they
+ *      must not dereference pointers or loop on the values they read without
+ *      validating first (see lock_in_seq_read_validate).
+ *
+ *      lock_in_seq_upgrade turns an optimistic read into a write, if nothing
+ *      changed since the read (optimistic lock coupling).
+ *
+ *      Usage (after including lock_in.h):
+ *        uint64_t v;
+ *        do {
+ *          v = lock_in_seq_read_begin(&s);
+ *          ... copy the data ...
+ *        } while (lock_in_seq_read_retry(&s, v));
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_SEQ_H_
+#define _LOCK_IN_SEQ_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+
+#if !defined(_LOCK_IN_H_)
+#  error include lock_in.h before lock_in_seq.h
+#endif
+
+  typedef struct lock_in_seq
+  {
+    volatile uint64_t version;	/* odd while a writer updates the data */
+    pthread_mutex_t wlock;	/* serializes the writers */
+  } lock_in_seq_t;
+
+#define LOCK_IN_SEQ_INITIALIZER { .version = 0, .wlock = PTHREAD_MUTEX_INITIALIZER }
+
+#define lock_in_seq_barrier() asm volatile ("" ::: "memory")
+
+  static inline int
+  lock_in_seq_init(lock_in_seq_t* s)
+  {
+    s->version = 0;
+    return pthread_mutex_init(&s->wlock, NULL);
+  }
+
+  static inline int
+  lock_in_seq_destroy(lock_in_seq_t* s)
+  {
+    return pthread_mutex_destroy(&s->wlock);
+  }
+
+  /* ******************************************************************************** */
+  /* readers: x86 does not reorder loads with other loads, thus only the 
+     compiler has to be kept from moving the data reads around the version */
+  /* ******************************************************************************** */
+
+  /* waits for an even version */
+  static inline uint64_t
+  lock_in_seq_read_begin(lock_in_seq_t* s)
+  {
+    uint64_t v;
+    while ((v = s->version) & 1)
+      {
+	PAUSE_IN();
+      }
+    lock_in_seq_barrier();
+    return v;
+  }
+
+  /* returns 1 if the data read since lock_in_seq_read_begin returned v
+     are consistent */
+  static inline int
+  lock_in_seq_read_validate(lock_in_seq_t* s, const uint64_t v)
+  {
+    lock_in_seq_barrier();
+    return s->version == v;
+  }
+
+  static inline int
+  lock_in_seq_read_retry(lock_in_seq_t* s, const uint64_t v)
+  {
+    return !lock_in_seq_read_validate(s, v);
+  }
+
+  /* ******************************************************************************** */
+  /* writers: x86 does not reorder stores with other stores, thus the odd 
+     version is visible before any of the updates */
+  /* ******************************************************************************** */
+
+  static inline void
+  lock_in_seq_write_lock(lock_in_seq_t* s)
+  {
+    pthread_mutex_lock(&s->wlock);
+    s->version++;
+    lock_in_seq_barrier();
+  }
+
+  static inline void
+  lock_in_seq_write_unlock(lock_in_seq_t* s)
+  {
+    lock_in_seq_barrier();
+    s->version++;
+    pthread_mutex_unlock(&s->wlock);
+  }
+
+  /* turn the optimistic read at version v into a write. Returns 1 on 
+     success (the caller holds the write lock), or 0 if the data changed
+     since v (the caller must restart) */
+  static inline int
+  lock_in_seq_upgrade(lock_in_seq_t* s, const uint64_t v)
+  {
+    if (s->version != v)
+      {
+	return 0;
+      }
+    pthread_mutex_lock(&s->wlock);
+    if (s->version != v)
+      {
+	pthread_mutex_unlock(&s->wlock);
+	return 0;
+      }
+    s->version++;
+    lock_in_seq_barrier();
+    return 1;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_SEQ_H_ */
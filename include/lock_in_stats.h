@@ -0,0 +1,111 @@
+/*
+ * File: lock_in_stats.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Always-on, sampled per-lock statistics, published in a shared-memory
+ *      segment (shm_open("/lockin-stats.<pid>")) that lockin-stat reads live.
+ *
+ *      The segment is a header followed by LOCK_IN_STATS_SLOTS slots, one per
+ *      registered lock. The counters of a slot are updated by the lock holder
+ *      only (plain stores, no atomics), on one out of every
+ *      LOCK_IN_STATS_SAMPLE acquisitions of each thread. The counters are thus
+ *      samples: the estimated totals are n_* * sample.
+ *
+ *      The locks are registered by the LOCK_IN_STATS=1 wrapper (stats_in.h).
+ *      This header does not depend on lock_in.h (used by src/lockin_stat.c).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_STATS_H_
+#define _LOCK_IN_STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stdio.h>
+#include <unistd.h>
+
+#define LOCK_IN_STATS_MAGIC       0x4c4b494e53544154ULL /* "LKINSTAT" */
+#define LOCK_IN_STATS_VERSION     1
+#define LOCK_IN_STATS_SHM_PREFIX  "/lockin-stats."
+#define LOCK_IN_STATS_SLOTS       4096
+#if !defined(LOCK_IN_STATS_SAMPLE)
+#  define LOCK_IN_STATS_SAMPLE    64 /* must be a power of 2 */
+#endif
+#if !defined(LOCK_IN_STATS_CONTENDED)
+#  define LOCK_IN_STATS_CONTENDED 1024 /* a sampled acquire that waits for more
+					  than 1024 cycles is contended */
+#endif
+#define LOCK_IN_STATS_EWMA_SHIFT  3 /* ewma += (x - ewma) / 8 */
+
+#define LOCK_IN_STATS_CACHE_LINE_SIZE 64
+
+  typedef struct lock_in_stats_slot
+  {
+    volatile uint64_t lock;	/* address of the lock, 0 if the slot is free */
+    volatile uint64_t n_acq;	/* sampled acquisitions */
+    volatile uint64_t n_contended;	/* sampled acquisitions that waited */
+    volatile uint64_t n_futex_wait;	/* futex waits of the sampled acquisitions */
+    volatile uint64_t n_mode_switch;	/* mode changes seen by the samples (GLK) */
+    volatile uint64_t wait_ewma;	/* cycles */
+    volatile uint64_t hold_ewma;	/* cycles */
+    volatile uint32_t mode;	/* last mode seen (GLK) */
+    volatile uint32_t gen;	/* incremented whenever the slot is reused */
+  } __attribute__((aligned(LOCK_IN_STATS_CACHE_LINE_SIZE))) lock_in_stats_slot_t;
+
+  typedef struct lock_in_stats_seg
+  {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t n_slots;
+    uint32_t sample;
+    uint32_t contended;
+    volatile uint32_t n_used;	/* high-water mark of used slots */
+    volatile uint32_t n_dropped;	/* locks that did not get a slot */
+    int32_t pid;
+    char algo[44];
+    lock_in_stats_slot_t slots[LOCK_IN_STATS_SLOTS];
+  } lock_in_stats_seg_t;
+
+  /* the segment of this process (NULL until the first lock registers) */
+  extern lock_in_stats_seg_t* lock_in_stats_seg;
+
+  /* returns the slot of lock, or NULL if the segment is full or cannot be
+     created (the lock is then not sampled) */
+  extern lock_in_stats_slot_t* lock_in_stats_register(const void* lock, const char* algo);
+  extern void lock_in_stats_unregister(lock_in_stats_slot_t* slot);
+
+  static inline void
+  lock_in_stats_shm_name(char* name, const size_t len, const int pid)
+  {
+    snprintf(name, len, LOCK_IN_STATS_SHM_PREFIX "%d", pid);
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_STATS_H_ */
@@ -0,0 +1,174 @@
+/*
+ * File: lock_in_trace.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Binary lock-event tracer (LOCK_IN_TRACE=1, see trace_in.h).
+ *
+ *      Every thread appends compact events (acquire start, acquired, release,
+ *      futex wait/wake, GLK mode switch) with TSC timestamps to its own
+ *      single-producer ring. A background thread drains the rings to a file
+ *      (LOCKIN_TRACE, or lockin-trace.<pid>.bin) every LOCK_IN_TRACE_FLUSH_US;
+ *      if a ring is full, the events are dropped and counted, never blocked on.
+ *      The lockin-trace tool (src/lockin_trace.c) analyzes the file offline.
+ *
+ *      File: lock_in_trace_hdr_t, then chunks of one thread:
+ *      lock_in_trace_chunk_t followed by n lock_in_trace_ev_t.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_TRACE_H_
+#define _LOCK_IN_TRACE_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+#if !defined(LOCK_IN_TRACE)
+#  define LOCK_IN_TRACE 0	/* binary lock-event tracing (trace_in.h) */
+#endif
+
+#define LOCK_IN_TRACE_MAGIC      0x52544b4cu /* "LKTR" */
+#define LOCK_IN_TRACE_CHUNK      0x4b4e4843u /* "CHNK" */
+#define LOCK_IN_TRACE_VERSION    1
+#if !defined(LOCK_IN_TRACE_RING)
+#  define LOCK_IN_TRACE_RING     (1 << 17) /* events per thread (power of 2) */
+#endif
+#if !defined(LOCK_IN_TRACE_FLUSH_US)
+#  define LOCK_IN_TRACE_FLUSH_US 1000 /* period of the background flusher */
+#endif
+
+  typedef enum lock_in_trace_type
+    {
+      LOCK_IN_TRACE_ACQ_START = 1,	/* arg: 0 */
+      LOCK_IN_TRACE_ACQUIRED,		/* arg: 1 if by a trylock */
+      LOCK_IN_TRACE_RELEASE,		/* arg: 1 if by a condition wait */
+      LOCK_IN_TRACE_FUTEX_WAIT,
+      LOCK_IN_TRACE_FUTEX_WAKE,
+      LOCK_IN_TRACE_MODE,		/* arg: the new GLK mode (glk_type_t) */
+      LOCK_IN_TRACE_ACQ_TIMEOUT,	/* arg: 0; ends an acq-start that did not acquire */
+    } lock_in_trace_type_t;
+
+  /* the lock address (48 bits) | arg << 48 | type << 56 */
+#define LOCK_IN_TRACE_WORD(type, lock, arg)				\
+  ((((uint64_t) (uintptr_t) (lock)) & 0xffffffffffffULL) |		\
+   ((uint64_t) ((arg) & 0xff) << 48) | ((uint64_t) (type) << 56))
+#define LOCK_IN_TRACE_EV_LOCK(w) ((w) & 0xffffffffffffULL)
+#define LOCK_IN_TRACE_EV_ARG(w)  (((w) >> 48) & 0xff)
+#define LOCK_IN_TRACE_EV_TYPE(w) ((w) >> 56)
+
+  typedef struct lock_in_trace_ev
+  {
+    uint64_t tsc;
+    uint64_t word;
+  } lock_in_trace_ev_t;
+
+  typedef struct lock_in_trace_hdr
+  {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t ev_size;
+    uint32_t pid;
+    uint32_t ring;
+    double cycles_per_us;
+    char algo[48];
+  } lock_in_trace_hdr_t;
+
+  typedef struct lock_in_trace_chunk
+  {
+    uint32_t magic;
+    uint32_t thread;
+    uint32_t n;			/* events that follow */
+    uint32_t n_dropped;		/* events dropped since the previous chunk */
+  } lock_in_trace_chunk_t;
+
+  typedef struct lock_in_trace_thread
+  {
+    struct lock_in_trace_thread* next;
+    uint32_t id;
+    uint32_t n_dropped;		/* written by the thread only */
+    uint32_t n_dropped_flushed;	/* written by the flusher only */
+    volatile uint64_t head __attribute__((aligned(64))); /* written by the thread */
+    volatile uint64_t tail __attribute__((aligned(64))); /* written by the flusher */
+    lock_in_trace_ev_t ring[LOCK_IN_TRACE_RING] __attribute__((aligned(64)));
+  } lock_in_trace_thread_t;
+
+  extern __thread lock_in_trace_thread_t* lock_in_trace_me;
+  /* the lock the thread is acquiring or releasing: the futex events of the
+     algorithms are attributed to it, rather than to the futex word */
+  extern __thread const void* lock_in_trace_cur;
+
+  /* the first event of a thread registers its ring (algo: the name of the
+     lock algorithm, for the file header) */
+  extern lock_in_trace_thread_t* lock_in_trace_register(const char* algo);
+
+  static inline uint64_t
+  lock_in_trace_ticks()
+  {
+    uint32_t hi, lo;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+  }
+
+  static inline void
+  lock_in_trace_push(lock_in_trace_thread_t* t, const uint64_t word)
+  {
+    const uint64_t h = t->head;
+    if (__builtin_expect(h - t->tail >= LOCK_IN_TRACE_RING, 0))
+      {
+	t->n_dropped++;
+	return;
+      }
+    lock_in_trace_ev_t* e = t->ring + (h & (LOCK_IN_TRACE_RING - 1));
+    e->tsc = lock_in_trace_ticks();
+    e->word = word;
+    asm volatile ("" ::: "memory");
+    t->head = h + 1;
+  }
+
+  /* an event of the lock algorithm itself (futex calls, mode switches):
+     recorded only within an acquire or release of a traced lock */
+  static inline void
+  lock_in_trace_sync(const uint32_t type, const void* addr, const uint32_t arg)
+  {
+    lock_in_trace_thread_t* t = lock_in_trace_me;
+    if (t != NULL)
+      {
+	const void* l = (lock_in_trace_cur != NULL) ? lock_in_trace_cur : addr;
+	lock_in_trace_push(t, LOCK_IN_TRACE_WORD(type, l, arg));
+      }
+  }
+
+#if LOCK_IN_TRACE == 1
+#  define LOCK_IN_TRACE_SYNC(type, addr, arg) lock_in_trace_sync((type), (addr), (arg))
+#else
+#  define LOCK_IN_TRACE_SYNC(type, addr, arg)
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_TRACE_H_ */
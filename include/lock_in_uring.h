@@ -0,0 +1,244 @@
+/*
+ * File: lock_in_uring.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description:
+ *      Asynchronous lock acquire on top of io_uring (IORING_OP_FUTEX_WAIT,
+ *      Linux >= 6.7, liburing >= 2.5).
+ *
+ *      Instead of blocking in FUTEX_WAIT once the spin budget is exhausted,
+ *      lock_in_uring_lock submits the futex wait to a caller-supplied ring and
+ *      returns EINPROGRESS. The caller keeps reaping its other completions
+ *      (e.g., I/O) and hands the completions of lock waits (see
+ *      lock_in_uring_token) to lock_in_uring_complete, which either acquires
+ *      the lock, or re-arms the wait. The waits are plain private u32 futex
+ *      waits, so the unlock paths (and sync waiters) are unchanged.
+ *
+ *      Supported for MUTEXEE, MUTEXEEF, MUTEXEEO, MUTEXEEH, and GLK (in MUTEX
+ *      mode). With any other lock, lock_in_uring_lock simply blocks in
+ *      pthread_mutex_lock.
+ *      If the kernel does not support IORING_OP_FUTEX_WAIT, the first
+ *      completion fails with -EINVAL and the acquire falls back to a blocking
+ *      futex wait.
+ *
+ *      Usage (after including lock_in.h):
+ *        lock_in_uring_t t;
+ *        if (lock_in_uring_lock(&ring, lock, &t) == EINPROGRESS)
+ *          {
+ *            do {
+ *              io_uring_wait_cqe(&ring, &cqe);
+ *              if (lock_in_uring_token(cqe) == &t)
+ *                acquired = (lock_in_uring_complete(&ring, &t, cqe->res) == 0);
+ *              else
+ *                ... I/O completion ...
+ *              io_uring_cqe_seen(&ring, cqe);
+ *            } while (!acquired);
+ *          }
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _LOCK_IN_URING_H_
+#define _LOCK_IN_URING_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <errno.h>
+#include <stdint.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <liburing.h>
+
+#if !defined(_LOCK_IN_H_)
+#  error include lock_in.h before lock_in_uring.h
+#endif
+
+#if !defined(FUTEX2_SIZE_U32)
+#  define FUTEX2_SIZE_U32         0x02
+#endif
+#if !defined(FUTEX2_PRIVATE)
+#  define FUTEX2_PRIVATE          FUTEX_PRIVATE_FLAG
+#endif
+
+  /* the user_data of lock-wait sqes is the address of the token | TAG */
+#define LOCK_IN_URING_TAG         0x1ULL
+#define LOCK_IN_URING_FUTEX_VAL   257 /* value of a locked & contended lock */
+
+#if LOCK_IN_BIASED == 1 || LOCK_IN_GCR == 1 || LOCK_IN_STATS == 1 || \
+  LOCK_IN_PROFILE == 1 || LOCK_IN_TRACE == 1 /* wrapped locks block synchronously */
+#  define LOCK_IN_URING_MUTEXEE   0
+#  define LOCK_IN_URING_GLK       0
+#else
+#  define LOCK_IN_URING_MUTEXEE   (LOCK_IN == MUTEXEE || LOCK_IN == MUTEXEEF || \
+				   LOCK_IN == MUTEXEEO || LOCK_IN == MUTEXEEH)
+#  define LOCK_IN_URING_GLK       (LOCK_IN == GLK)
+#endif
+
+#if LOCK_IN_URING_MUTEXEE || LOCK_IN_URING_GLK
+#  define LOCK_IN_URING_ASYNC     1
+#else
+#  define LOCK_IN_URING_ASYNC     0
+#endif
+
+  typedef struct lock_in_uring
+  {
+    pthread_mutex_t* lock;
+    volatile unsigned* futex;	/* the word the wait is armed on */
+    size_t num_waits;		/* number of waits (futex sqes) of the last acquire */
+  } __attribute__((aligned(8))) lock_in_uring_t;
+
+  static inline int
+  lock_in_uring_try(pthread_mutex_t* lock)
+  {
+#if LOCK_IN_URING_MUTEXEE
+    return mutexee_lock_spin(lock);
+#elif LOCK_IN_URING_GLK
+    return glk_lock_spin(lock);
+#else
+    return pthread_mutex_lock(lock);
+#endif
+  }
+
+  static inline int
+  lock_in_uring_retry(pthread_mutex_t* lock)
+  {
+#if LOCK_IN_URING_MUTEXEE
+    return mutexee_lock_retry(lock);
+#elif LOCK_IN_URING_GLK
+    return glk_lock_retry(lock);
+#else
+    return pthread_mutex_lock(lock);
+#endif
+  }
+
+  static inline volatile unsigned*
+  lock_in_uring_futex_word(pthread_mutex_t* lock)
+  {
+#if LOCK_IN_URING_MUTEXEE
+    return &lock->l.u;
+#elif LOCK_IN_URING_GLK
+    return glk_lock_futex_word(lock);
+#else
+    return NULL;
+#endif
+  }
+
+  /* blocking fallback: no sqe available, or no kernel support */
+  static inline int
+  lock_in_uring_wait_sync(lock_in_uring_t* t)
+  {
+    while (lock_in_uring_retry(t->lock))
+      {
+	syscall(SYS_futex, t->futex, FUTEX_WAIT_PRIVATE, LOCK_IN_URING_FUTEX_VAL,
+		NULL, NULL, 0);
+      }
+    return 0;
+  }
+
+  /* returns 0 if the wait was armed, or if the lock was acquired
+     synchronously (t->futex is then set to NULL) */
+  static inline int
+  lock_in_uring_arm(struct io_uring* ring, lock_in_uring_t* t)
+  {
+    struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+    if (sqe == NULL)
+      {
+	io_uring_submit(ring);
+	sqe = io_uring_get_sqe(ring);
+      }
+    if (sqe == NULL)
+      {
+	lock_in_uring_wait_sync(t);
+	t->futex = NULL;
+	return 0;
+      }
+
+    io_uring_prep_futex_wait(sqe, (uint32_t*) t->futex, LOCK_IN_URING_FUTEX_VAL,
+			     FUTEX_BITSET_MATCH_ANY, FUTEX2_SIZE_U32 | FUTEX2_PRIVATE, 0);
+    io_uring_sqe_set_data64(sqe, ((uintptr_t) t) | LOCK_IN_URING_TAG);
+    t->num_waits++;
+    io_uring_submit(ring);
+    return 0;
+  }
+
+  /* returns 0 if the lock was acquired, or EINPROGRESS if a futex wait was
+     submitted to ring and the caller must wait for its completion */
+  static inline int
+  lock_in_uring_lock(struct io_uring* ring, pthread_mutex_t* lock, lock_in_uring_t* t)
+  {
+    t->lock = lock;
+    t->num_waits = 0;
+    if (lock_in_uring_try(lock) == 0)
+      {
+	return 0;
+      }
+
+#if LOCK_IN_URING_ASYNC == 1
+    t->futex = lock_in_uring_futex_word(lock);
+    lock_in_uring_arm(ring, t);
+    return (t->futex == NULL) ? 0 : EINPROGRESS;
+#else
+    return 0;
+#endif
+  }
+
+  /* the token of a lock-wait completion, or NULL for any other cqe */
+  static inline lock_in_uring_t*
+  lock_in_uring_token(struct io_uring_cqe* cqe)
+  {
+    uint64_t ud = io_uring_cqe_get_data64(cqe);
+    if (ud & LOCK_IN_URING_TAG)
+      {
+	return (lock_in_uring_t*) (uintptr_t) (ud & ~LOCK_IN_URING_TAG);
+      }
+    return NULL;
+  }
+
+  /* to be called with the result of a lock-wait completion:
+     0 (woken up) or -EAGAIN (the word was not 257 anymore) are the normal cases.
+     Returns 0 if the lock was acquired, else EINPROGRESS (the wait is re-armed) */
+  static inline int
+  lock_in_uring_complete(struct io_uring* ring, lock_in_uring_t* t, int res)
+  {
+    if (res < 0 && res != -EAGAIN && res != -EINTR)
+      {
+	/* e.g., -EINVAL: IORING_OP_FUTEX_WAIT not supported */
+	return lock_in_uring_wait_sync(t);
+      }
+
+    if (lock_in_uring_retry(t->lock) == 0)
+      {
+	return 0;
+      }
+
+    lock_in_uring_arm(ring, t);
+    return (t->futex == NULL) ? 0 : EINPROGRESS;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _LOCK_IN_URING_H_ */
@@ -62,6 +62,7 @@ extern "C" {
 #include <pthread.h>
 #include <malloc.h>
 #include <limits.h>
+#include "lock_in_trace.h"
 
 #if !defined(__x86_64__)
 #  error This file is designed to work only on x86_64 architectures! 
@@ -85,18 +86,58 @@ extern "C" {
 #define MUTEXEE_FUTEX_LIM           128
 #define MUTEXEE_FUTEX_LIM_MAX       256
 #define MUTEXEE_PRINT               0 /* print debug output  */
+#ifndef MUTEXEE_CS_ADAP
+#  define MUTEXEE_CS_ADAP           0 /* set the spin budgets from the (ewma) 
+					 cs length and queue depth of the lock */
+#endif
+#define MUTEXEE_CS_SAMPLE_EVERY     15 /* sample 1 every 16 acquires of a thread */
+#define MUTEXEE_CS_EWMA_SHIFT       3  /* weight of a new sample: 1/8 */
+#define MUTEXEE_CS_Q_SHIFT          4  /* fixed-point bits of the queue depth */
+#define MUTEXEE_CS_SPIN_FACTOR      2  /* spin for up to 2x the expected wait */
+#ifndef MUTEXEE_FUTEX_STATS
+#  define MUTEXEE_FUTEX_STATS       1 /* count the futex calls of each thread */
+#endif
 
 #ifndef MUTEXEE_FAIR
 #  define MUTEXEE_FAIR              0 /* enable or not mechanisms for capping
-				       the maximum tail latency of the lock */
+				       the maximum tail latency of the lock:
+				       1: sleep with timeouts, 
+				       2: hand the lock off to a sleeper that
+				          waits for more than the timeout */
 #endif
 
-#if MUTEXEE_FAIR > 0
+#ifndef MUTEXEE_OWNER
+#  define MUTEXEE_OWNER             0 /* spin only while the holder of the 
+				       lock is on cpu (see mutexee_owner.h) */
+#endif
+
+#if MUTEXEE_FAIR == 1
 #  define LOCK_IN_NAME "MUTEXEE-FAIR"
+#elif MUTEXEE_FAIR == 2
+#  define LOCK_IN_NAME "MUTEXEE-HANDOFF"
+#elif MUTEXEE_OWNER == 1
+#  define LOCK_IN_NAME "MUTEXEE-OWNER"
 #else
 #  define LOCK_IN_NAME "MUTEXEE"
 #endif
 
+#if MUTEXEE_OWNER == 1
+#  include "mutexee_owner.h"
+  /* the holder publishes its owner id in the lock, and the spinners park
+     as soon as the holder is off cpu */
+#  define MUTEXEE_OWNER_SET(m)   (m)->owner = mutexee_owner_acquired();
+#  define MUTEXEE_OWNER_CLEAR(m) (m)->owner = 0;
+#  define MUTEXEE_OWNER_SPIN_CHECK(m)		\
+  if (!mutexee_owner_on_cpu((m)->owner))	\
+    {						\
+      break;					\
+    }
+#else
+#  define MUTEXEE_OWNER_SET(m)
+#  define MUTEXEE_OWNER_CLEAR(m)
+#  define MUTEXEE_OWNER_SPIN_CHECK(m)
+#endif
+
 #  define MUTEXEE_FTIMEOUTS 0	/* timeout seconds */
 #ifndef MUTEXEE_FTIMEOUT
 #  define MUTEXEE_FTIMEOUT   3000000 /* timeout nanoseconds - max 1e9-1
@@ -104,13 +145,27 @@ extern "C" {
 					use MUTEXEE_FTIMEOUTS */ 
 #endif
 
-  const struct timespec mutexee_max_sleep = { .tv_sec = MUTEXEE_FTIMEOUTS,
-					      .tv_nsec = MUTEXEE_FTIMEOUT };
+  static const struct timespec mutexee_max_sleep = { .tv_sec = MUTEXEE_FTIMEOUTS,
+						     .tv_nsec = MUTEXEE_FTIMEOUT };
+
+#if MUTEXEE_FAIR == 2
+#  define MUTEXEE_HO_SHIFT   10	/* sleep timestamps are in 1024-cycle units */
+#  define MUTEXEE_HO_DEADLINE						\
+  ((uint32_t) ((MUTEXEE_FTIMEOUTS * 1e9 + MUTEXEE_FTIMEOUT) * FREQ_CPU_GHZ) \
+   >> MUTEXEE_HO_SHIFT)
+#  define MUTEXEE_HO_GRANT   0x10000 /* lock word: handed off to a sleeper */
+#endif
 
 #if MUTEXEE_DO_ADAP == 1
 #  define MUTEXEE_ADAP(d)	    d
 #else
 #  define MUTEXEE_ADAP(d) 
+#endif
+
+#if MUTEXEE_CS_ADAP == 1
+#  define MUTEXEE_CS(d)		    d
+#else
+#  define MUTEXEE_CS(d)
 #endif
   /* ******************************************************************************** */
 
@@ -158,6 +213,7 @@ extern "C" {
 #define xchg_32(a, b)    mutexee_swap_uint32((uint32_t*) a, b)
 #define xchg_8(a, b)     mutexee_swap_uint8((uint8_t*) a, b)
 #define atomic_add(a, b) __sync_fetch_and_add(a, b)
+#define atomic_sub(a, b) __sync_fetch_and_sub(a, b)
 
 #define CACHE_LINE_SIZE 64
 
@@ -172,7 +228,7 @@ extern "C" {
 	volatile unsigned char contended;
       } b;
     } l;
-    uint8_t padding[4];
+    volatile uint32_t n_waiters;	/* threads that (might) sleep on the lock */
     /* uint8_t padding_cl[56]; */
 
     unsigned int n_spins;
@@ -183,8 +239,17 @@ extern "C" {
     unsigned int is_futex;
     unsigned int n_acq_first_sleep;
     unsigned int retry_spin_every;
-    unsigned int padding3;
-    uint8_t padding2[CACHE_LINE_SIZE - 6 * sizeof(size_t)];
+    volatile uint32_t n_spinners;
+    uint32_t cs_start;		/* (low 32 bits of the) ticks of the sampled acquire */
+    uint32_t cs_avg;		/* ewma of the sampled cs durations (cycles) */
+    uint32_t q_avg;		/* ewma of the spinners + sleepers at acquire 
+				   (fixed point, MUTEXEE_CS_Q_SHIFT bits) */
+    union
+    {
+      volatile uint32_t owner;	/* owner id of the holder (MUTEXEE_OWNER) */
+      volatile uint32_t sleep_start; /* when the oldest sleeper started to 
+					sleep, or 0 (MUTEXEE_FAIR == 2) */
+    };
   } mutexee_lock_t;
 
 #define STATIC_ASSERT(a, msg)           _Static_assert ((a), msg);
@@ -196,6 +261,7 @@ extern "C" {
 #define MUTEXEE_INITIALIZER				\
   {							\
     .l.u = 0,						\
+      .n_waiters = 0,					\
       .n_spins = MUTEXEE_SPIN_TRIES_LOCK,		\
       .n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK,	\
       .n_acq = 0,	              			\
@@ -204,13 +270,17 @@ extern "C" {
       .is_futex = 0,					\
       .n_acq_first_sleep = 0,				\
       .retry_spin_every = MUTEXEE_RETRY_SPIN_EVERY,	\
+      .n_spinners = 0,					\
+      .cs_avg = 0,					\
+      .q_avg = 0,					\
+      .owner = 0,					\
       }
 
   typedef struct upmutex_cond1
   {
     mutexee_lock_t* m;
     int seq;
-    int pad;
+    volatile int n_waiters;	/* threads that (might) sleep on seq */
 #if PADDING == 1
     uint8_t padding[CACHE_LINE_SIZE - 16];
 #endif
@@ -218,9 +288,35 @@ extern "C" {
 
 #define UPMUTEX_COND1_INITIALIZER {NULL, 0, 0}
 
+#if MUTEXEE_FUTEX_STATS == 1
+  typedef struct mutexee_futex_stats
+  {
+    size_t n_wait;
+    size_t n_wake;
+  } mutexee_futex_stats_t;
+
+  static __thread mutexee_futex_stats_t mutexee_futex_stats = { 0, 0 };
+
+#  define LOCK_IN_FUTEX_STATS(w, k)		\
+  *(w) = mutexee_futex_stats.n_wait;		\
+  *(k) = mutexee_futex_stats.n_wake;
+#endif
+
   static inline int
   sys_futex(void* addr1, int op, int val1, struct timespec* timeout, void* addr2, int val3)
   {
+#if MUTEXEE_FUTEX_STATS == 1
+    if (op == FUTEX_WAIT_PRIVATE)
+      {
+	mutexee_futex_stats.n_wait++;
+      }
+    else
+      {
+	mutexee_futex_stats.n_wake++;
+      }
+#endif
+    LOCK_IN_TRACE_SYNC((op == FUTEX_WAIT_PRIVATE) ? LOCK_IN_TRACE_FUTEX_WAIT : LOCK_IN_TRACE_FUTEX_WAKE,
+		       addr1, 0);
     return syscall(SYS_futex, addr1, op, val1, timeout, addr2, val3);
   }
 
@@ -229,6 +325,7 @@ extern "C" {
   {
     (void) a;
     m->l.u = 0;
+    m->n_waiters = 0;
     m->n_spins = MUTEXEE_SPIN_TRIES_LOCK;
     m->n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK;
     m->n_acq = 0;
@@ -237,6 +334,11 @@ extern "C" {
     m->is_futex = 0;
     m->n_acq_first_sleep = 0;
     m->retry_spin_every = MUTEXEE_RETRY_SPIN_EVERY;
+    m->n_spinners = 0;
+    m->cs_start = 0;
+    m->cs_avg = 0;
+    m->q_avg = 0;
+    m->owner = 0;
     return 0;
   }
 
@@ -271,11 +373,158 @@ extern "C" {
     }						\
   }
 
+#if MUTEXEE_CS_ADAP == 1
+  /* Critical-section-aware spin budgets: every thread samples 1 out of 
+     MUTEXEE_CS_SAMPLE_EVERY+1 of its acquires: it records the number of 
+     threads that spin or sleep on the lock at acquire and the duration of the
+     critical section. The lock keeps an ewma of both, and sets the spin
+     budget to (about) the expected wait, cs_avg * (q_avg + 1), if this wait
+     fits in MUTEXEE_SPIN_TRIES_LOCK, else to the minimum (i.e., park). The
+     samples are taken and written while holding the lock. */
+  static __thread uint32_t mutexee_cs_n = 0;
+  static __thread mutexee_lock_t* mutexee_cs_lock = NULL;
+
+  static inline void
+  mutexee_cs_budget(mutexee_lock_t* m)
+  {
+    const uint64_t wait = ((uint64_t) m->cs_avg * (m->q_avg + (1 << MUTEXEE_CS_Q_SHIFT)))
+      >> MUTEXEE_CS_Q_SHIFT;
+    if (wait <= MUTEXEE_SPIN_TRIES_LOCK)
+      {
+	uint64_t spins = MUTEXEE_CS_SPIN_FACTOR * wait;
+	if (spins > MUTEXEE_SPIN_TRIES_LOCK)
+	  {
+	    spins = MUTEXEE_SPIN_TRIES_LOCK;
+	  }
+	else if (spins < MUTEXEE_SPIN_TRIES_LOCK_MIN)
+	  {
+	    spins = MUTEXEE_SPIN_TRIES_LOCK_MIN;
+	  }
+	m->n_spins = spins;
+	m->n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK;
+      }
+    else
+      {
+	m->n_spins = MUTEXEE_SPIN_TRIES_LOCK_MIN;
+	m->n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK_MIN;
+      }
+  }
+
+  static inline void
+  mutexee_cs_start(mutexee_lock_t* m)
+  {
+    if (__mutexee_unlikely((++mutexee_cs_n & MUTEXEE_CS_SAMPLE_EVERY) == 0))
+      {
+	const int64_t q = (int64_t) (m->n_spinners + m->n_waiters) << MUTEXEE_CS_Q_SHIFT;
+	m->q_avg += (q - (int64_t) m->q_avg) >> MUTEXEE_CS_EWMA_SHIFT;
+	mutexee_cs_lock = m;
+	m->cs_start = (uint32_t) mutexee_getticks();
+      }
+  }
+
+  static inline void
+  mutexee_cs_stop(mutexee_lock_t* m)
+  {
+    if (__mutexee_unlikely(mutexee_cs_lock == m))
+      {
+	mutexee_cs_lock = NULL;
+	const int64_t cs = (uint32_t) mutexee_getticks() - m->cs_start;
+	m->cs_avg += (cs - (int64_t) m->cs_avg) >> MUTEXEE_CS_EWMA_SHIFT;
+	mutexee_cs_budget(m);
+      }
+  }
+#endif	/* MUTEXEE_CS_ADAP */
+
+#if MUTEXEE_FAIR == 2
+  /* Direct handoff: a thread that goes to sleep publishes the time it 
+     started waiting in sleep_start (if no older sleeper has already). Once
+     the oldest sleeper has waited for more than MUTEXEE_HO_DEADLINE, its
+     timestamp acts as a handoff request: the next unlock does not release
+     the lock, but marks it as MUTEXEE_HO_GRANT and wakes up a sleeper, which
+     becomes the owner. Spinners and new sleepers cannot barge in, as the lock
+     stays locked and only a woken-up sleeper takes the grant, and sleepers
+     never need timer wake-ups. */
+  static inline uint32_t
+  mutexee_ho_now()
+  {
+    return ((uint32_t) (mutexee_getticks() >> MUTEXEE_HO_SHIFT)) | 1;
+  }
+
+  /* publishes start as the request of the sleepers, unless an older one is
+     pending. A sleeper republishes its own start every time it wakes up, thus
+     the request carries the start of the oldest sleeper that has been seen */
+  static inline void
+  mutexee_ho_request(mutexee_lock_t* m, const uint32_t start)
+  {
+    uint32_t cur;
+    while ((cur = m->sleep_start) == 0 || (int32_t) (start - cur) < 0)
+      {
+	if (mutexee_cas(&m->sleep_start, cur, start) == cur)
+	  {
+	    return;
+	  }
+      }
+  }
+
+  /* the request of start (if still pending) is served. The sleepers
+     increment n_waiters before they publish their request, thus if others
+     remain, they either see the cleared sleep_start, or we see them. Then
+     the request is re-armed with the current time, until one of them wakes 
+     up and republishes its (older) start */
+  static inline void
+  mutexee_ho_served(mutexee_lock_t* m, const uint32_t start, const uint32_t others)
+  {
+    if (start != 0 && mutexee_cas(&m->sleep_start, start, 0) == start)
+      {
+	if (m->n_waiters > others)
+	  {
+	    mutexee_ho_request(m, mutexee_ho_now());
+	  }
+      }
+  }
+#endif	/* MUTEXEE_FAIR == 2 */
+
+  /* acquire the lock as a sleeper (i.e., marking it as contended). 
+     Returns 0 on success, or non-0 if the caller must wait on the futex.
+     woken is 0 on the first try of a thread, before it has ever waited on
+     the futex: such a thread does not take a handoff (MUTEXEE_FAIR == 2), 
+     but waits for the woken-up sleeper to take it */
+  static inline int
+  mutexee_sleep_try(mutexee_lock_t* m, const int woken)
+  {
+#if MUTEXEE_FAIR == 2
+    while (1)
+      {
+	const uint32_t v = m->l.u;
+	if ((v & MUTEXEE_HO_GRANT) && !woken)
+	  {
+	    sched_yield();
+	  }
+	else if ((v & MUTEXEE_HO_GRANT) || !(v & 1))
+	  {
+	    if (mutexee_cas(&m->l.u, v, 257) == v)
+	      {
+		return 0;
+	      }
+	  }
+	else if (v == 257 || mutexee_cas(&m->l.u, v, 257) == v)
+	  {
+	    return 1;
+	  }
+      }
+#else
+    (void) woken;
+    return xchg_32(&m->l.u, 257) & 1;
+#endif
+  }
+
   static inline int
   mutexee_lock(mutexee_lock_t* m)
   {
     if (!xchg_8(&m->l.b.locked, 1))
       {
+	MUTEXEE_OWNER_SET(m);
+	MUTEXEE_CS(mutexee_cs_start(m););
 	return 0;
       }
 
@@ -284,17 +533,24 @@ extern "C" {
 #else
     const unsigned int time_spin = MUTEXEE_SPIN_TRIES_LOCK;
 #endif
+    MUTEXEE_CS(atomic_add(&m->n_spinners, 1););
     MUTEXEE_FOR_N_CYCLES(time_spin,
 			 if (!xchg_8(&m->l.b.locked, 1)) 
 			   {
+			     MUTEXEE_OWNER_SET(m);
+			     MUTEXEE_CS(atomic_sub(&m->n_spinners, 1);
+					mutexee_cs_start(m););
 			     return 0;
 			   }
 			 PAUSE_IN();
+			 MUTEXEE_OWNER_SPIN_CHECK(m);
 			 );
     
 
     /* Have to sleep */
-#if MUTEXEE_FAIR > 0
+    atomic_add(&m->n_waiters, 1);
+    MUTEXEE_CS(atomic_sub(&m->n_spinners, 1););
+#if MUTEXEE_FAIR == 1
     int once = 1;
     while (xchg_32(&m->l.u, 257) & 1)
       {
@@ -309,16 +565,98 @@ extern "C" {
 	      }
 	  }
       }
+#elif MUTEXEE_FAIR == 2
+    const uint32_t start = mutexee_ho_now();
+    mutexee_ho_request(m, start);
+    int woken = 0;
+    while (mutexee_sleep_try(m, woken))
+      {
+	sys_futex(m, FUTEX_WAIT_PRIVATE, 257, NULL, NULL, 0);
+	woken = 1;
+	mutexee_ho_request(m, start);
+      }    
+    mutexee_ho_served(m, start, 1);
 #else  /* not fair */
-    while (xchg_32(&m->l.u, 257) & 1)
+    int woken = 0;
+    while (mutexee_sleep_try(m, woken))
       {
 	sys_futex(m, FUTEX_WAIT_PRIVATE, 257, NULL, NULL, 0);
+	woken = 1;
       }    
 #endif /* MUTEXEE_FAIR */
+    atomic_sub(&m->n_waiters, 1);
+    MUTEXEE_OWNER_SET(m);
+    MUTEXEE_CS(mutexee_cs_start(m););
 
     return 0;
   }
 
+  /* The two halves of mutexee_lock, for callers that cannot block in 
+     FUTEX_WAIT, but rather wait on the lock word asynchronously (e.g., via
+     io_uring -- see lock_in_uring.h). mutexee_lock_spin spins exactly like
+     mutexee_lock and returns EBUSY with the lock marked as contended (257)
+     if the caller has to wait for the futex word. After every wake-up, the 
+     caller calls mutexee_lock_retry, which returns EBUSY if it must wait again.
+     The waits are plain futex waits on m, thus mutexee_unlock is unchanged. */
+
+  static inline int
+  mutexee_lock_spin(mutexee_lock_t* m)
+  {
+    if (!xchg_8(&m->l.b.locked, 1))
+      {
+	MUTEXEE_OWNER_SET(m);
+	MUTEXEE_CS(mutexee_cs_start(m););
+	return 0;
+      }
+
+#if MUTEXEE_DO_ADAP == 1
+    const register unsigned int time_spin = m->n_spins;
+#else
+    const unsigned int time_spin = MUTEXEE_SPIN_TRIES_LOCK;
+#endif
+    MUTEXEE_CS(atomic_add(&m->n_spinners, 1););
+    MUTEXEE_FOR_N_CYCLES(time_spin,
+			 if (!xchg_8(&m->l.b.locked, 1)) 
+			   {
+			     MUTEXEE_OWNER_SET(m);
+			     MUTEXEE_CS(atomic_sub(&m->n_spinners, 1);
+					mutexee_cs_start(m););
+			     return 0;
+			   }
+			 PAUSE_IN();
+			 MUTEXEE_OWNER_SPIN_CHECK(m);
+			 );
+
+    atomic_add(&m->n_waiters, 1);
+    MUTEXEE_CS(atomic_sub(&m->n_spinners, 1););
+#if MUTEXEE_FAIR == 2
+    /* the request is cleared by the unlock that serves it, or stays as
+       stale, and thus causes (at most) one early handoff */
+    mutexee_ho_request(m, mutexee_ho_now());
+#endif
+    if (!mutexee_sleep_try(m, 0))
+      {
+	atomic_sub(&m->n_waiters, 1);
+	MUTEXEE_OWNER_SET(m);
+	MUTEXEE_CS(mutexee_cs_start(m););
+	return 0;
+      }
+    return EBUSY;
+  }
+
+  static inline int
+  mutexee_lock_retry(mutexee_lock_t* m)
+  {
+    if (!mutexee_sleep_try(m, 1))
+      {
+	atomic_sub(&m->n_waiters, 1);
+	MUTEXEE_OWNER_SET(m);
+	MUTEXEE_CS(mutexee_cs_start(m););
+	return 0;
+      }
+    return EBUSY;
+  }
+
   static inline void
   mutexee_lock_training(mutexee_lock_t* m)
   {
@@ -332,8 +670,10 @@ extern "C" {
 #if MUTEXEE_PRINT == 1 
 		printf("[MUTEXEE] n_miss = %d  > %d :: switch to mutex\n", m->n_miss, m->n_miss_limit);
 #endif
+#if MUTEXEE_CS_ADAP == 0
 		m->n_spins = MUTEXEE_SPIN_TRIES_LOCK_MIN;
 		m->n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK_MIN;
+#endif
 		m->is_futex = 1;
 	      }
 	  }
@@ -356,8 +696,10 @@ extern "C" {
 #if MUTEXEE_PRINT == 1 
 		printf("[MUTEXEE] TRY :: switch to spinlock\n");
 #endif
+#if MUTEXEE_CS_ADAP == 0
 		m->n_spins = MUTEXEE_SPIN_TRIES_LOCK;
 		m->n_spins_unlock = MUTEXEE_SPIN_TRIES_UNLOCK;
+#endif
 	      }
 	  }
 	m->n_miss = 0;
@@ -368,6 +710,9 @@ extern "C" {
   static inline int
   mutexee_unlock(mutexee_lock_t* m)
   {
+    MUTEXEE_CS(mutexee_cs_stop(m););
+    MUTEXEE_OWNER_CLEAR(m);
+
     /* Locked and not contended */
     if ((m->l.u == 1) && (mutexee_cas(&m->l.u, 1, 0) == 1)) 
       {
@@ -376,6 +721,27 @@ extern "C" {
 
     MUTEXEE_ADAP(mutexee_lock_training(m););
 
+#if MUTEXEE_FAIR == 2
+    const uint32_t start = m->sleep_start;
+    if (start != 0 && m->n_waiters != 0 
+	&& (int32_t) (mutexee_ho_now() - start) > (int32_t) MUTEXEE_HO_DEADLINE)
+      {
+	/* hand off: the lock stays locked for the woken-up sleeper */
+	xchg_32(&m->l.u, 257 | MUTEXEE_HO_GRANT);
+	if (sys_futex(m, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0) > 0
+	    || mutexee_cas(&m->l.u, 257 | MUTEXEE_HO_GRANT, 0) != (257 | MUTEXEE_HO_GRANT))
+	  {
+	    /* a sleeper was woken up, or took the grant before sleeping */
+	    mutexee_ho_served(m, start, 1);
+	    return 0;
+	  }
+	/* nobody sleeps on the lock word (e.g., only cond waiters): 
+	   the grant is revoked and the lock released */
+	mutexee_ho_served(m, start, 0);
+	return 0;
+      }
+#endif
+
     /* Unlock */
     m->l.b.locked = 0;
     asm volatile ("mfence");
@@ -385,6 +751,15 @@ extern "C" {
 	return 0;
       }
 
+    /* Nobody sleeps: no need to wait for a spinner or to wake anyone up. 
+       A thread increments n_waiters before it marks the lock as contended,
+       thus it will either find the lock free, or be woken up by the holder. */
+    if (m->n_waiters == 0)
+      {
+	mutexee_cas(&m->l.u, 256, 0);
+	return 0;
+      }
+
     asm volatile ("mfence");
 #if MUTEXEE_ADAP == 1
     mutexee_cdelay(m->n_spins_unlock);
@@ -409,7 +784,11 @@ extern "C" {
   mutexee_lock_trylock(mutexee_lock_t* m)
   {
     unsigned c = xchg_8(&m->l.b.locked, 1);
-    if (!c) return 0;
+    if (!c)
+      {
+	MUTEXEE_OWNER_SET(m);
+	return 0;
+      }
     return EBUSY;
   }
 
@@ -427,6 +806,7 @@ extern "C" {
   
     /* Sequence variable doesn't actually matter, but keep valgrind happy */
     c->seq = 0;
+    c->n_waiters = 0;
   
     return 0;
   }
@@ -444,6 +824,12 @@ extern "C" {
   {
     /* We are waking someone up */
     atomic_add(&c->seq, 1);
+
+    /* Nobody sleeps (waiters register before releasing the mutex) */
+    if (c->n_waiters == 0)
+      {
+	return 0;
+      }
   
     /* Wake up a thread */
     sys_futex(&c->seq, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
@@ -461,6 +847,11 @@ extern "C" {
   
     /* We are waking everyone up */
     atomic_add(&c->seq, 1);
+
+    if (c->n_waiters == 0)
+      {
+	return 0;
+      }
   
     /* Wake one thread, and requeue the rest on the mutex */
     sys_futex(&c->seq, FUTEX_REQUEUE_PRIVATE, 1, (struct timespec *) INT_MAX, m, 0);
@@ -481,14 +872,22 @@ extern "C" {
 	if (c->m != m) return EINVAL;
       }
   
+    /* register before releasing m, so that signalers see us */
+    atomic_add(&c->n_waiters, 1);
     mutexee_unlock(m);
+    /* a broadcast might requeue us on m: count us as a sleeper of m too */
+    atomic_add(&m->n_waiters, 1);
   
     sys_futex(&c->seq, FUTEX_WAIT_PRIVATE, seq, NULL, NULL, 0);
+    atomic_sub(&c->n_waiters, 1);
   
-    while (xchg_32(&m->l.b.locked, 257) & 1)
+    /* we might have been requeued on m and woken up for a handoff */
+    while (mutexee_sleep_try(m, 1))
       {
 	sys_futex(m, FUTEX_WAIT_PRIVATE, 257, NULL, NULL, 0);
       }
+    atomic_sub(&m->n_waiters, 1);
+    MUTEXEE_OWNER_SET(m);
   
     return 0;
   }
@@ -508,7 +907,9 @@ extern "C" {
 	if (c->m != m) return EINVAL;
       }
   
+    atomic_add(&c->n_waiters, 1);
     mutexee_unlock(m);
+    atomic_add(&m->n_waiters, 1);
 
     struct timespec rt;
     /* Get the current time.  So far we support only one clock.  */
@@ -548,10 +949,14 @@ extern "C" {
       }
 
   timeout:
-    while (xchg_32(&m->l.b.locked, 257) & 1)
+    atomic_sub(&c->n_waiters, 1);
+    /* we might have been requeued on m and woken up for a handoff */
+    while (mutexee_sleep_try(m, 1))
       {
 	sys_futex(m, FUTEX_WAIT_PRIVATE, 257, NULL, NULL, 0);
       }
+    atomic_sub(&m->n_waiters, 1);
+    MUTEXEE_OWNER_SET(m);
 
     return ret;
   }
@@ -0,0 +1,124 @@
+/*
+ * File: mutexee_owner.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Owner (holder) tracking for the MUTEXEE-OWNER lock (LOCK_IN=MUTEXEEO).
+ *
+ *      Every thread that acquires a MUTEXEE-OWNER lock registers a record in a
+ *      global table and the holder publishes the index of its record in the lock.
+ *      A background thread samples the cpu time of the registered threads and
+ *      marks a thread as off-cpu if it did not run for (most of) the last period,
+ *      so that spinners stop spinning and park when the holder is descheduled.
+ *      The sampler is started by the first spinner that checks an owner and
+ *      exits after MUTEXEE_OWNER_IDLE_PERIODS periods without spinners.
+ *
+ *      The on-cpu flag is a hint that is up to one sampling period
+ *      (MUTEXEE_OWNER_SAMPLE_US, 100us) stale, i.e., much longer than the spin
+ *      budget of MUTEXEE (a few us): a holder that was just preempted keeps
+ *      spinners spinning for up to a period, and a holder that just resumed
+ *      makes them park. The only exact update is the one at acquire time:
+ *      the new holder marks itself as on cpu (mutexee_owner_acquired).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _MUTEXEE_OWNER_H_
+#define _MUTEXEE_OWNER_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/types.h>
+
+#define MUTEXEE_OWNER_MAX_THREADS    4096
+#define MUTEXEE_OWNER_SAMPLE_US      100 /* period of the on-cpu sampler */
+#define MUTEXEE_OWNER_ON_CPU_SHIFT   3   /* on cpu if it ran > 1/8 of the period */
+#define MUTEXEE_OWNER_IDLE_PERIODS   100 /* the sampler stops after 100 idle periods */
+
+#define MUTEXEE_OWNER_CACHE_LINE_SIZE 64
+
+  typedef struct mutexee_owner_rec
+  {
+    volatile uint32_t on_cpu;
+    volatile uint32_t in_use;	/* 0: free, 1: registering, 2: in use */
+    clockid_t clock;		/* the thread cpu-time clock */
+    uint64_t cpu_ns;		/* cpu time at the last sample */
+    uint8_t padding[MUTEXEE_OWNER_CACHE_LINE_SIZE - 2 * sizeof(uint32_t)
+		    - sizeof(clockid_t) - sizeof(uint64_t)];
+  } __attribute__((aligned(MUTEXEE_OWNER_CACHE_LINE_SIZE))) mutexee_owner_rec_t;
+
+  extern mutexee_owner_rec_t mutexee_owner_recs[MUTEXEE_OWNER_MAX_THREADS];
+  extern __thread uint32_t mutexee_owner_id;
+  extern volatile uint32_t mutexee_owner_demand; /* a spinner checked an owner
+						   in the current period */
+
+  /* sets mutexee_owner_demand and starts the sampler if it is not running */
+  extern void mutexee_owner_want(void);
+
+  /* registers the calling thread. Returns the owner id of the thread (index in mutexee_owner_recs + 1), or
+     0 if the table is full */
+  extern uint32_t mutexee_owner_register(void);
+
+  static inline uint32_t
+  mutexee_owner_self()
+  {
+    const uint32_t id = mutexee_owner_id;
+    if (__builtin_expect(id != 0, 1))
+      {
+	return id;
+      }
+    return mutexee_owner_register();
+  }
+
+  /* called by the new holder of a lock: the holder is on cpu by definition,
+     whatever the sampler last saw (e.g., while it was sleeping) */
+  static inline uint32_t
+  mutexee_owner_acquired()
+  {
+    const uint32_t id = mutexee_owner_self();
+    if (id != 0 && !mutexee_owner_recs[id - 1].on_cpu)
+      {
+	mutexee_owner_recs[id - 1].on_cpu = 1;
+      }
+    return id;
+  }
+
+  /* 0 if the owner is known to be off cpu (called by spinners) */
+  static inline int
+  mutexee_owner_on_cpu(const uint32_t id)
+  {
+    if (__builtin_expect(!mutexee_owner_demand, 0))
+      {
+	mutexee_owner_want();
+      }
+    return (id == 0) || mutexee_owner_recs[id - 1].on_cpu;
+  }
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _MUTEXEE_OWNER_H_ */
@@ -0,0 +1,323 @@
+/*
+ * File: parking_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      PARKING: a 1-byte lock (and a 1-byte condvar) on top of the process-wide
+ *      parking lot of parking_lot.h, after WebKit's WTF::Lock. The byte holds a
+ *      locked and a has-parked bit. Threads spin for a while as long as nobody is
+ *      parked, and then park on the address of the lock; the unlock only goes to
+ *      the parking lot if the has-parked bit is set.
+ *
+ *      Link with liblockin.a (src/parking_lot.c).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PARKING_IN_H_
+#define _PARKING_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sched.h>
+#include <pthread.h>
+#include "parking_lot.h"
+
+#define LOCK_IN_NAME "PARKING"
+
+/* settings *********************************************************************** */
+#define REPLACE_MUTEX  1	/* ovewrite the pthread_[mutex|cond] functions */
+
+#define PARKING_SPIN_TRIES    40  /* number of yield-and-retry tries before parking 
+				     (as in WTF::Lock) */
+/* ******************************************************************************** */
+
+#define PARKING_LOCKED        0x1
+#define PARKING_PARKED        0x2
+
+  typedef struct parking_lock
+  {
+    volatile uint8_t b;
+  } parking_lock_t;
+
+#define PARKING_LOCK_INITIALIZER { .b = 0 }
+
+  typedef struct parking_cond
+  {
+    volatile uint8_t has_waiters;
+  } parking_cond_t;
+
+#define PARKING_COND_INITIALIZER { .has_waiters = 0 }
+
+#define LOCK_IN_FUTEX_STATS(w, k)		\
+  *(w) = parking_lot_n_futex_wait;		\
+  *(k) = parking_lot_n_futex_wake;
+
+#define parking_cas(a, b, c) __sync_val_compare_and_swap(a, b, c)
+
+  static inline int
+  parking_lock_init(parking_lock_t* m, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    m->b = 0;
+    return 0;
+  }
+
+  static inline int
+  parking_lock_destroy(parking_lock_t* m)
+  {
+    (void) m;
+    return 0;
+  }
+
+  static inline int
+  parking_lock_trylock(parking_lock_t* m)
+  {
+    uint8_t v = m->b;
+    while (!(v & PARKING_LOCKED))
+      {
+	const uint8_t o = parking_cas(&m->b, v, v | PARKING_LOCKED);
+	if (o == v)
+	  {
+	    return 0;
+	  }
+	v = o;
+      }
+    return EBUSY;
+  }
+
+  static inline int
+  parking_lock_validate(const void* addr, void* arg)
+  {
+    (void) arg;
+    return ((parking_lock_t*) addr)->b == (PARKING_LOCKED | PARKING_PARKED);
+  }
+
+  static inline void
+  parking_lock_slow(parking_lock_t* m)
+  {
+    int spins = 0;
+    while (1)
+      {
+	uint8_t v = m->b;
+	if (!(v & PARKING_LOCKED))
+	  {
+	    if (parking_cas(&m->b, v, v | PARKING_LOCKED) == v)
+	      {
+		return;
+	      }
+	    continue;
+	  }
+
+	/* spin only if nobody is parked */
+	if (!(v & PARKING_PARKED) && spins < PARKING_SPIN_TRIES)
+	  {
+	    spins++;
+	    sched_yield();
+	    continue;
+	  }
+
+	if (!(v & PARKING_PARKED))
+	  {
+	    if (parking_cas(&m->b, v, v | PARKING_PARKED) != v)
+	      {
+		continue;
+	      }
+	  }
+
+	parking_lot_park(m, parking_lock_validate, NULL, NULL, NULL, NULL);
+      }
+  }
+
+  static inline int
+  parking_lock_lock(parking_lock_t* m)
+  {
+    if (__builtin_expect(parking_cas(&m->b, 0, PARKING_LOCKED) == 0, 1))
+      {
+	return 0;
+      }
+    parking_lock_slow(m);
+    return 0;
+  }
+
+  /* called under the bucket lock: releases the lock, and keeps the 
+     has-parked bit if more threads are parked */
+  static inline void
+  parking_unlock_callback(const void* addr, int n_unparked, int have_more, void* arg)
+  {
+    (void) n_unparked;
+    (void) arg;
+    ((parking_lock_t*) addr)->b = have_more ? PARKING_PARKED : 0;
+  }
+
+  static inline int
+  parking_lock_unlock(parking_lock_t* m)
+  {
+    if (__builtin_expect(parking_cas(&m->b, PARKING_LOCKED, 0) == PARKING_LOCKED, 1))
+      {
+	return 0;
+      }
+    parking_lot_unpark_one(m, parking_unlock_callback, NULL);
+    return 0;
+  }
+
+  static inline int
+  parking_lock_timedlock(parking_lock_t* m, const struct timespec* ts)
+  {
+    fprintf(stderr, "** warning -- pthread_mutex_timedlock not implemented\n");
+    return 0;
+  }
+
+  /* ******************************************************************************** */
+  /* condition variables */
+  /* ******************************************************************************** */
+
+  static inline int
+  parking_cond_init(parking_cond_t* c, const pthread_condattr_t* a)
+  {
+    (void) a;
+    c->has_waiters = 0;
+    return 0;
+  }
+
+  static inline int
+  parking_cond_destroy(parking_cond_t* c)
+  {
+    (void) c;
+    return 0;
+  }
+
+  static inline int
+  parking_cond_validate(const void* addr, void* arg)
+  {
+    (void) arg;
+    ((parking_cond_t*) addr)->has_waiters = 1;
+    return 1;
+  }
+
+  static inline void
+  parking_cond_before_sleep(void* m)
+  {
+    parking_lock_unlock((parking_lock_t*) m);
+  }
+
+  static inline int
+  parking_cond_timedwait_rel(parking_cond_t* c, parking_lock_t* m, const struct timespec* rt)
+  {
+    int ret = parking_lot_park(c, parking_cond_validate, NULL, 
+			       parking_cond_before_sleep, m, rt);
+    parking_lock_lock(m);
+    return (ret == -1) ? ETIMEDOUT : 0;
+  }
+
+  static inline int
+  parking_cond_wait(parking_cond_t* c, parking_lock_t* m)
+  {
+    return parking_cond_timedwait_rel(c, m, NULL);
+  }
+
+  static inline int
+  parking_cond_timedwait(parking_cond_t* c, parking_lock_t* m, const struct timespec* ts)
+  {
+    struct timespec rt;
+    struct timeval tv;
+    (void) gettimeofday (&tv, NULL);
+
+    /* Convert the absolute timeout value to a relative timeout.  */
+    rt.tv_sec = ts->tv_sec - tv.tv_sec;
+    rt.tv_nsec = ts->tv_nsec - tv.tv_usec * 1000;
+    if (rt.tv_nsec < 0)
+      {
+	rt.tv_nsec += 1000000000;
+	--rt.tv_sec;
+      }
+    if (rt.tv_sec < 0)
+      {
+	return ETIMEDOUT;
+      }
+
+    return parking_cond_timedwait_rel(c, m, &rt);
+  }
+
+  static inline void
+  parking_cond_signal_callback(const void* addr, int n_unparked, int have_more, void* arg)
+  {
+    (void) n_unparked;
+    (void) arg;
+    ((parking_cond_t*) addr)->has_waiters = have_more;
+  }
+
+  static inline int
+  parking_cond_signal(parking_cond_t* c)
+  {
+    if (c->has_waiters)
+      {
+	parking_lot_unpark_one(c, parking_cond_signal_callback, NULL);
+      }
+    return 0;
+  }
+
+  static inline int
+  parking_cond_broadcast(parking_cond_t* c)
+  {
+    if (c->has_waiters)
+      {
+	parking_lot_unpark_all(c, parking_cond_signal_callback, NULL);
+      }
+    return 0;
+  }
+
+#if REPLACE_MUTEX == 1
+#  define pthread_mutex_init    parking_lock_init
+#  define pthread_mutex_destroy parking_lock_destroy
+#  define pthread_mutex_lock    parking_lock_lock
+#  define pthread_mutex_timedlock parking_lock_timedlock
+#  define pthread_mutex_unlock  parking_lock_unlock
+#  define pthread_mutex_trylock parking_lock_trylock
+#  define pthread_mutex_t       parking_lock_t
+#  undef  PTHREAD_MUTEX_INITIALIZER
+#  define PTHREAD_MUTEX_INITIALIZER PARKING_LOCK_INITIALIZER
+
+#  define pthread_cond_init     parking_cond_init
+#  define pthread_cond_destroy  parking_cond_destroy
+#  define pthread_cond_signal   parking_cond_signal
+#  define pthread_cond_broadcast parking_cond_broadcast
+#  define pthread_cond_wait     parking_cond_wait
+#  define pthread_cond_timedwait parking_cond_timedwait
+#  define pthread_cond_t        parking_cond_t
+#  undef  PTHREAD_COND_INITIALIZER
+#  define PTHREAD_COND_INITIALIZER PARKING_COND_INITIALIZER
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PARKING_IN_H_ */
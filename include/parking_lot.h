@@ -0,0 +1,86 @@
+/*
+ * File: parking_lot.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      A process-wide parking lot (after WebKit's ParkingLot): threads park on
+ *      any address, in a fixed-size hashed table of wait queues, so that the
+ *      objects they wait on (e.g., the 1-byte locks and condvars of parking_in.h)
+ *      do not need to embed any queue or futex word.
+ *
+ *      Every bucket is protected by a small spinlock. parking_lot_park validates,
+ *      under the bucket lock, that the thread still has to sleep, and the unpark
+ *      functions call their callback under the same lock, so that the object can
+ *      update its state (e.g., the has-parked bit) atomically with the queue.
+ *      Each thread sleeps on its own futex word.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PARKING_LOT_H_
+#define _PARKING_LOT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <stddef.h>
+#include <time.h>
+
+#define PARKING_LOT_BUCKETS      4096 /* power of 2 */
+
+  /* returns non-0 if the thread should park (called under the bucket lock) */
+  typedef int (*parking_lot_validate_t)(const void* addr, void* arg);
+  /* called after the thread is enqueued and the bucket is unlocked */
+  typedef void (*parking_lot_before_sleep_t)(void* arg);
+  /* called under the bucket lock, with the number of unparked threads, and
+     whether more threads (might) remain parked on addr */
+  typedef void (*parking_lot_callback_t)(const void* addr, int n_unparked, 
+					 int have_more, void* arg);
+
+  /* park the calling thread on addr, if validate(addr, arg) returns non-0.
+     Returns 1 if the thread was unparked, 0 if validation failed, or
+     -1 if the (relative) timeout expired */
+  extern int parking_lot_park(const void* addr, 
+			      parking_lot_validate_t validate, void* validate_arg,
+			      parking_lot_before_sleep_t before_sleep, void* before_sleep_arg,
+			      const struct timespec* timeout);
+
+  /* unpark (at most) one thread parked on addr. Returns the number of 
+     unparked threads (0 or 1). callback can be NULL */
+  extern int parking_lot_unpark_one(const void* addr, 
+				    parking_lot_callback_t callback, void* arg);
+
+  /* unpark all the threads parked on addr. Returns their number */
+  extern int parking_lot_unpark_all(const void* addr, 
+				    parking_lot_callback_t callback, void* arg);
+
+  /* number of futex wait and wake calls of the calling thread */
+  extern __thread size_t parking_lot_n_futex_wait;
+  extern __thread size_t parking_lot_n_futex_wake;
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PARKING_LOT_H_ */
@@ -0,0 +1,287 @@
+/*
+ * File: perf_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Hardware performance counters around the measured region of the benchmarks,
+ *      with perf_event_open: every thread opens its own group of events (cycles,
+ *      instructions, LLC misses, plus the events of LOCKIN_PERF_EVENTS, e.g.,
+ *      HITM or remote-cache events, which are model specific) and the counts are
+ *      reported per acquire.
+ *
+ *        LOCKIN_PERF_EVENTS="hitm=0x04d2,ctx=1:3"   name=config (raw) or name=type:config
+ *
+ *      Degrades cleanly: the events that cannot be opened (no PMU in a VM,
+ *      perf_event_paranoid, seccomp) are dropped at perf_in_init, and if none is
+ *      left the report says why. If the kernel cannot be counted, only the user
+ *      space is. Multiplexed counts are scaled by time_enabled / time_running.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PERF_IN_H_
+#define _PERF_IN_H_
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#define PERF_IN_MAX_EVENTS 8
+#define PERF_IN_NAME_LEN   16
+
+typedef struct perf_in_event
+{
+  char name[PERF_IN_NAME_LEN];
+  uint32_t type;
+  uint64_t config;
+} perf_in_event_t;
+
+/* the counts of one thread (or the sum of all threads) */
+typedef struct perf_in
+{
+  int fd[PERF_IN_MAX_EVENTS];
+  int leader;			/* the fd of the group leader, or -1 */
+  uint64_t count[PERF_IN_MAX_EVENTS];
+  uint64_t enabled;
+  uint64_t running;
+} perf_in_t;
+
+static perf_in_event_t perf_in_events[PERF_IN_MAX_EVENTS] =
+  {
+    { "cycles",       PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES },
+    { "instructions", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS },
+    { "llc_misses",   PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES },
+  };
+static int perf_in_num_events = 3;
+static int perf_in_user_only = 0;
+static int perf_in_errno = 0;	/* why the last event could not be opened */
+
+static inline int
+perf_in_event_open(const perf_in_event_t* e, int group_fd)
+{
+  struct perf_event_attr attr;
+  memset(&attr, 0, sizeof(attr));
+  attr.size = sizeof(attr);
+  attr.type = e->type;
+  attr.config = e->config;
+  attr.disabled = (group_fd == -1);
+  attr.exclude_kernel = perf_in_user_only;
+  attr.exclude_hv = 1;
+  attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+  /* this thread, any cpu */
+  return syscall(__NR_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+
+/* "name=config" (raw event) or "name=type:config" */
+static inline int
+perf_in_parse(const char* spec)
+{
+  char* copy = strdup(spec), * save = NULL, * e;
+  for (e = strtok_r(copy, ",", &save); e != NULL; e = strtok_r(NULL, ",", &save))
+    {
+      char* eq = strchr(e, '=');
+      if (eq == NULL || perf_in_num_events == PERF_IN_MAX_EVENTS)
+	{
+	  fprintf(stderr, "[PERF] ignoring event: %s\n", e);
+	  continue;
+	}
+      perf_in_event_t* pe = perf_in_events + perf_in_num_events;
+      snprintf(pe->name, PERF_IN_NAME_LEN, "%.*s", (int) (eq - e), e);
+      char* end;
+      uint64_t v = strtoull(eq + 1, &end, 0);
+      pe->type = PERF_TYPE_RAW;
+      if (*end == ':')
+	{
+	  pe->type = (uint32_t) v;
+	  v = strtoull(end + 1, &end, 0);
+	}
+      if (*end != '\0')
+	{
+	  fprintf(stderr, "[PERF] ignoring event: %s\n", e);
+	  continue;
+	}
+      pe->config = v;
+      perf_in_num_events++;
+    }
+  free(copy);
+  return perf_in_num_events;
+}
+
+/* parses LOCKIN_PERF_EVENTS and keeps the events that this thread can open;
+   returns the number of events (0 = counters not available) */
+static inline int
+perf_in_init()
+{
+  const char* spec = getenv("LOCKIN_PERF_EVENTS");
+  if (spec != NULL)
+    {
+      perf_in_parse(spec);
+    }
+
+  int i, n = 0;
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      int fd = perf_in_event_open(perf_in_events + i, -1);
+      if (fd < 0 && (errno == EACCES || errno == EPERM) && !perf_in_user_only)
+	{
+	  perf_in_user_only = 1;
+	  fd = perf_in_event_open(perf_in_events + i, -1);
+	}
+      if (fd < 0)
+	{
+	  perf_in_errno = errno;
+	  continue;
+	}
+      close(fd);
+      perf_in_events[n++] = perf_in_events[i];
+    }
+  perf_in_num_events = n;
+  return n;
+}
+
+/* opens the group of the calling thread and starts counting */
+static inline void
+perf_in_start(perf_in_t* p)
+{
+  memset(p, 0, sizeof(perf_in_t));
+  int i;
+  p->leader = -1;
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      p->fd[i] = perf_in_event_open(perf_in_events + i, p->leader);
+      if (p->leader == -1)
+	{
+	  p->leader = p->fd[i];
+	}
+    }
+  if (p->leader >= 0)
+    {
+      ioctl(p->leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+      ioctl(p->leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+}
+
+/* stops counting, reads the (scaled) counts, and closes the group */
+static inline void
+perf_in_stop(perf_in_t* p)
+{
+  const int leader = p->leader;
+  if (leader < 0)
+    {
+      return;
+    }
+  ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  uint64_t buf[3 + PERF_IN_MAX_EVENTS];
+  const ssize_t r = read(leader, buf, sizeof(buf));
+  int i;
+  if (r >= (ssize_t) (3 * sizeof(uint64_t)))
+    {
+      /* nr, time_enabled, time_running, values; the events that failed to
+	 open in this thread are not in the group */
+      const uint64_t nr = buf[0];
+      p->enabled = buf[1];
+      p->running = buf[2];
+      const double scale = (p->running > 0) ? (double) p->enabled / p->running : 0;
+      uint64_t v = 0;
+      for (i = 0; i < perf_in_num_events && v < nr; i++)
+	{
+	  if (p->fd[i] >= 0)
+	    {
+	      p->count[i] = (uint64_t) (buf[3 + v++] * scale);
+	    }
+	}
+    }
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      if (p->fd[i] >= 0)
+	{
+	  close(p->fd[i]);
+	}
+      p->fd[i] = -1;
+    }
+}
+
+static inline void
+perf_in_merge(perf_in_t* total, const perf_in_t* p)
+{
+  int i;
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      total->count[i] += p->count[i];
+    }
+  total->enabled += p->enabled;
+  total->running += p->running;
+}
+
+static inline int
+perf_in_index(const char* name)
+{
+  int i;
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      if (!strcmp(perf_in_events[i].name, name))
+	{
+	  return i;
+	}
+    }
+  return -1;
+}
+
+/* one line with the counts per acquire */
+static inline void
+perf_in_report(const perf_in_t* total, size_t acquires)
+{
+  if (perf_in_num_events == 0)
+    {
+      printf("#perf         : not available (%s: no PMU, e.g., in a VM, or see"
+	     " /proc/sys/kernel/perf_event_paranoid)\n", strerror(perf_in_errno));
+      return;
+    }
+
+  printf("#perf         :");
+  int i;
+  for (i = 0; i < perf_in_num_events; i++)
+    {
+      printf("%s %s %.4g", i ? " |" : "", perf_in_events[i].name,
+	     acquires ? (double) total->count[i] / acquires : 0.0);
+    }
+  const int c = perf_in_index("cycles"), in = perf_in_index("instructions");
+  if (c >= 0 && in >= 0 && total->count[c] > 0)
+    {
+      printf(" | ipc %.2f", (double) total->count[in] / total->count[c]);
+    }
+  printf(" (per acquire, %s", perf_in_user_only ? "user space" : "user + kernel");
+  if (total->enabled > 0 && total->running < total->enabled)
+    {
+      printf(", counted %.0f%% of the time", 100.0 * total->running / total->enabled);
+    }
+  printf(")\n");
+}
+
+#endif	/* _PERF_IN_H_ */
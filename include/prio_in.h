@@ -0,0 +1,528 @@
+/*
+ * File: prio_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      PRIO: a lock with PRIO_CLASSES waiter (priority) classes.
+ *
+ *      Every thread has a class (lock_in_set_prio, 0 is the highest priority,
+ *      default PRIO_DEFAULT_CLASS). Contended waiters enqueue in the FIFO queue of
+ *      their class and spin (then sleep with futex) on their own node. Unlock
+ *      hands the lock over directly to the head of the highest-priority non-empty
+ *      queue. Anti-starvation: after PRIO_BUDGET consecutive handovers that
+ *      bypass waiters of lower classes, the next handover goes to the head of the
+ *      lowest-priority non-empty queue.
+ *
+ *      The queues are protected by a small internal spinlock (guard) that is only
+ *      taken on the contended paths. The lock word counts the registered
+ *      waiters, so that uncontended lock and unlock are a single CAS each, and a
+ *      newly arriving thread never barges in front of the waiters.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PRIO_IN_H_
+#define _PRIO_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <sys/time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define LOCK_IN_NAME "PRIO"
+
+/* settings *********************************************************************** */
+#define REPLACE_MUTEX  1	/* ovewrite the pthread_[mutex|cond] functions */
+
+#if !defined(PRIO_CLASSES)
+#  define PRIO_CLASSES        2	/* number of waiter classes */
+#endif
+#define PRIO_DEFAULT_CLASS    0
+#if !defined(PRIO_BUDGET)
+#  define PRIO_BUDGET         64 /* handovers that may bypass lower classes in a row */
+#endif
+#define PRIO_SPIN_TRIES       4096 /* spins of a waiter before sleeping */
+#define PRIO_GUARD_YIELD      1024 /* the guard is yielded every 1024 spins */
+/* ******************************************************************************** */
+
+#define PRIO_LOCKED           0x1
+#define PRIO_WAITER           0x2 /* the lock word counts the waiters in units of 2 */
+
+#define PRIO_NODE_WAITING     0
+#define PRIO_NODE_GRANTED     1
+#define PRIO_NODE_SLEEPING    2
+
+  /* lives on the stack of the waiter */
+  typedef struct prio_node
+  {
+    struct prio_node* next;
+    volatile uint32_t state;
+  } prio_node_t;
+
+  typedef struct prio_lock
+  {
+    volatile uint32_t state;	/* PRIO_LOCKED | (number of waiters * PRIO_WAITER) */
+    volatile uint32_t guard;	/* protects the queues and n_bypass */
+    uint32_t n_bypass;
+    prio_node_t* head[PRIO_CLASSES];
+    prio_node_t* tail[PRIO_CLASSES];
+  } prio_lock_t;
+
+#define PRIO_LOCK_INITIALIZER { .state = 0, .guard = 0, .n_bypass = 0 }
+
+  typedef struct prio_cond
+  {
+    volatile uint32_t seq;
+  } prio_cond_t;
+
+#define PRIO_COND_INITIALIZER { .seq = 0 }
+
+  static __thread int prio_my_class = PRIO_DEFAULT_CLASS;
+
+#define LOCK_IN_SET_PRIO(c)						\
+  prio_my_class = ((c) < 0) ? 0 : (((c) >= PRIO_CLASSES) ? PRIO_CLASSES - 1 : (c))
+
+  static inline long
+  prio_futex(volatile uint32_t* w, int op, uint32_t val, const struct timespec* rt)
+  {
+    return syscall(SYS_futex, w, op, val, rt, NULL, 0);
+  }
+
+  static inline void
+  prio_guard_lock(prio_lock_t* l)
+  {
+    uint32_t spins = 0;
+    while (l->guard || __sync_lock_test_and_set(&l->guard, 1))
+      {
+	PAUSE_IN();
+	if ((++spins & (PRIO_GUARD_YIELD - 1)) == 0)
+	  {
+	    sched_yield();
+	  }
+      }
+  }
+
+  static inline void
+  prio_guard_unlock(prio_lock_t* l)
+  {
+    __sync_lock_release(&l->guard);
+  }
+
+  static inline int
+  prio_lock_init(prio_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->state = 0;
+    l->guard = 0;
+    l->n_bypass = 0;
+    int c;
+    for (c = 0; c < PRIO_CLASSES; c++)
+      {
+	l->head[c] = NULL;
+	l->tail[c] = NULL;
+      }
+    return 0;
+  }
+
+  static inline int
+  prio_lock_destroy(prio_lock_t* l)
+  {
+    (void) l;
+    return 0;
+  }
+
+  static inline int
+  prio_lock_trylock(prio_lock_t* l)
+  {
+    if (l->state == 0 && __sync_val_compare_and_swap(&l->state, 0, PRIO_LOCKED) == 0)
+      {
+	return 0;
+      }
+    return EBUSY;
+  }
+
+  /* rt = ts - now; returns -1 if the absolute time ts has passed */
+  static inline int
+  prio_timespec_rel(const struct timespec* ts, struct timespec* rt)
+  {
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    rt->tv_sec = ts->tv_sec - tv.tv_sec;
+    rt->tv_nsec = ts->tv_nsec - tv.tv_usec * 1000;
+    if (rt->tv_nsec < 0)
+      {
+	rt->tv_nsec += 1000000000;
+	--rt->tv_sec;
+      }
+    return (rt->tv_sec < 0) ? -1 : 0;
+  }
+
+  /* waits on the node until the lock is handed over */
+  static inline void
+  prio_node_wait(prio_node_t* n)
+  {
+    uint32_t spins = 0;
+    while (n->state != PRIO_NODE_GRANTED)
+      {
+	if (++spins < PRIO_SPIN_TRIES)
+	  {
+	    PAUSE_IN();
+	    continue;
+	  }
+	if (__sync_val_compare_and_swap(&n->state, PRIO_NODE_WAITING, PRIO_NODE_SLEEPING) 
+	    != PRIO_NODE_GRANTED)
+	  {
+	    prio_futex(&n->state, FUTEX_WAIT_PRIVATE, PRIO_NODE_SLEEPING, NULL);
+	  }
+      }
+  }
+
+  /* as prio_node_wait, until the absolute time ts; returns ETIMEDOUT if the
+     lock was not handed over by then */
+  static inline int
+  prio_node_timedwait(prio_node_t* n, const struct timespec* ts)
+  {
+    uint32_t spins = 0;
+    while (n->state != PRIO_NODE_GRANTED)
+      {
+	if (++spins < PRIO_SPIN_TRIES)
+	  {
+	    PAUSE_IN();
+	    continue;
+	  }
+	struct timespec rt;
+	if (prio_timespec_rel(ts, &rt) != 0)
+	  {
+	    return ETIMEDOUT;
+	  }
+	if (__sync_val_compare_and_swap(&n->state, PRIO_NODE_WAITING, PRIO_NODE_SLEEPING) 
+	    != PRIO_NODE_GRANTED)
+	  {
+	    prio_futex(&n->state, FUTEX_WAIT_PRIVATE, PRIO_NODE_SLEEPING, &rt);
+	  }
+      }
+    return 0;
+  }
+
+  /* acquires the lock, or registers n as a waiter of class c; returns 1 if
+     the lock was acquired */
+  static inline int
+  prio_enqueue(prio_lock_t* l, prio_node_t* n, const int c)
+  {
+    n->next = NULL;
+    n->state = PRIO_NODE_WAITING;
+
+    prio_guard_lock(l);
+    uint32_t s;
+    do
+      {
+	s = l->state;
+	if (!(s & PRIO_LOCKED) 
+	    && __sync_val_compare_and_swap(&l->state, s, s | PRIO_LOCKED) == s)
+	  {
+	    prio_guard_unlock(l);
+	    return 1;
+	  }
+      }
+    while (__sync_val_compare_and_swap(&l->state, s, s + PRIO_WAITER) != s);
+
+    if (l->tail[c] == NULL)
+      {
+	l->head[c] = n;
+      }
+    else
+      {
+	l->tail[c]->next = n;
+      }
+    l->tail[c] = n;
+    prio_guard_unlock(l);
+    return 0;
+  }
+
+  /* removes n from the queue of class c (with the guard held); returns 0 if n
+     is not queued anymore, i.e., the lock is being handed over to it */
+  static inline int
+  prio_unlink(prio_lock_t* l, prio_node_t* n, const int c)
+  {
+    prio_node_t* prev = NULL;
+    prio_node_t* cur = l->head[c];
+    while (cur != NULL && cur != n)
+      {
+	prev = cur;
+	cur = cur->next;
+      }
+    if (cur == NULL)
+      {
+	return 0;
+      }
+
+    if (prev == NULL)
+      {
+	l->head[c] = n->next;
+      }
+    else
+      {
+	prev->next = n->next;
+      }
+    if (l->tail[c] == n)
+      {
+	l->tail[c] = prev;
+      }
+    return 1;
+  }
+
+  static inline int
+  prio_lock_lock(prio_lock_t* l)
+  {
+    if (prio_lock_trylock(l) == 0)
+      {
+	return 0;
+      }
+
+    prio_node_t n;
+    if (!prio_enqueue(l, &n, prio_my_class))
+      {
+	prio_node_wait(&n);
+      }
+    return 0;
+  }
+
+  /* returns the head of the next queue to serve, or NULL if all queues are
+     empty (with the guard held) */
+  static inline prio_node_t*
+  prio_dequeue(prio_lock_t* l)
+  {
+    int c = 0, lowest = -1;
+    while (c < PRIO_CLASSES && l->head[c] == NULL)
+      {
+	c++;
+      }
+    if (c == PRIO_CLASSES)
+      {
+	return NULL;
+      }
+    int o;
+    for (o = PRIO_CLASSES - 1; o > c; o--)
+      {
+	if (l->head[o] != NULL)
+	  {
+	    lowest = o;
+	    break;
+	  }
+      }
+
+    if (lowest < 0)
+      {
+	l->n_bypass = 0;
+      }
+    else if (++l->n_bypass > PRIO_BUDGET)
+      {
+	l->n_bypass = 0;
+	c = lowest;
+      }
+
+    prio_node_t* n = l->head[c];
+    l->head[c] = n->next;
+    if (n->next == NULL)
+      {
+	l->tail[c] = NULL;
+      }
+    return n;
+  }
+
+  static inline int
+  prio_lock_unlock(prio_lock_t* l)
+  {
+    if (__sync_val_compare_and_swap(&l->state, PRIO_LOCKED, 0) == PRIO_LOCKED)
+      {
+	return 0;
+      }
+
+    /* there are (registered) waiters: hand the lock over, unless they all
+       timed out (prio_lock_timedlock) before we took the guard */
+    prio_guard_lock(l);
+    prio_node_t* n = NULL;
+    while (1)
+      {
+	const uint32_t s = l->state;
+	if (s == PRIO_LOCKED)
+	  {
+	    if (__sync_val_compare_and_swap(&l->state, PRIO_LOCKED, 0) == PRIO_LOCKED)
+	      {
+		break;
+	      }
+	    continue;
+	  }
+	n = prio_dequeue(l);
+	__sync_fetch_and_sub(&l->state, PRIO_WAITER);
+	break;
+      }
+    prio_guard_unlock(l);
+    if (n == NULL)
+      {
+	return 0;
+      }
+
+    /* n might be gone as soon as it is granted: the futex wake on its
+       address can be spurious for someone else, as with any futex */
+    if (__sync_lock_test_and_set(&n->state, PRIO_NODE_GRANTED) == PRIO_NODE_SLEEPING)
+      {
+	prio_futex(&n->state, FUTEX_WAKE_PRIVATE, 1, NULL);
+      }
+    return 0;
+  }
+
+  static inline int
+  prio_lock_timedlock(prio_lock_t* l, const struct timespec* ts)
+  {
+    if (prio_lock_trylock(l) == 0)
+      {
+	return 0;
+      }
+
+    prio_node_t n;
+    const int c = prio_my_class;
+    if (prio_enqueue(l, &n, c) || prio_node_timedwait(&n, ts) == 0)
+      {
+	return 0;
+      }
+
+    /* timed out: leave the queue, unless unlock has already dequeued n */
+    prio_guard_lock(l);
+    if (prio_unlink(l, &n, c))
+      {
+	__sync_fetch_and_sub(&l->state, PRIO_WAITER);
+	prio_guard_unlock(l);
+	return ETIMEDOUT;
+      }
+    prio_guard_unlock(l);
+
+    while (n.state != PRIO_NODE_GRANTED)
+      {
+	PAUSE_IN();
+      }
+    return 0;
+  }
+
+  /* condition variables */
+
+  static inline int
+  prio_cond_init(prio_cond_t* c, const pthread_condattr_t* a)
+  {
+    (void) a;
+    c->seq = 0;
+    return 0;
+  }
+
+  static inline int
+  prio_cond_destroy(prio_cond_t* c)
+  {
+    (void) c;
+    return 0;
+  }
+
+  static inline int
+  prio_cond_timedwait_rel(prio_cond_t* c, prio_lock_t* m, const struct timespec* rt)
+  {
+    const uint32_t seq = c->seq;
+    prio_lock_unlock(m);
+    int ret = 0;
+    if (prio_futex(&c->seq, FUTEX_WAIT_PRIVATE, seq, rt) != 0 && errno == ETIMEDOUT)
+      {
+	ret = ETIMEDOUT;
+      }
+    prio_lock_lock(m);
+    return ret;
+  }
+
+  static inline int
+  prio_cond_wait(prio_cond_t* c, prio_lock_t* m)
+  {
+    return prio_cond_timedwait_rel(c, m, NULL);
+  }
+
+  static inline int
+  prio_cond_timedwait(prio_cond_t* c, prio_lock_t* m, const struct timespec* ts)
+  {
+    struct timespec rt;
+    if (prio_timespec_rel(ts, &rt) != 0)
+      {
+	return ETIMEDOUT;
+      }
+    return prio_cond_timedwait_rel(c, m, &rt);
+  }
+
+  static inline int
+  prio_cond_signal(prio_cond_t* c)
+  {
+    __sync_add_and_fetch(&c->seq, 1);
+    prio_futex(&c->seq, FUTEX_WAKE_PRIVATE, 1, NULL);
+    return 0;
+  }
+
+  static inline int
+  prio_cond_broadcast(prio_cond_t* c)
+  {
+    __sync_add_and_fetch(&c->seq, 1);
+    prio_futex(&c->seq, FUTEX_WAKE_PRIVATE, INT_MAX, NULL);
+    return 0;
+  }
+
+#if REPLACE_MUTEX == 1
+#  define pthread_mutex_init    prio_lock_init
+#  define pthread_mutex_destroy prio_lock_destroy
+#  define pthread_mutex_lock    prio_lock_lock
+#  define pthread_mutex_timedlock prio_lock_timedlock
+#  define pthread_mutex_unlock  prio_lock_unlock
+#  define pthread_mutex_trylock prio_lock_trylock
+#  define pthread_mutex_t       prio_lock_t
+#  undef  PTHREAD_MUTEX_INITIALIZER
+#  define PTHREAD_MUTEX_INITIALIZER PRIO_LOCK_INITIALIZER
+
+#  define pthread_cond_init     prio_cond_init
+#  define pthread_cond_destroy  prio_cond_destroy
+#  define pthread_cond_signal   prio_cond_signal
+#  define pthread_cond_broadcast prio_cond_broadcast
+#  define pthread_cond_wait     prio_cond_wait
+#  define pthread_cond_timedwait prio_cond_timedwait
+#  define pthread_cond_t        prio_cond_t
+#  undef  PTHREAD_COND_INITIALIZER
+#  define PTHREAD_COND_INITIALIZER PRIO_COND_INITIALIZER
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PRIO_IN_H_ */
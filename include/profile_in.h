@@ -0,0 +1,265 @@
+/*
+ * File: profile_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Call-site-attributed lock profiler on top of any LOCK_IN algorithm
+ *      (LOCK_IN_PROFILE=1).
+ *
+ *      pthread_mutex_lock/trylock/timedlock become macros that pass a static
+ *      descriptor of the call site (file, line, function). One out of every
+ *      LOCK_IN_PROF_SAMPLE acquisitions of each thread is sampled: its wait time
+ *      and, at the matching unlock, its hold time are added to the log2
+ *      histograms of (lock, call site) in the table of the thread (see
+ *      lock_in_profile.h). The non-sampled acquisitions only increment a
+ *      thread-local counter, and unlock only checks whether the thread holds a
+ *      sampled lock.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _PROFILE_IN_H_
+#define _PROFILE_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lock_in_profile.h"
+#include "wrap_in.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error profile_in.h is included by lock_in.h (with LOCK_IN_PROFILE=1)
+#endif
+#if LOCK_IN == GLS
+#  error LOCK_IN_PROFILE does not support GLS
+#endif
+
+  LOCK_IN_WRAP_BASE(profile)
+
+  typedef struct profile_lock
+  {
+    volatile uint32_t base_ready;	/* LOCK_IN_WRAP_BASE_READY once base is initialized */
+    profile_base_t base;
+  } profile_lock_t;
+
+  /* the underlying lock of a statically initialized lock is initialized by
+     its first user */
+#define PROFILE_LOCK_INITIALIZER { .base_ready = 0 }
+
+  static inline uint64_t
+  profile_ticks()
+  {
+    uint32_t hi, lo;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+  }
+
+  LOCK_IN_WRAP_BASE_ENSURE(profile)
+
+  static inline int
+  profile_lock_init(profile_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->base_ready = LOCK_IN_WRAP_BASE_READY;
+    return profile_base_init(&l->base);
+  }
+
+  static inline int
+  profile_lock_destroy(profile_lock_t* l)
+  {
+    if (l->base_ready == LOCK_IN_WRAP_BASE_READY)
+      {
+	return profile_base_destroy(&l->base);
+      }
+    return 0;
+  }
+
+  static inline int
+  profile_sampled()
+  {
+    return __builtin_expect((++lock_in_prof_tick & (LOCK_IN_PROF_SAMPLE - 1)) == 0, 0);
+  }
+
+  /* records the wait of a sampled acquisition and starts its hold time */
+  static inline void
+  profile_acquired(profile_lock_t* l, const lock_in_prof_site_t* site, const uint64_t start)
+  {
+    const uint64_t now = profile_ticks();
+    lock_in_prof_entry_t* e = lock_in_prof_entry(l, site);
+    if (e == NULL)
+      {
+	return;
+      }
+    const uint64_t wait = now - start;
+    e->n_wait++;
+    e->wait_sum += wait;
+    e->wait_hist[lock_in_prof_bucket(wait)]++;
+
+    uint32_t h = lock_in_prof_n_held;
+    if (h == LOCK_IN_PROF_MAX_HELD)	/* drop the oldest */
+      {
+	int i;
+	for (i = 1; i < LOCK_IN_PROF_MAX_HELD; i++)
+	  {
+	    lock_in_prof_held[i - 1] = lock_in_prof_held[i];
+	  }
+	h--;
+      }
+    lock_in_prof_held[h].lock = l;
+    lock_in_prof_held[h].e = e;
+    lock_in_prof_held[h].start = now;
+    lock_in_prof_n_held = h + 1;
+  }
+
+  /* returns the hold record of l (or NULL) and removes it */
+  static inline lock_in_prof_held_t*
+  profile_held_remove(profile_lock_t* l, lock_in_prof_held_t* out)
+  {
+    int h;
+    for (h = (int) lock_in_prof_n_held - 1; h >= 0; h--)
+      {
+	if (lock_in_prof_held[h].lock == l)
+	  {
+	    *out = lock_in_prof_held[h];
+	    uint32_t i;
+	    for (i = h + 1; i < lock_in_prof_n_held; i++)
+	      {
+		lock_in_prof_held[i - 1] = lock_in_prof_held[i];
+	      }
+	    lock_in_prof_n_held--;
+	    return out;
+	  }
+      }
+    return NULL;
+  }
+
+  static inline int
+  profile_lock_lock(profile_lock_t* l, const lock_in_prof_site_t* site)
+  {
+    profile_base_ensure(l);
+    if (!profile_sampled())
+      {
+	return profile_base_lock(&l->base);
+      }
+    const uint64_t start = profile_ticks();
+    const int ret = profile_base_lock(&l->base);
+    profile_acquired(l, site, start);
+    return ret;
+  }
+
+  static inline int
+  profile_lock_timedlock(profile_lock_t* l, const struct timespec* ts, const lock_in_prof_site_t* site)
+  {
+    profile_base_ensure(l);
+    if (!profile_sampled())
+      {
+	return profile_base_timedlock(&l->base, ts);
+      }
+    const uint64_t start = profile_ticks();
+    const int ret = profile_base_timedlock(&l->base, ts);
+    if (ret == 0)
+      {
+	profile_acquired(l, site, start);
+      }
+    return ret;
+  }
+
+  static inline int
+  profile_lock_trylock(profile_lock_t* l, const lock_in_prof_site_t* site)
+  {
+    profile_base_ensure(l);
+    const int ret = profile_base_trylock(&l->base);
+    if (ret == 0 && profile_sampled())
+      {
+	profile_acquired(l, site, profile_ticks());
+      }
+    return ret;
+  }
+
+  static inline int
+  profile_lock_unlock(profile_lock_t* l)
+  {
+    lock_in_prof_held_t hr;
+    if (__builtin_expect(lock_in_prof_n_held != 0, 0) && profile_held_remove(l, &hr) != NULL)
+      {
+	const uint64_t hold = profile_ticks() - hr.start;
+	hr.e->n_hold++;
+	hr.e->hold_sum += hold;
+	hr.e->hold_hist[lock_in_prof_bucket(hold)]++;
+      }
+    return profile_base_unlock(&l->base);
+  }
+
+  /* the hold time of a sampled acquisition stops at a condition wait */
+  static inline int
+  profile_cond_wait(pthread_cond_t* c, profile_lock_t* l)
+  {
+    lock_in_prof_held_t hr;
+    if (lock_in_prof_n_held != 0)
+      {
+	profile_held_remove(l, &hr);
+      }
+    return profile_base_cond_wait(c, &l->base);
+  }
+
+  static inline int
+  profile_cond_timedwait(pthread_cond_t* c, profile_lock_t* l, const struct timespec* ts)
+  {
+    lock_in_prof_held_t hr;
+    if (lock_in_prof_n_held != 0)
+      {
+	profile_held_remove(l, &hr);
+      }
+    return profile_base_cond_timedwait(c, &l->base, ts);
+  }
+
+#define PROFILE_SITE()							\
+  ({									\
+    static const lock_in_prof_site_t __lock_in_prof_site =		\
+      { .file = __FILE__, .func = __func__, .line = __LINE__ };		\
+    &__lock_in_prof_site;						\
+  })
+
+#undef  LOCK_IN_WRAP
+#undef  LOCK_IN_WRAP_INITIALIZER
+#define LOCK_IN_WRAP             profile
+#define LOCK_IN_WRAP_INITIALIZER PROFILE_LOCK_INITIALIZER
+#define LOCK_IN_WRAP_REDIRECT
+#include "wrap_in.h"
+/* with the call site */
+#if REPLACE_MUTEX == 1
+#  undef  pthread_mutex_lock
+#  undef  pthread_mutex_timedlock
+#  undef  pthread_mutex_trylock
+#  define pthread_mutex_lock(l) profile_lock_lock((l), PROFILE_SITE())
+#  define pthread_mutex_timedlock(l, ts) profile_lock_timedlock((l), (ts), PROFILE_SITE())
+#  define pthread_mutex_trylock(l) profile_lock_trylock((l), PROFILE_SITE())
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _PROFILE_IN_H_ */
@@ -0,0 +1,264 @@
+/*
+ * File: stats_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Always-on, sampled per-lock statistics on top of any LOCK_IN algorithm
+ *      (LOCK_IN_STATS=1), published through shared memory (see lock_in_stats.h
+ *      and lockin-stat).
+ *
+ *      One out of every LOCK_IN_STATS_SAMPLE acquisitions of each thread is
+ *      sampled: it measures the wait (contended if longer than
+ *      LOCK_IN_STATS_CONTENDED cycles) and the hold time, the futex waits of the
+ *      acquire, and the GLK mode of the lock, and updates the slot of the lock
+ *      while holding it. The other acquisitions only increment a thread-local
+ *      counter.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _STATS_IN_H_
+#define _STATS_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lock_in_stats.h"
+#include "wrap_in.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error stats_in.h is included by lock_in.h (with LOCK_IN_STATS=1)
+#endif
+#if LOCK_IN == GLS
+#  error LOCK_IN_STATS does not support GLS
+#endif
+
+#if LOCK_IN == GLK && LOCK_IN_BIASED == 0 && LOCK_IN_GCR == 0
+#  define STATS_IN_MODE(b)        ((uint32_t) (b)->lock_type)
+#else
+#  define STATS_IN_MODE(b)        0
+#endif
+
+  LOCK_IN_WRAP_BASE(stats)
+
+  typedef struct stats_lock
+  {
+    lock_in_stats_slot_t* volatile slot;
+    volatile uint32_t base_ready;	/* LOCK_IN_WRAP_BASE_READY once base is initialized */
+    stats_base_t base;
+  } stats_lock_t;
+
+  /* the underlying lock of a statically initialized lock is set up by its
+     first user; the slot of any lock by its first sampled acquire */
+#define STATS_LOCK_INITIALIZER { .slot = NULL, .base_ready = 0 }
+/* the slot of a lock that did not get one (not sampled) */
+#define STATS_NO_SLOT ((lock_in_stats_slot_t*) 1)
+
+  static __thread uint32_t stats_in_tick = 0;
+  static __thread stats_lock_t* stats_in_held = NULL; /* the sampled lock held */
+  static __thread uint64_t stats_in_held_start = 0;
+
+  static inline uint64_t
+  stats_in_ticks()
+  {
+    uint32_t hi, lo;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t) hi << 32) | lo;
+  }
+
+  static inline void
+  stats_in_futex_waits(size_t* n_wait)
+  {
+#if defined(LOCK_IN_FUTEX_STATS)
+    size_t n_wake;
+    LOCK_IN_FUTEX_STATS(n_wait, &n_wake);
+    (void) n_wake;
+#else
+    *n_wait = 0;
+#endif
+  }
+
+  LOCK_IN_WRAP_BASE_ENSURE(stats)
+
+  /* returns the slot of the lock, or NULL if it did not get one */
+  static inline lock_in_stats_slot_t*
+  stats_slot(stats_lock_t* l)
+  {
+    lock_in_stats_slot_t* s = l->slot;
+    if (__builtin_expect(s != NULL, 1))
+      {
+	return (s == STATS_NO_SLOT) ? NULL : s;
+      }
+    s = lock_in_stats_register(l, LOCK_IN_NAME);
+    lock_in_stats_slot_t* o = __sync_val_compare_and_swap(&l->slot, NULL, 
+							  (s == NULL) ? STATS_NO_SLOT : s);
+    if (o != NULL)
+      {
+	lock_in_stats_unregister(s);
+	return (o == STATS_NO_SLOT) ? NULL : o;
+      }
+    return s;
+  }
+
+  static inline int
+  stats_lock_init(stats_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->slot = NULL;
+    l->base_ready = LOCK_IN_WRAP_BASE_READY;
+    return stats_base_init(&l->base);
+  }
+
+  static inline int
+  stats_lock_destroy(stats_lock_t* l)
+  {
+    if (l->slot != NULL)
+      {
+	if (l->slot != STATS_NO_SLOT)
+	  {
+	    lock_in_stats_unregister(l->slot);
+	  }
+	l->slot = NULL;
+      }
+    if (l->base_ready == LOCK_IN_WRAP_BASE_READY)
+      {
+	return stats_base_destroy(&l->base);
+      }
+    return 0;
+  }
+
+  /* called with the lock held, after a sampled acquire; a lock without a
+     slot is not sampled (nor is its hold time, in stats_lock_unlock) */
+  static inline void
+  stats_in_acquired(stats_lock_t* l, const uint64_t start, const size_t n_wait)
+  {
+    const uint64_t now = stats_in_ticks();
+    size_t n_wait_now;
+    stats_in_futex_waits(&n_wait_now);
+
+    lock_in_stats_slot_t* s = stats_slot(l);
+    if (s == NULL)
+      {
+	return;
+      }
+    const uint64_t wait = now - start;
+    s->n_acq++;
+    if (wait > LOCK_IN_STATS_CONTENDED)
+      {
+	s->n_contended++;
+      }
+    s->n_futex_wait += n_wait_now - n_wait;
+    s->wait_ewma += ((int64_t) (wait - s->wait_ewma)) >> LOCK_IN_STATS_EWMA_SHIFT;
+    const uint32_t mode = STATS_IN_MODE(&l->base);
+    if (mode != s->mode)
+      {
+	if (s->n_acq > 1)
+	  {
+	    s->n_mode_switch++;
+	  }
+	s->mode = mode;
+      }
+
+    stats_in_held = l;
+    stats_in_held_start = now;
+  }
+
+  static inline int
+  stats_lock_lock(stats_lock_t* l)
+  {
+    stats_base_ensure(l);
+    if (__builtin_expect((++stats_in_tick & (LOCK_IN_STATS_SAMPLE - 1)) != 0, 1))
+      {
+	return stats_base_lock(&l->base);
+      }
+
+    size_t n_wait;
+    stats_in_futex_waits(&n_wait);
+    const uint64_t start = stats_in_ticks();
+    const int ret = stats_base_lock(&l->base);
+    stats_in_acquired(l, start, n_wait);
+    return ret;
+  }
+
+  static inline int
+  stats_lock_timedlock(stats_lock_t* l, const struct timespec* ts)
+  {
+    stats_base_ensure(l);
+    return stats_base_timedlock(&l->base, ts);
+  }
+
+  static inline int
+  stats_lock_trylock(stats_lock_t* l)
+  {
+    stats_base_ensure(l);
+    return stats_base_trylock(&l->base);
+  }
+
+  static inline int
+  stats_lock_unlock(stats_lock_t* l)
+  {
+    /* stats_in_held is only set for a lock with a slot */
+    if (__builtin_expect(stats_in_held == l, 0))
+      {
+	lock_in_stats_slot_t* s = l->slot;
+	const uint64_t hold = stats_in_ticks() - stats_in_held_start;
+	s->hold_ewma += ((int64_t) (hold - s->hold_ewma)) >> LOCK_IN_STATS_EWMA_SHIFT;
+	stats_in_held = NULL;
+      }
+    return stats_base_unlock(&l->base);
+  }
+
+  static inline int
+  stats_cond_wait(pthread_cond_t* c, stats_lock_t* l)
+  {
+    if (stats_in_held == l)
+      {
+	stats_in_held = NULL;
+      }
+    return stats_base_cond_wait(c, &l->base);
+  }
+
+  static inline int
+  stats_cond_timedwait(pthread_cond_t* c, stats_lock_t* l, const struct timespec* ts)
+  {
+    if (stats_in_held == l)
+      {
+	stats_in_held = NULL;
+      }
+    return stats_base_cond_timedwait(c, &l->base, ts);
+  }
+
+#undef  LOCK_IN_WRAP
+#undef  LOCK_IN_WRAP_INITIALIZER
+#define LOCK_IN_WRAP             stats
+#define LOCK_IN_WRAP_INITIALIZER STATS_LOCK_INITIALIZER
+#define LOCK_IN_WRAP_REDIRECT
+#include "wrap_in.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _STATS_IN_H_ */
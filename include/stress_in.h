@@ -0,0 +1,171 @@
+/*
+ * File: stress_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The module interfaces of the stress_in benchmark driver (bmarks/stress_in.c).
+ *
+ *      A run is composed of workload modules, which decide what the threads do:
+ *        select  which lock an acquisition picks        (--select=uniform)
+ *        cs      the critical section                   (--cs=pause:1000)
+ *        think   the work between a release and the next acquisition (--think=exp:500)
+ *        phase   a schedule that changes the cs/think scale and the number of
+ *                active threads during the run          (--phase=steps:..., ramp:...)
+ *      and of measurement modules (--measure=thr,lat,fair,energy,adapt,...), which see
+ *      the run start/stop, the threads start/stop, every acquisition, and, if they
+ *      set a sampling period, periodic samples by the main thread.
+ *
+ *      A module is a struct of callbacks in one of the tables of stress_in_workload.h
+ *      or stress_in_measure.h: adding a scenario means adding a module there.
+ *      The modules are called through function pointers, which costs the same for
+ *      every lock algorithm (the lock calls themselves are direct).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _STRESS_IN_H_
+#define _STRESS_IN_H_
+
+#include <pthread.h>
+#include "utils.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error include lock_in.h before stress_in.h
+#endif
+
+#define STRESS_MAX_MEASURES 8
+
+typedef struct stress_thread
+{
+  union
+  {
+    struct
+    {
+      int id;
+      unsigned long* seeds;
+      size_t num_acquires;
+    };
+    char padding[CACHE_LINE_SIZE];
+  };
+} stress_thread_t;
+
+typedef struct stress
+{
+  int num_threads;
+  int num_locks;
+  int duration;			/* ms; the measured duration after the run */
+  pthread_mutex_t* locks;
+  stress_thread_t* threads;
+  volatile int stop;
+  /* set by the phase schedule */
+  volatile double cs_scale;
+  volatile double think_scale;
+  volatile int active_threads;
+  int num_phases;		/* the steps of the schedule (1 without one) */
+  volatile int phase;		/* the current step, in [0, num_phases) */
+  /* set by the measurement modules to get sample callbacks every sample_ms
+     (the smallest period that a module asks for, see stress_sample_every) */
+  int sample_ms;
+} stress_t;
+
+/* a module spec is "name" or "name:args"; init returns 0 on success */
+typedef struct stress_select
+{
+  const char* name;
+  const char* help;
+  int (*init)(stress_t* s, const char* args);
+  size_t (*next)(stress_thread_t* t);
+} stress_select_t;
+
+typedef struct stress_cs
+{
+  const char* name;
+  const char* help;
+  int (*init)(stress_t* s, const char* args);
+  void (*run)(stress_thread_t* t, size_t lock);
+  void (*report)(stress_t* s);	/* can be NULL */
+  /* if not NULL, replaces select, lock, run, and unlock: an operation that
+     locks by itself (e.g., on a data structure), timed as an acquisition */
+  void (*op)(stress_thread_t* t);
+  void (*stop)(stress_t* s);	/* can be NULL; main thread, after stop is set */
+} stress_cs_t;
+
+typedef struct stress_think
+{
+  const char* name;
+  const char* help;
+  int (*init)(stress_t* s, const char* args);
+  void (*run)(stress_thread_t* t);
+} stress_think_t;
+
+typedef struct stress_phase
+{
+  const char* name;
+  const char* help;
+  int (*init)(stress_t* s, const char* args);
+  /* init sets num_phases (and can raise num_threads); update is called by
+     the main thread at ms into the run: applies the phase of that time and
+     returns the ms until the next change */
+  int (*update)(stress_t* s, int ms);
+} stress_phase_t;
+
+/* any of the callbacks can be NULL */
+typedef struct stress_measure
+{
+  const char* name;
+  const char* help;
+  int needs_latency;		/* acquired is given the lock latency in cycles */
+  int (*init)(stress_t* s, const char* args);
+  void (*start)(stress_t* s);	/* main thread, right before / after the run */
+  void (*stop)(stress_t* s);
+  void (*thread_start)(stress_thread_t* t); /* right before / after the timed loop */
+  void (*acquired)(stress_thread_t* t, ticks latency);
+  void (*thread_stop)(stress_thread_t* t);
+  void (*report)(stress_t* s);
+  void (*sample)(stress_t* s, int ms); /* main thread, every s->sample_ms */
+} stress_measure_t;
+
+static inline void
+stress_sample_every(stress_t* s, int ms)
+{
+  if (s->sample_ms == 0 || ms < s->sample_ms)
+    {
+      s->sample_ms = ms;
+    }
+}
+
+/* uniform in [0, n), w/o a division */
+static inline size_t
+stress_rand_n(stress_thread_t* t, size_t n)
+{
+  const uint64_t r = my_random(&(t->seeds[0]),&(t->seeds[1]),&(t->seeds[2])) & 0xffffffff;
+  return (size_t) ((r * n) >> 32);
+}
+
+/* uniform in [0, 1) */
+static inline double
+stress_rand_01(stress_thread_t* t)
+{
+  return (my_random(&(t->seeds[0]),&(t->seeds[1]),&(t->seeds[2])) & 0xffffffff) / 4294967296.0;
+}
+
+#endif	/* _STRESS_IN_H_ */
@@ -0,0 +1,723 @@
+/*
+ * File: stress_in_measure.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The measurement modules of the stress_in driver (see stress_in.h):
+ *      throughput, lock latency histograms, fairness, energy (RAPL), hardware
+ *      counters (perf_event_open), the convergence of the adaptive locks
+ *      (GLK, MUTEXEE) after load changes, and, for oversubscription, per-phase
+ *      results, CPU hogs, and the GLK multiprogramming mode.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _STRESS_IN_MEASURE_H_
+#define _STRESS_IN_MEASURE_H_
+
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include "rapl_read.h"
+#include "cdf.h"
+#include "perf_in.h"
+#include "stress_in.h"
+
+static size_t
+measure_acquires(stress_t* s)
+{
+  size_t acquires = 0;
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      acquires += s->threads[i].num_acquires;
+    }
+  return acquires;
+}
+
+/* ******************************************************************************** */
+/* thr **************************************************************************** */
+
+static void
+thr_report(stress_t* s)
+{
+  const size_t acquires = measure_acquires(s);
+  printf("#acquires     : %10zu ( %10.0f / s)\n", acquires, acquires * 1000.0 / s->duration);
+}
+
+/* ******************************************************************************** */
+/* lat **************************************************************************** */
+
+static cdf_hist_t** lat_hists;
+
+static int
+lat_init(stress_t* s, const char* args)
+{
+  lat_hists = (cdf_hist_t**) calloc(s->num_threads, sizeof(cdf_hist_t*));
+  return (lat_hists == NULL);
+}
+
+static void
+lat_thread_start(stress_thread_t* t)
+{
+  lat_hists[t->id] = cdf_hist_new();
+}
+
+static void
+lat_acquired(stress_thread_t* t, ticks latency)
+{
+  cdf_hist_add(lat_hists[t->id], latency);
+}
+
+static void
+lat_report(stress_t* s)
+{
+  cdf_hist_t* h = cdf_hist_new();
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      cdf_hist_merge(h, lat_hists[i]);
+      cdf_hist_destroy(lat_hists[i]);
+    }
+  printf("#lock latency : p50 %zu p90 %zu p99 %zu p99.9 %zu max %zu avg %.0f (cycles)\n",
+	 cdf_hist_percentile(h, 50), cdf_hist_percentile(h, 90),
+	 cdf_hist_percentile(h, 99), cdf_hist_percentile(h, 99.9),
+	 h->max, h->n ? (double) h->sum / h->n : 0.0);
+  cdf_hist_destroy(h);
+}
+
+/* ******************************************************************************** */
+/* fair *************************************************************************** */
+
+static void
+fair_report(stress_t* s)
+{
+  double sum = 0, sum_sq = 0;
+  size_t min = -1, max = 0;
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      const size_t a = s->threads[i].num_acquires;
+      sum += a;
+      sum_sq += (double) a * a;
+      min = (a < min) ? a : min;
+      max = (a > max) ? a : max;
+    }
+  /* Jain's index: 1 when all the threads acquire equally, 1/n at worst */
+  const double jain = (sum_sq > 0) ? (sum * sum) / (s->num_threads * sum_sq) : 1.0;
+  printf("#fairness     : jain %.3f ( max/min %.2f)\n", jain, min ? (double) max / min : INFINITY);
+}
+
+/* ******************************************************************************** */
+/* energy ************************************************************************* */
+
+static int
+energy_init(stress_t* s, const char* args)
+{
+  RR_INIT_ALL();
+  return 0;
+}
+
+static void
+energy_start(stress_t* s)
+{
+  RR_START_UNPROTECTED_ALL();
+}
+
+static void
+energy_stop(stress_t* s)
+{
+  RR_STOP_UNPROTECTED_ALL();
+}
+
+static void
+energy_report(stress_t* s)
+{
+  RR_PRINT_UNPROTECTED(RAPL_PRINT_ENE);
+#if RAPL_READ_ENABLE == 1
+  const size_t acquires = measure_acquires(s);
+  const double thr = acquires * 1000.0 / s->duration;
+  rapl_stats_t r;
+  RR_STATS(&r);
+  printf("#ppw (ops/W)  : %10.1f | %10.1f | %10.1f\n", thr / r.power_total[NUMBER_OF_SOCKETS],
+	 thr / r.power_package[NUMBER_OF_SOCKETS], thr / r.power_pp0[NUMBER_OF_SOCKETS]);
+  printf("#eop (uJ/op)  : %10f | %10f | %10f\n", (1e6 * r.energy_total[NUMBER_OF_SOCKETS]) / acquires,
+	 (1e6 * r.energy_package[NUMBER_OF_SOCKETS]) / acquires, (1e6 * r.energy_pp0[NUMBER_OF_SOCKETS]) / acquires);
+#else
+  printf("#energy       : not measured (built with POWER=0)\n");
+#endif
+}
+
+/* ******************************************************************************** */
+/* perf *************************************************************************** */
+
+static perf_in_t* perf_threads;
+
+static int
+perf_init(stress_t* s, const char* args)
+{
+  perf_in_init();
+  perf_threads = (perf_in_t*) calloc(s->num_threads, sizeof(perf_in_t));
+  return (perf_threads == NULL);
+}
+
+static void
+perf_thread_start(stress_thread_t* t)
+{
+  perf_in_start(perf_threads + t->id);
+}
+
+static void
+perf_thread_stop(stress_thread_t* t)
+{
+  perf_in_stop(perf_threads + t->id);
+}
+
+static void
+perf_report(stress_t* s)
+{
+  perf_in_t total;
+  memset(&total, 0, sizeof(total));
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      perf_in_merge(&total, perf_threads + i);
+    }
+  perf_in_report(&total, measure_acquires(s));
+  free(perf_threads);
+}
+
+/* ******************************************************************************** */
+/* adapt ************************************************************************** */
+
+/* Every ADAPT window, the throughput of the window and the mode that the lock
+   (lock 0) has chosen: the lock type for GLK, spinning or futex (and the spin
+   budget) for MUTEXEE. A phase is a run of windows with the same cs/think
+   scales and active threads (see --phase). Per phase it reports the mode
+   switches, the flip-flops (switches that revert the previous one), the time
+   after which the mode does not change anymore, and the time after which the
+   throughput stays within TOL% of the mean of the second half of the phase */
+
+#if LOCK_IN_BIASED == 1 || LOCK_IN_GCR == 1 || LOCK_IN_STATS == 1 || \
+  LOCK_IN_PROFILE == 1 || LOCK_IN_TRACE == 1 /* the wrappers hide the lock */
+#  define ADAPT_MODE(l)  0
+#  define ADAPT_PARAM(l) 0
+static const char* adapt_mode_names[] = { "-" };
+#elif LOCK_IN == GLK
+#  define ADAPT_MODE(l)  ((l)->lock_type)
+#  define ADAPT_PARAM(l) 0
+static const char* adapt_mode_names[] = { "-", "TICKET", "MCS", "MUTEX" };
+#elif LOCK_IN == MUTEXEE || LOCK_IN == MUTEXEEF || LOCK_IN == MUTEXEEO || LOCK_IN == MUTEXEEH
+#  define ADAPT_MODE(l)  ((l)->is_futex != 0)
+#  define ADAPT_PARAM(l) ((l)->n_spins)
+static const char* adapt_mode_names[] = { "SPIN", "FUTEX" };
+#else
+#  define ADAPT_MODE(l)  0
+#  define ADAPT_PARAM(l) 0
+static const char* adapt_mode_names[] = { "-" };
+#endif
+
+#define ADAPT_WINDOW_MS 10
+#define ADAPT_TOL       10
+
+typedef struct adapt_window
+{
+  int ms;			/* end of the window */
+  double thr;			/* acquires / s */
+  int mode;
+  unsigned int param;
+  int phase;
+} adapt_window_t;
+
+typedef struct adapt_counter
+{
+  union
+  {
+    volatile size_t n;
+    char padding[CACHE_LINE_SIZE];
+  };
+} adapt_counter_t;
+
+static adapt_counter_t* adapt_counters;
+static adapt_window_t* adapt_windows;
+static int adapt_num, adapt_size;
+static int adapt_window_ms, adapt_tol, adapt_timeline;
+static size_t adapt_last_n;
+static int adapt_last_ms;
+static int adapt_phase;
+static double adapt_cs_scale, adapt_think_scale;
+static int adapt_threads;
+
+static int
+adapt_init(stress_t* s, const char* args)
+{
+  int window = ADAPT_WINDOW_MS;
+  adapt_tol = ADAPT_TOL;
+  adapt_timeline = 0;
+  if (*args && sscanf(args, "%d:%d:%d", &window, &adapt_tol, &adapt_timeline) < 1)
+    {
+      return 1;
+    }
+  if (window <= 0 || adapt_tol <= 0)
+    {
+      return 1;
+    }
+  adapt_window_ms = window;
+  stress_sample_every(s, window);
+  adapt_counters = (adapt_counter_t*) calloc(s->num_threads, sizeof(adapt_counter_t));
+  adapt_size = 1024;
+  adapt_windows = (adapt_window_t*) malloc(adapt_size * sizeof(adapt_window_t));
+  return (adapt_counters == NULL || adapt_windows == NULL);
+}
+
+static void
+adapt_start(stress_t* s)
+{
+  adapt_cs_scale = s->cs_scale;
+  adapt_think_scale = s->think_scale;
+  adapt_threads = s->active_threads;
+}
+
+static void
+adapt_acquired(stress_thread_t* t, ticks latency)
+{
+  adapt_counters[t->id].n++;
+}
+
+static void
+adapt_sample(stress_t* s, int ms)
+{
+  if (ms - adapt_last_ms < adapt_window_ms)
+    {
+      return;
+    }
+  if (adapt_num == adapt_size)
+    {
+      adapt_size <<= 1;
+      adapt_windows = (adapt_window_t*) realloc(adapt_windows, adapt_size * sizeof(adapt_window_t));
+      assert(adapt_windows != NULL);
+    }
+
+  size_t n = 0;
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      n += adapt_counters[i].n;
+    }
+
+  /* the phase is applied before the main thread sleeps, so that the
+     window that just ended ran with the current cs/think/threads */
+  if (s->cs_scale != adapt_cs_scale || s->think_scale != adapt_think_scale ||
+      s->active_threads != adapt_threads)
+    {
+      adapt_cs_scale = s->cs_scale;
+      adapt_think_scale = s->think_scale;
+      adapt_threads = s->active_threads;
+      adapt_phase++;
+    }
+
+  adapt_window_t* w = adapt_windows + adapt_num++;
+  w->ms = ms;
+  w->thr = (n - adapt_last_n) * 1000.0 / (ms - adapt_last_ms);
+  w->mode = ADAPT_MODE(s->locks);
+  w->param = ADAPT_PARAM(s->locks);
+  w->phase = adapt_phase;
+  adapt_last_n = n;
+  adapt_last_ms = ms;
+}
+
+/* the windows [from, to) of one phase */
+static void
+adapt_report_phase(int from, int to, int* switches_total, int* flips_total,
+		   int* mode_conv_max, int* thr_conv_max)
+{
+  const int start_ms = (from > 0) ? adapt_windows[from - 1].ms : 0;
+  int switches = 0, flips = 0, mode_conv = 0, i;
+  int prev_mode = (from > 0) ? adapt_windows[from - 1].mode : adapt_windows[from].mode;
+  int left_mode = -1;		/* the mode before the last switch */
+  for (i = from; i < to; i++)
+    {
+      const int mode = adapt_windows[i].mode;
+      if (mode != prev_mode)
+	{
+	  switches++;
+	  flips += (mode == left_mode);
+	  left_mode = prev_mode;
+	  prev_mode = mode;
+	  mode_conv = ((i > 0) ? adapt_windows[i - 1].ms : 0) - start_ms;
+	}
+    }
+
+  double mean = 0;
+  const int half = from + (to - from) / 2;
+  for (i = half; i < to; i++)
+    {
+      mean += adapt_windows[i].thr;
+    }
+  mean /= (to - half);
+
+  int conv = to - 1;
+  while (conv >= from && fabs(adapt_windows[conv].thr - mean) <= mean * adapt_tol / 100.0)
+    {
+      conv--;
+    }
+  /* the first window of the last run of windows within the tolerance */
+  const int thr_conv = ((conv >= from) ? adapt_windows[conv].ms : start_ms) - start_ms;
+
+  printf("#adapt phase %-2d: %6d - %-6d ms | thr %10.0f / s | mode %-6s | switches %3d ( flip-flops %3d)"
+	 " | converged: mode %5d ms, thr %5d ms\n",
+	 adapt_windows[from].phase, start_ms, adapt_windows[to - 1].ms, mean,
+	 adapt_mode_names[adapt_windows[to - 1].mode], switches, flips, mode_conv, thr_conv);
+
+  *switches_total += switches;
+  *flips_total += flips;
+  *mode_conv_max = (mode_conv > *mode_conv_max) ? mode_conv : *mode_conv_max;
+  *thr_conv_max = (thr_conv > *thr_conv_max) ? thr_conv : *thr_conv_max;
+}
+
+static void
+adapt_report(stress_t* s)
+{
+  int i, from = 0;
+  if (adapt_timeline)
+    {
+      for (i = 0; i < adapt_num; i++)
+	{
+	  printf("#adapt window : %6d ms | phase %-2d | %10.0f / s | mode %-6s | param %u\n",
+		 adapt_windows[i].ms, adapt_windows[i].phase, adapt_windows[i].thr,
+		 adapt_mode_names[adapt_windows[i].mode], adapt_windows[i].param);
+	}
+    }
+
+  int switches = 0, flips = 0, mode_conv = 0, thr_conv = 0;
+  for (i = 1; i <= adapt_num; i++)
+    {
+      if (i == adapt_num || adapt_windows[i].phase != adapt_windows[from].phase)
+	{
+	  adapt_report_phase(from, i, &switches, &flips, &mode_conv, &thr_conv);
+	  from = i;
+	}
+    }
+  printf("#adapt        : switches %d ( flip-flops %d) | max converged: mode %d ms, thr %d ms"
+	 " (windows of %d ms, thr within %d%%)\n",
+	 switches, flips, mode_conv, thr_conv, adapt_window_ms, adapt_tol);
+
+  free(adapt_windows);
+  free(adapt_counters);
+}
+
+/* ******************************************************************************** */
+/* phases ************************************************************************* */
+
+/* Per step of the phase schedule (see --phase): the throughput, the lock
+   latency percentiles, and the runnable threads of the system, as
+   /proc/loadavg reports them (what the multiprogramming detection of GLK
+   reads). The main thread applies a phase before it sleeps, so the time
+   between two samples is charged to the current phase */
+
+#define PHASES_SAMPLE_MS 1
+
+typedef struct phases_stats
+{
+  int ms;
+  double runnable;		/* sum of the runnable threads samples */
+  int num_samples;
+} phases_stats_t;
+
+static stress_t* phases_s;
+static cdf_hist_t** phases_hists; /* [thread * num_phases + phase] */
+static phases_stats_t* phases_stats;
+static int phases_last_ms;
+
+/* the runnable threads of the system (without the caller), as GLK reads them */
+static int
+phases_runnable()
+{
+  float lavg[3];
+  int nr_running = 0, nr_tot, nr_what;
+  FILE* f = fopen("/proc/loadavg", "r");
+  if (f == NULL)
+    {
+      return -1;
+    }
+  if (fscanf(f, "%f %f %f %d/%d %d", &lavg[0], &lavg[1], &lavg[2], &nr_running, &nr_tot, &nr_what) != 6)
+    {
+      nr_running = 0;
+    }
+  fclose(f);
+  return nr_running - 1;
+}
+
+static int
+phases_init(stress_t* s, const char* args)
+{
+  phases_s = s;
+  stress_sample_every(s, PHASES_SAMPLE_MS);
+  phases_stats = (phases_stats_t*) calloc(s->num_phases, sizeof(phases_stats_t));
+  phases_hists = (cdf_hist_t**) calloc((size_t) s->num_threads * s->num_phases, sizeof(cdf_hist_t*));
+  int i;
+  for (i = 0; phases_hists != NULL && i < s->num_threads * s->num_phases; i++)
+    {
+      phases_hists[i] = cdf_hist_new();
+    }
+  return (phases_stats == NULL || phases_hists == NULL);
+}
+
+static void
+phases_acquired(stress_thread_t* t, ticks latency)
+{
+  cdf_hist_add(phases_hists[t->id * phases_s->num_phases + phases_s->phase], latency);
+}
+
+static void
+phases_sample(stress_t* s, int ms)
+{
+  phases_stats_t* ps = phases_stats + s->phase;
+  ps->ms += ms - phases_last_ms;
+  ps->runnable += phases_runnable();
+  ps->num_samples++;
+  phases_last_ms = ms;
+}
+
+static void
+phases_report(stress_t* s)
+{
+  int p, i;
+  for (p = 0; p < s->num_phases; p++)
+    {
+      const phases_stats_t* ps = phases_stats + p;
+      cdf_hist_t* h = cdf_hist_new();
+      for (i = 0; i < s->num_threads; i++)
+	{
+	  cdf_hist_merge(h, phases_hists[i * s->num_phases + p]);
+	  cdf_hist_destroy(phases_hists[i * s->num_phases + p]);
+	}
+      printf("#phase %-2d     : %6d ms | runnable %6.1f | %10.0f / s"
+	     " | p50 %zu p99 %zu p99.9 %zu max %zu (cycles)\n",
+	     p, ps->ms, ps->num_samples ? ps->runnable / ps->num_samples : 0.0,
+	     ps->ms ? h->n * 1000.0 / ps->ms : 0.0,
+	     cdf_hist_percentile(h, 50), cdf_hist_percentile(h, 99),
+	     cdf_hist_percentile(h, 99.9), h->max);
+      cdf_hist_destroy(h);
+    }
+  free(phases_hists);
+  free(phases_stats);
+}
+
+/* ******************************************************************************** */
+/* hog **************************************************************************** */
+
+/* hog[:X]: X CPU hogs per hardware context (default 1) next to the threads */
+
+static stress_t* hog_s;
+static pthread_t* hog_threads;
+static int hog_num;
+
+static int
+hog_init(stress_t* s, const char* args)
+{
+  const double ratio = (*args) ? atof(args) : 1;
+  hog_s = s;
+  hog_num = (int) ceil(ratio * sysconf(_SC_NPROCESSORS_ONLN));
+  hog_threads = (pthread_t*) malloc((hog_num + 1) * sizeof(pthread_t));
+  return (ratio < 0 || hog_threads == NULL);
+}
+
+/* background CPU load: never blocks */
+static void*
+hog_run(void* data)
+{
+  volatile size_t n = 0;
+  while (hog_s->stop == 0)
+    {
+      n++;
+    }
+  return NULL;
+}
+
+static void
+hog_start(stress_t* s)
+{
+  int i;
+  for (i = 0; i < hog_num; i++)
+    {
+      if (pthread_create(hog_threads + i, NULL, hog_run, NULL) != 0)
+	{
+	  fprintf(stderr, "Error creating thread\n");
+	  exit(1);
+	}
+    }
+}
+
+static void
+hog_stop(stress_t* s)
+{
+  int i;
+  for (i = 0; i < hog_num; i++)
+    {
+      pthread_join(hog_threads[i], NULL);
+    }
+}
+
+static void
+hog_report(stress_t* s)
+{
+  printf("#hogs         : %d\n", hog_num);
+  free(hog_threads);
+}
+
+/* ******************************************************************************** */
+/* glk **************************************************************************** */
+
+/* glk[:1]: with GLK, samples every ms the multiprogramming mode and the lock
+   type of the locks; reports per phase the time in multiprogramming mode
+   and the switches (:1 also prints every switch) */
+
+#if LOCK_IN == GLK && LOCK_IN_BIASED != 1 && LOCK_IN_GCR != 1 && LOCK_IN_STATS != 1 && \
+  LOCK_IN_PROFILE != 1 && LOCK_IN_TRACE != 1
+#  define STRESS_GLK 1
+static const char* glk_mode_type_names[] = { "-", "TICKET", "MCS", "MUTEX" };
+#else
+#  define STRESS_GLK 0
+#endif
+
+#define GLK_SAMPLE_MS 1
+
+typedef struct glk_mode_stats
+{
+  int mp_switches;		/* into or out of multiprogramming */
+  int type_switches;		/* lock type changes */
+  int mp_samples;		/* samples in multiprogramming mode */
+  int num_samples;
+} glk_mode_stats_t;
+
+static glk_mode_stats_t* glk_mode_stats;
+static int glk_mode_verbose;
+#if STRESS_GLK == 1
+static int glk_mode_mp;
+static int* glk_mode_types;
+#endif
+
+static int
+glk_mode_init(stress_t* s, const char* args)
+{
+  glk_mode_verbose = atoi(args);
+  stress_sample_every(s, GLK_SAMPLE_MS);
+  glk_mode_stats = (glk_mode_stats_t*) calloc(s->num_phases, sizeof(glk_mode_stats_t));
+  return (glk_mode_stats == NULL);
+}
+
+static void
+glk_mode_start(stress_t* s)
+{
+#if STRESS_GLK == 1
+  glk_mode_mp = gls_is_multiprogramming();
+  glk_mode_types = (int*) malloc(s->num_locks * sizeof(int));
+  int l;
+  for (l = 0; l < s->num_locks; l++)
+    {
+      glk_mode_types[l] = s->locks[l].lock_type;
+    }
+#endif
+}
+
+static void
+glk_mode_sample(stress_t* s, int ms)
+{
+#if STRESS_GLK == 1
+  glk_mode_stats_t* gs = glk_mode_stats + s->phase;
+  const int mp = gls_is_multiprogramming();
+  if (mp != glk_mode_mp)
+    {
+      if (glk_mode_verbose)
+	{
+	  printf("#glk switch   : %6d ms | phase %d | multiprogramming %d -> %d\n", ms, s->phase, glk_mode_mp, mp);
+	}
+      glk_mode_mp = mp;
+      gs->mp_switches++;
+    }
+  gs->mp_samples += mp;
+  gs->num_samples++;
+
+  int l;
+  for (l = 0; l < s->num_locks; l++)
+    {
+      const int type = s->locks[l].lock_type;
+      if (type != glk_mode_types[l])
+	{
+	  if (glk_mode_verbose)
+	    {
+	      printf("#glk switch   : %6d ms | phase %d | lock %d %s -> %s\n",
+		     ms, s->phase, l, glk_mode_type_names[glk_mode_types[l]], glk_mode_type_names[type]);
+	    }
+	  glk_mode_types[l] = type;
+	  gs->type_switches++;
+	}
+    }
+#endif
+}
+
+static void
+glk_mode_report(stress_t* s)
+{
+#if STRESS_GLK == 1
+  int p;
+  for (p = 0; p < s->num_phases; p++)
+    {
+      const glk_mode_stats_t* gs = glk_mode_stats + p;
+      printf("#glk phase %-2d : mp %3.0f%% ( %d switches) | type switches %d\n", p,
+	     gs->num_samples ? 100.0 * gs->mp_samples / gs->num_samples : 0.0,
+	     gs->mp_switches, gs->type_switches);
+    }
+  free(glk_mode_types);
+#else
+  printf("#glk          : not measured (not a GLK build)\n");
+#endif
+  free(glk_mode_stats);
+}
+
+static const stress_measure_t stress_measures[] =
+  {
+    { "thr", "throughput (acquisitions per second)", 0,
+      NULL, NULL, NULL, NULL, NULL, NULL, thr_report },
+    { "lat", "lock latency percentiles (cycles)", 1,
+      lat_init, NULL, NULL, lat_thread_start, lat_acquired, NULL, lat_report },
+    { "fair", "fairness of the acquisitions across the threads", 0,
+      NULL, NULL, NULL, NULL, NULL, NULL, fair_report },
+    { "energy", "energy per acquisition and throughput per Watt (RAPL)", 0,
+      energy_init, energy_start, energy_stop, NULL, NULL, NULL, energy_report },
+    { "perf", "hardware counters per acquire (perf_event_open, see perf_in.h)", 0,
+      perf_init, NULL, NULL, perf_thread_start, NULL, perf_thread_stop, perf_report },
+    { "adapt", "adapt[:WINDOW_MS[:TOL[:1]]]  per-window throughput and lock mode (GLK, MUTEXEE),\n"
+      "                   convergence and flip-flops per phase (:1 prints the windows)", 0,
+      adapt_init, adapt_start, NULL, NULL, adapt_acquired, NULL, adapt_report, adapt_sample },
+    { "phases", "per phase (see --phase) throughput, lock latency percentiles, and runnable threads", 1,
+      phases_init, NULL, NULL, NULL, phases_acquired, NULL, phases_report, phases_sample },
+    { "hog", "hog[:X]  X CPU hogs per hardware context (default 1) next to the threads", 0,
+      hog_init, hog_start, hog_stop, NULL, NULL, NULL, hog_report },
+    { "glk", "glk[:1]  GLK multiprogramming mode and lock type switches per phase (:1 prints them)", 0,
+      glk_mode_init, glk_mode_start, NULL, NULL, NULL, NULL, glk_mode_report, glk_mode_sample },
+  };
+
+#endif	/* _STRESS_IN_MEASURE_H_ */
@@ -0,0 +1,946 @@
+/*
+ * File: stress_in_workload.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The workload modules of the stress_in driver (see stress_in.h): lock
+ *      selection, critical sections (or data structure operations, see
+ *      ds_in.h, and condition variable scenarios), think times, and phase
+ *      schedules.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _STRESS_IN_WORKLOAD_H_
+#define _STRESS_IN_WORKLOAD_H_
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "cdf.h"
+#include "dist.h"
+#include "ds_in.h"
+#include "stress_in.h"
+
+/* ******************************************************************************** */
+/* select ************************************************************************* */
+
+/* the samplers of dist.h */
+static dist_t* select_dist;
+
+static int
+select_dist_init(stress_t* s, const char* kind, const char* args)
+{
+  char spec[64];
+  snprintf(spec, sizeof(spec), "%s%s%s", kind, args[0] ? ":" : "", args);
+  select_dist = dist_new(spec, s->num_locks);
+  return (select_dist == NULL);
+}
+
+static int
+select_uniform_init(stress_t* s, const char* args)
+{
+  return select_dist_init(s, "uniform", args);
+}
+
+static int
+select_zipf_init(stress_t* s, const char* args)
+{
+  return select_dist_init(s, "zipf", args);
+}
+
+static int
+select_hotspot_init(stress_t* s, const char* args)
+{
+  return select_dist_init(s, "hotspot", args);
+}
+
+static size_t
+select_dist_next(stress_thread_t* t)
+{
+  return dist_next(select_dist, t->seeds);
+}
+
+static const stress_select_t stress_selects[] =
+  {
+    { "uniform", "uniform over the locks", select_uniform_init, select_dist_next },
+    { "zipf", "zipf:S   Zipf with exponent S (lock 0 the hottest)", select_zipf_init, select_dist_next },
+    { "hotspot", "hotspot:F:P  a fraction F of the locks gets a fraction P of the acquisitions",
+      select_hotspot_init, select_dist_next },
+  };
+
+/* ******************************************************************************** */
+/* cs ***************************************************************************** */
+
+static stress_t* cs_s;
+static double cs_cycles;
+
+typedef struct cs_data
+{
+  volatile char the_data[CACHE_LINE_SIZE];
+} cs_data_t;
+
+static cs_data_t* cs_lines;
+static int cs_num_lines;
+static int cs_writes;
+
+static int
+cs_pause_init(stress_t* s, const char* args)
+{
+  cs_s = s;
+  cs_cycles = atof(args);
+  return (cs_cycles < 0);
+}
+
+static void
+cs_pause_run(stress_thread_t* t, size_t lock)
+{
+  const ticks c = cs_cycles * cs_s->cs_scale;
+  if (c > 0)
+    {
+      cpause(c);
+    }
+}
+
+/* cl:N[:w]: N cache lines per lock, read or (w) written in the cs */
+static int
+cs_cl_init(stress_t* s, const char* args)
+{
+  cs_s = s;
+  cs_num_lines = atoi(args);
+  const char* w = strchr(args, ':');
+  cs_writes = (w != NULL && w[1] == 'w');
+  if (cs_num_lines <= 0)
+    {
+      return 1;
+    }
+  cs_lines = (cs_data_t*) calloc((size_t) s->num_locks * cs_num_lines, sizeof(cs_data_t));
+  return (cs_lines == NULL);
+}
+
+static void
+cs_cl_run(stress_thread_t* t, size_t lock)
+{
+  volatile cs_data_t* d = cs_lines + lock * cs_num_lines;
+  int i;
+  if (cs_writes)
+    {
+      for (i = 0; i < cs_num_lines; i++)
+	{
+	  d[i].the_data[0] += t->id;
+	}
+    }
+  else
+    {
+      UNUSED char sum = 0;
+      for (i = 0; i < cs_num_lines; i++)
+	{
+	  sum += d[i].the_data[0];
+	}
+    }
+}
+
+/* inc: increments a per-lock counter, and checks the totals at the end */
+static size_t* cs_counters;
+
+static int
+cs_inc_init(stress_t* s, const char* args)
+{
+  cs_s = s;
+  cs_counters = (size_t*) calloc(s->num_locks, sizeof(cs_data_t));
+  return (cs_counters == NULL);
+}
+
+static void
+cs_inc_run(stress_thread_t* t, size_t lock)
+{
+  cs_counters[lock * (sizeof(cs_data_t) / sizeof(size_t))]++;
+}
+
+static void
+cs_inc_report(stress_t* s)
+{
+  size_t total = 0, acquires = 0;
+  int i;
+  for (i = 0; i < s->num_locks; i++)
+    {
+      total += cs_counters[i * (sizeof(cs_data_t) / sizeof(size_t))];
+    }
+  for (i = 0; i < s->num_threads; i++)
+    {
+      acquires += s->threads[i].num_acquires;
+    }
+  if (total != acquires)
+    {
+      printf("*** error: counters total %zu != acquires %zu\n", total, acquires);
+    }
+}
+
+/* ds:TYPE[:INITIAL[:UPDATE[:RANGE[:DIST]]]]: random operations on a lock-based
+   data structure of ds_in.h, instead of lock/cs/unlock (the acquisitions
+   are the operations, and the lock latency their latency):
+     ht     hash table, one lock per bucket (INITIAL buckets)
+     list   linked list with hand-over-hand locking
+     sl     lazy skip list
+     queue  two-lock queue (half enqueues, half dequeues)
+   with INITIAL elements (default 1024), UPDATE% updates, half inserts and
+   half removes (default 20), and keys in [1, RANGE] (default 2 * INITIAL)
+   picked by DIST (see dist.h, default uniform). The size is checked at the end */
+
+#define CS_DS_HT    0
+#define CS_DS_LIST  1
+#define CS_DS_SL    2
+#define CS_DS_QUEUE 3
+
+#define CS_DS_INITIAL 1024
+#define CS_DS_UPDATE  20
+
+typedef struct cs_ds_thread
+{
+  union
+  {
+    struct
+    {
+      size_t num_found;		/* successful searches / dequeues */
+      long size_delta;		/* successful inserts (enqueues) - removes */
+    };
+    char padding[CACHE_LINE_SIZE];
+  };
+} cs_ds_thread_t;
+
+static const char* cs_ds_names[] = { "ht", "list", "sl", "queue" };
+static int cs_ds_type;
+static long cs_ds_initial;
+static int cs_ds_update;
+static dist_t* cs_ds_dist;
+static cs_ds_thread_t* cs_ds_threads;
+static ds_ht_t* cs_ds_ht;
+static ds_list_t* cs_ds_list;
+static ds_sl_t* cs_ds_sl;
+static ds_queue_t* cs_ds_queue;
+
+static inline int
+cs_ds_search(uint64_t key)
+{
+  uint64_t val;
+  switch (cs_ds_type)
+    {
+    case CS_DS_HT:
+      return ds_ht_search(cs_ds_ht, key, &val);
+    case CS_DS_LIST:
+      return ds_list_search(cs_ds_list, key, &val);
+    case CS_DS_SL:
+      return ds_sl_search(cs_ds_sl, key, &val);
+    default:
+      return ds_queue_dequeue(cs_ds_queue, &val);
+    }
+}
+
+static inline int
+cs_ds_insert(uint64_t key, unsigned long* seeds)
+{
+  switch (cs_ds_type)
+    {
+    case CS_DS_HT:
+      return ds_ht_insert(cs_ds_ht, key, key);
+    case CS_DS_LIST:
+      return ds_list_insert(cs_ds_list, key, key);
+    case CS_DS_SL:
+      return ds_sl_insert(cs_ds_sl, key, key, seeds);
+    default:
+      ds_queue_enqueue(cs_ds_queue, key);
+      return 1;
+    }
+}
+
+static inline int
+cs_ds_remove(uint64_t key)
+{
+  switch (cs_ds_type)
+    {
+    case CS_DS_HT:
+      return ds_ht_remove(cs_ds_ht, key);
+    case CS_DS_LIST:
+      return ds_list_remove(cs_ds_list, key);
+    case CS_DS_SL:
+      return ds_sl_remove(cs_ds_sl, key);
+    default:
+      return cs_ds_search(key);
+    }
+}
+
+static int
+cs_ds_init(stress_t* s, const char* args)
+{
+  const size_t len = strcspn(args, ":");
+  for (cs_ds_type = 0; cs_ds_type <= CS_DS_QUEUE; cs_ds_type++)
+    {
+      if (strlen(cs_ds_names[cs_ds_type]) == len && strncmp(cs_ds_names[cs_ds_type], args, len) == 0)
+	{
+	  break;
+	}
+    }
+  if (cs_ds_type > CS_DS_QUEUE)
+    {
+      return 1;
+    }
+
+  /* the numbers, then the distribution, which has colons itself */
+  long nums[3] = { CS_DS_INITIAL, CS_DS_UPDATE, 0 };
+  const char* p = args + len;
+  int i;
+  for (i = 0; i < 3 && *p == ':' && p[1] >= '0' && p[1] <= '9'; i++)
+    {
+      char* end;
+      nums[i] = strtol(p + 1, &end, 10);
+      p = end;
+    }
+  cs_ds_initial = nums[0];
+  cs_ds_update = nums[1];
+  const long range = (nums[2] > 0) ? nums[2] : 2 * cs_ds_initial;
+  if (cs_ds_initial < 0 || cs_ds_update < 0 || cs_ds_update > 100 || range <= 0 || range < cs_ds_initial ||
+      (*p != '\0' && *p != ':'))
+    {
+      return 1;
+    }
+  cs_ds_dist = dist_new((*p == ':') ? p + 1 : "uniform", range);
+  cs_ds_threads = (cs_ds_thread_t*) calloc(s->num_threads, sizeof(cs_ds_thread_t));
+  if (cs_ds_dist == NULL || cs_ds_threads == NULL)
+    {
+      return 1;
+    }
+
+  switch (cs_ds_type)
+    {
+    case CS_DS_HT:
+      cs_ds_ht = ds_ht_new((cs_ds_initial > 0) ? cs_ds_initial : 1);
+      break;
+    case CS_DS_LIST:
+      cs_ds_list = ds_list_new();
+      break;
+    case CS_DS_SL:
+      cs_ds_sl = ds_sl_new();
+      break;
+    default:
+      cs_ds_queue = ds_queue_new();
+    }
+
+  /* fill in with initial elements (uniformly) */
+  unsigned long* seeds = seed_rand();
+  long size = 0;
+  while (size < cs_ds_initial)
+    {
+      const uint64_t key = (my_random(&(seeds[0]),&(seeds[1]),&(seeds[2])) % range) + 1;
+      size += cs_ds_insert(key, seeds);
+    }
+  free(seeds);
+  return 0;
+}
+
+static void
+cs_ds_op(stress_thread_t* t)
+{
+  cs_ds_thread_t* d = cs_ds_threads + t->id;
+  const uint64_t r = my_random(&(t->seeds[0]),&(t->seeds[1]),&(t->seeds[2]));
+  const uint64_t key = dist_next(cs_ds_dist, t->seeds) + 1;
+  const uint32_t op = (r & 0xffffffff) % 100;
+
+  if (cs_ds_type == CS_DS_QUEUE)
+    {
+      /* half dequeues, half enqueues */
+      if (op < 50)
+	{
+	  const int ok = cs_ds_remove(key);
+	  d->size_delta -= ok;
+	  d->num_found += ok;
+	}
+      else
+	{
+	  d->size_delta += cs_ds_insert(key, t->seeds);
+	}
+    }
+  else if (op < cs_ds_update)
+    {
+      if ((r >> 32) & 1)
+	{
+	  d->size_delta += cs_ds_insert(key, t->seeds);
+	}
+      else
+	{
+	  d->size_delta -= cs_ds_remove(key);
+	}
+    }
+  else
+    {
+      d->num_found += cs_ds_search(key);
+    }
+}
+
+static void
+cs_ds_report(stress_t* s)
+{
+  size_t found = 0, size;
+  long expected = cs_ds_initial;
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      found += cs_ds_threads[i].num_found;
+      expected += cs_ds_threads[i].size_delta;
+    }
+
+  switch (cs_ds_type)
+    {
+    case CS_DS_HT:
+      size = ds_ht_size(cs_ds_ht);
+      ds_ht_destroy(cs_ds_ht);
+      break;
+    case CS_DS_LIST:
+      size = ds_list_size(cs_ds_list);
+      ds_list_destroy(cs_ds_list);
+      break;
+    case CS_DS_SL:
+      size = ds_sl_size(cs_ds_sl);
+      ds_sl_destroy(cs_ds_sl);
+      break;
+    default:
+      size = ds_queue_size(cs_ds_queue);
+      ds_queue_destroy(cs_ds_queue);
+    }
+  printf("#size         : %10zu ( found %zu)\n", size, found);
+  if (size != expected)
+    {
+      printf("*** error: size %zu != expected %ld\n", size, expected);
+    }
+  dist_destroy(cs_ds_dist);
+  free(cs_ds_threads);
+}
+
+/* cond:MODE[:ARGS]: iterations over condition variables (the pthread_cond_*
+   of LOCK_IN) instead of lock/cs/unlock:
+     pc[:PRODUCERS[:BUFFER]]  bounded-buffer producers/consumers, with not_empty
+                              and not_full signals (default n/2 producers, 16 slots)
+     wq[:BATCH]               work queue: thread 0 adds batches of tasks (default
+                              n - 1) and broadcasts to the workers, the last
+                              worker of a batch signals it
+     barrier                  a condvar-based barrier (the last arrival broadcasts)
+   The acquisitions are the iterations of the threads (an item produced or
+   consumed, a task, a barrier episode). Reports the operations (consumed
+   items, tasks, or episodes), the wakeups per signal and per broadcast (and
+   how many found the predicate still false), and the handoff latency from
+   the signal/broadcast to the return of the wait. Without phases */
+
+#define CS_COND_PC      0
+#define CS_COND_WQ      1
+#define CS_COND_BARRIER 2
+
+#define CS_COND_BUFFER  16
+
+typedef struct cs_cond_thread
+{
+  union
+  {
+    struct
+    {
+      size_t num_ops;		/* items produced or consumed / tasks / episodes */
+      size_t num_signals;
+      size_t num_broadcasts;
+      size_t num_broadcast_waiters; /* the waiters of the broadcasts */
+      size_t num_wakeups_signal;
+      size_t num_wakeups_broadcast;
+      size_t num_wakeups;	/* also the spurious ones and at the end */
+      size_t num_futile;	/* wakeups with the predicate still false */
+      cdf_hist_t* hist_handoff;
+    };
+    char padding[2 * CACHE_LINE_SIZE];
+  };
+} cs_cond_thread_t;
+
+/* the shared state, protected by lock */
+static struct
+{
+  pthread_mutex_t lock;
+  pthread_cond_t not_empty;	/* pc: items, wq: tasks, barrier: next episode */
+  pthread_cond_t not_full;	/* pc: room, wq: the batch is done */
+  size_t count;			/* items in the buffer / tasks in the queue */
+  size_t waiting_empty;		/* waiters on not_empty, not signaled yet */
+  size_t waiting_full;		/* waiters on not_full, not signaled yet */
+  size_t arrived;		/* barrier */
+  size_t generation;		/* barrier */
+  ticks signaled_empty;		/* time of the last not_empty signal/broadcast */
+  ticks signaled_full;		/* time of the last not_full signal/broadcast */
+  int broadcast_empty;		/* whether that was a broadcast */
+  int broadcast_full;
+} cs_cond;
+
+static stress_t* cs_cond_s;
+static int cs_cond_mode;
+static int cs_cond_producers;
+static size_t cs_cond_buffer;
+static size_t cs_cond_batch;
+static cs_cond_thread_t* cs_cond_threads;
+
+/* one wait on c (with the lock held); a wakeup after a signal/broadcast
+   that happened during the wait is charged to it */
+static inline void
+cs_cond_wait_once(cs_cond_thread_t* d, pthread_cond_t* c, size_t* waiting, ticks* signaled, int* broadcast)
+{
+  const ticks start = getticks();
+  (*waiting)++;
+  pthread_cond_wait(c, &cs_cond.lock);
+  d->num_wakeups++;
+  const ticks sig = *signaled;
+  if (sig > start)
+    {
+      cdf_hist_add(d->hist_handoff, getticks() - sig);
+      if (*broadcast)
+	{
+	  d->num_wakeups_broadcast++;
+	}
+      else
+	{
+	  d->num_wakeups_signal++;
+	}
+    }
+}
+
+/* signal (or broadcast) c (with the lock held), only if there are waiters
+   that are not signaled yet, so that a signal should wake up one waiter and
+   a broadcast all of them */
+static inline void
+cs_cond_signal(cs_cond_thread_t* d, pthread_cond_t* c, size_t* waiting, ticks* signaled, int* broadcast,
+	       int all)
+{
+  if (*waiting == 0)
+    {
+      return;
+    }
+  *signaled = getticks();
+  *broadcast = all;
+  if (all)
+    {
+      pthread_cond_broadcast(c);
+      d->num_broadcasts++;
+      d->num_broadcast_waiters += *waiting;
+      *waiting = 0;
+    }
+  else
+    {
+      pthread_cond_signal(c);
+      d->num_signals++;
+      (*waiting)--;
+    }
+}
+
+#define CS_COND_WAIT_WHILE(d, pred, which)				\
+  while ((pred) && !cs_cond_s->stop)					\
+    {									\
+      cs_cond_wait_once(d, &cs_cond.not_##which, &cs_cond.waiting_##which, \
+			&cs_cond.signaled_##which, &cs_cond.broadcast_##which); \
+      if ((pred) && !cs_cond_s->stop)					\
+	{								\
+	  (d)->num_futile++;						\
+	}								\
+    }
+
+#define CS_COND_SIGNAL(d, which, all)					\
+  cs_cond_signal(d, &cs_cond.not_##which, &cs_cond.waiting_##which,	\
+		 &cs_cond.signaled_##which, &cs_cond.broadcast_##which, all)
+
+static int
+cs_cond_init(stress_t* s, const char* args)
+{
+  cs_cond_s = s;
+  int a = 0, b = 0;
+  if (!strncmp(args, "pc", 2) && (args[2] == '\0' || args[2] == ':'))
+    {
+      cs_cond_mode = CS_COND_PC;
+      sscanf(args + 2, ":%d:%d", &a, &b);
+      cs_cond_producers = (a > 0) ? a : s->num_threads / 2;
+      cs_cond_buffer = (b > 0) ? b : CS_COND_BUFFER;
+      if (cs_cond_producers <= 0 || cs_cond_producers >= s->num_threads)
+	{
+	  return 1;
+	}
+    }
+  else if (!strncmp(args, "wq", 2) && (args[2] == '\0' || args[2] == ':'))
+    {
+      cs_cond_mode = CS_COND_WQ;
+      sscanf(args + 2, ":%d", &a);
+      cs_cond_producers = 1;
+      cs_cond_batch = (a > 0) ? a : s->num_threads - 1;
+      if (s->num_threads < 2)
+	{
+	  return 1;
+	}
+    }
+  else if (!strcmp(args, "barrier"))
+    {
+      cs_cond_mode = CS_COND_BARRIER;
+      cs_cond_producers = 0;
+    }
+  else
+    {
+      return 1;
+    }
+  if (s->num_phases > 1)
+    {
+      return 1;			/* the inactive threads would block the others */
+    }
+
+  pthread_mutex_init(&cs_cond.lock, NULL);
+  pthread_cond_init(&cs_cond.not_empty, NULL);
+  pthread_cond_init(&cs_cond.not_full, NULL);
+  cs_cond_threads = (cs_cond_thread_t*) calloc(s->num_threads, sizeof(cs_cond_thread_t));
+  int i;
+  for (i = 0; cs_cond_threads != NULL && i < s->num_threads; i++)
+    {
+      cs_cond_threads[i].hist_handoff = cdf_hist_new();
+    }
+  return (cs_cond_threads == NULL);
+}
+
+static void
+cs_cond_op_pc(stress_thread_t* t, cs_cond_thread_t* d)
+{
+  pthread_mutex_lock(&cs_cond.lock);
+  if (t->id < cs_cond_producers)
+    {
+      CS_COND_WAIT_WHILE(d, cs_cond.count == cs_cond_buffer, full);
+      if (!cs_cond_s->stop)
+	{
+	  cs_cond.count++;
+	  CS_COND_SIGNAL(d, empty, 0);
+	  d->num_ops++;
+	}
+    }
+  else
+    {
+      CS_COND_WAIT_WHILE(d, cs_cond.count == 0, empty);
+      if (!cs_cond_s->stop)
+	{
+	  cs_cond.count--;
+	  CS_COND_SIGNAL(d, full, 0);
+	  d->num_ops++;
+	}
+    }
+  pthread_mutex_unlock(&cs_cond.lock);
+}
+
+static void
+cs_cond_op_wq(stress_thread_t* t, cs_cond_thread_t* d)
+{
+  pthread_mutex_lock(&cs_cond.lock);
+  if (t->id < cs_cond_producers)
+    {
+      CS_COND_WAIT_WHILE(d, cs_cond.count > 0, full);
+      if (!cs_cond_s->stop)
+	{
+	  cs_cond.count += cs_cond_batch;
+	  CS_COND_SIGNAL(d, empty, 1);
+	  d->num_ops += cs_cond_batch;
+	}
+    }
+  else
+    {
+      CS_COND_WAIT_WHILE(d, cs_cond.count == 0, empty);
+      if (!cs_cond_s->stop)
+	{
+	  if (--cs_cond.count == 0)
+	    {
+	      CS_COND_SIGNAL(d, full, 0);
+	    }
+	  d->num_ops++;
+	}
+    }
+  pthread_mutex_unlock(&cs_cond.lock);
+}
+
+static void
+cs_cond_op_barrier(stress_thread_t* t, cs_cond_thread_t* d)
+{
+  pthread_mutex_lock(&cs_cond.lock);
+  const size_t generation = cs_cond.generation;
+  if (++cs_cond.arrived == (size_t) cs_cond_s->num_threads)
+    {
+      cs_cond.arrived = 0;
+      cs_cond.generation++;
+      CS_COND_SIGNAL(d, empty, 1);
+    }
+  else
+    {
+      CS_COND_WAIT_WHILE(d, cs_cond.generation == generation, empty);
+    }
+  pthread_mutex_unlock(&cs_cond.lock);
+  d->num_ops++;
+}
+
+static void
+cs_cond_op(stress_thread_t* t)
+{
+  cs_cond_thread_t* d = cs_cond_threads + t->id;
+  switch (cs_cond_mode)
+    {
+    case CS_COND_PC:
+      cs_cond_op_pc(t, d);
+      break;
+    case CS_COND_WQ:
+      cs_cond_op_wq(t, d);
+      break;
+    default:
+      cs_cond_op_barrier(t, d);
+    }
+}
+
+/* wakes up the threads that are waiting */
+static void
+cs_cond_stop(stress_t* s)
+{
+  pthread_mutex_lock(&cs_cond.lock);
+  pthread_cond_broadcast(&cs_cond.not_empty);
+  pthread_cond_broadcast(&cs_cond.not_full);
+  pthread_mutex_unlock(&cs_cond.lock);
+}
+
+static void
+cs_cond_report(stress_t* s)
+{
+  cs_cond_thread_t total;
+  memset(&total, 0, sizeof(total));
+  size_t produced = 0, consumed = 0;
+  cdf_hist_t* h = cdf_hist_new();
+  int i;
+  for (i = 0; i < s->num_threads; i++)
+    {
+      const cs_cond_thread_t* d = cs_cond_threads + i;
+      if (i < cs_cond_producers)
+	{
+	  produced += d->num_ops;
+	}
+      else
+	{
+	  consumed += d->num_ops;
+	}
+      total.num_signals += d->num_signals;
+      total.num_broadcasts += d->num_broadcasts;
+      total.num_broadcast_waiters += d->num_broadcast_waiters;
+      total.num_wakeups_signal += d->num_wakeups_signal;
+      total.num_wakeups_broadcast += d->num_wakeups_broadcast;
+      total.num_wakeups += d->num_wakeups;
+      total.num_futile += d->num_futile;
+      cdf_hist_merge(h, d->hist_handoff);
+      cdf_hist_destroy(d->hist_handoff);
+    }
+
+  size_t ops = consumed;
+  if (cs_cond_mode == CS_COND_BARRIER)
+    {
+      ops = cs_cond.generation;
+    }
+  else if (produced - consumed != cs_cond.count)
+    {
+      printf("*** error: produced %zu - consumed %zu != %zu in the queue\n",
+	     produced, consumed, cs_cond.count);
+    }
+
+  printf("#operations   : %10zu ( %10.0f / s)\n", ops, ops * 1000.0 / s->duration);
+  printf("#signals      : %10zu ( signal %zu | broadcast %zu, of %.2f waiters)\n",
+	 total.num_signals + total.num_broadcasts, total.num_signals, total.num_broadcasts,
+	 total.num_broadcasts ? (double) total.num_broadcast_waiters / total.num_broadcasts : 0.0);
+  /* expected: 1 per signal, the waiters per broadcast */
+  printf("#wakeups      : %10zu ( %.2f / signal | %.2f / broadcast | futile %.1f%%)\n",
+	 total.num_wakeups,
+	 total.num_signals ? (double) total.num_wakeups_signal / total.num_signals : 0.0,
+	 total.num_broadcasts ? (double) total.num_wakeups_broadcast / total.num_broadcasts : 0.0,
+	 total.num_wakeups ? 100.0 * total.num_futile / total.num_wakeups : 0.0);
+  printf("#handoff      : p50 %zu p90 %zu p99 %zu p99.9 %zu max %zu (cycles from the signal to the wakeup)\n",
+	 cdf_hist_percentile(h, 50), cdf_hist_percentile(h, 90),
+	 cdf_hist_percentile(h, 99), cdf_hist_percentile(h, 99.9), h->max);
+  cdf_hist_destroy(h);
+  free(cs_cond_threads);
+}
+
+static const stress_cs_t stress_css[] =
+  {
+    { "pause", "pause:N  pause for N cycles", cs_pause_init, cs_pause_run, NULL },
+    { "cl", "cl:N[:w] read (or write) N cache lines of the lock", cs_cl_init, cs_cl_run, NULL },
+    { "inc", "inc      increment a per-lock counter (checked at the end)", cs_inc_init, cs_inc_run, cs_inc_report },
+    { "ds", "ds:TYPE[:INITIAL[:UPDATE[:RANGE[:DIST]]]]  operations on a lock-based data structure\n"
+      "                   (ht, list, sl, queue, see ds_in.h) instead of lock/cs/unlock",
+      cs_ds_init, NULL, cs_ds_report, cs_ds_op },
+    { "cond", "cond:pc[:P[:B]]|wq[:K]|barrier  iterations over condition variables instead of\n"
+      "                   lock/cs/unlock: producers/consumers, a work queue, or a barrier",
+      cs_cond_init, NULL, cs_cond_report, cs_cond_op, cs_cond_stop },
+  };
+
+/* ******************************************************************************** */
+/* think ************************************************************************** */
+
+static stress_t* think_s;
+static double think_cycles;
+
+static int
+think_pause_init(stress_t* s, const char* args)
+{
+  think_s = s;
+  think_cycles = atof(args);
+  return (think_cycles < 0);
+}
+
+static void
+think_pause_run(stress_thread_t* t)
+{
+  const ticks c = think_cycles * think_s->think_scale;
+  if (c > 0)
+    {
+      cpause(c);
+    }
+}
+
+static void
+think_exp_run(stress_thread_t* t)
+{
+  const ticks c = -log(1.0 - stress_rand_01(t)) * think_cycles * think_s->think_scale;
+  if (c > 0)
+    {
+      cpause(c);
+    }
+}
+
+static const stress_think_t stress_thinks[] =
+  {
+    { "pause", "pause:N  pause for N cycles", think_pause_init, think_pause_run },
+    { "exp", "exp:N    pause for exponentially distributed cycles, of mean N", think_pause_init, think_exp_run },
+  };
+
+/* ******************************************************************************** */
+/* phase ************************************************************************** */
+
+#define PHASE_MAX 64
+
+typedef struct phase_step
+{
+  int ms;
+  double cs_scale;
+  double think_scale;
+  int threads;
+} phase_step_t;
+
+static phase_step_t phase_steps[PHASE_MAX];
+static int phase_num;
+static int phase_period;
+
+/* steps:MS[:CS[:THINK[:THREADS]]],...: for MS milliseconds, scale the cs and
+   think times by CS and THINK, with THREADS active threads; repeated */
+static int
+phase_steps_init(stress_t* s, const char* args)
+{
+  char* copy = strdup(args);
+  char* save;
+  char* p;
+  phase_num = phase_period = 0;
+  for (p = strtok_r(copy, ",", &save); p != NULL && phase_num < PHASE_MAX; p = strtok_r(NULL, ",", &save))
+    {
+      phase_step_t* st = phase_steps + phase_num++;
+      st->cs_scale = st->think_scale = 1;
+      st->threads = s->num_threads;
+      sscanf(p, "%d:%lf:%lf:%d", &st->ms, &st->cs_scale, &st->think_scale, &st->threads);
+      if (st->ms <= 0 || st->threads < 0 || st->threads > s->num_threads)
+	{
+	  free(copy);
+	  return 1;
+	}
+      phase_period += st->ms;
+    }
+  free(copy);
+  s->num_phases = phase_num;
+  return (phase_num == 0);
+}
+
+static int
+phase_steps_update(stress_t* s, int ms)
+{
+  int at = ms % phase_period, i;
+  for (i = 0; i < phase_num; i++)
+    {
+      if (at < phase_steps[i].ms)
+	{
+	  break;
+	}
+      at -= phase_steps[i].ms;
+    }
+  s->cs_scale = phase_steps[i].cs_scale;
+  s->think_scale = phase_steps[i].think_scale;
+  s->active_threads = phase_steps[i].threads;
+  s->phase = i;
+  return phase_steps[i].ms - at;
+}
+
+/* ramp:MS:R,...: for MS milliseconds each, R threads per hardware context
+   (online cpus), e.g., ramp:1000:0.5,1,2,4 for oversubscription; -n is
+   raised to the threads of the largest R. Repeated */
+static int
+phase_ramp_init(stress_t* s, const char* args)
+{
+  const int contexts = sysconf(_SC_NPROCESSORS_ONLN);
+  char* end;
+  const int ms = strtol(args, &end, 10);
+  if (ms <= 0 || *end != ':' || contexts <= 0)
+    {
+      return 1;
+    }
+  char* copy = strdup(end + 1);
+  char* save;
+  char* p;
+  phase_num = phase_period = 0;
+  for (p = strtok_r(copy, ",", &save); p != NULL && phase_num < PHASE_MAX; p = strtok_r(NULL, ",", &save))
+    {
+      const double ratio = strtod(p, &end);
+      if (end == p || *end != '\0' || ratio <= 0)
+	{
+	  free(copy);
+	  return 1;
+	}
+      phase_step_t* st = phase_steps + phase_num++;
+      st->ms = ms;
+      st->cs_scale = st->think_scale = 1;
+      st->threads = (int) ceil(ratio * contexts);
+      if (st->threads > s->num_threads)
+	{
+	  s->num_threads = st->threads;
+	}
+      phase_period += ms;
+    }
+  free(copy);
+  s->num_phases = phase_num;
+  return (phase_num == 0);
+}
+
+static const stress_phase_t stress_phases[] =
+  {
+    { "steps", "steps:MS[:CS[:THINK[:THREADS]]],...  repeated phases of MS ms", phase_steps_init, phase_steps_update },
+    { "ramp", "ramp:MS:R,...  phases of MS ms with R threads per hardware context (raises -n)",
+      phase_ramp_init, phase_steps_update },
+  };
+
+#endif	/* _STRESS_IN_WORKLOAD_H_ */
@@ -0,0 +1,174 @@
+/*
+ * File: trace_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Binary lock-event tracing on top of any LOCK_IN algorithm
+ *      (LOCK_IN_TRACE=1, see lock_in_trace.h).
+ *
+ *      Every acquire records an acquire-start and an acquired event, every
+ *      release a release event (before the lock is actually released, so that
+ *      it precedes the acquired event of the next owner). While a thread is in
+ *      the underlying lock or unlock, the futex calls of MUTEXEE and GLK and the
+ *      mode switches of GLK are attributed to the traced lock.
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef _TRACE_IN_H_
+#define _TRACE_IN_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+#include <pthread.h>
+#include "lock_in_trace.h"
+#include "wrap_in.h"
+
+#if !defined(_LOCK_IN_H_)
+#  error trace_in.h is included by lock_in.h (with LOCK_IN_TRACE=1)
+#endif
+#if LOCK_IN == GLS
+#  error LOCK_IN_TRACE does not support GLS
+#endif
+
+  LOCK_IN_WRAP_BASE(trace)
+
+  typedef struct trace_lock
+  {
+    volatile uint32_t base_ready;	/* LOCK_IN_WRAP_BASE_READY once base is initialized */
+    trace_base_t base;
+  } trace_lock_t;
+
+  /* the underlying lock of a statically initialized lock is initialized by
+     its first user */
+#define TRACE_LOCK_INITIALIZER { .base_ready = 0 }
+
+  LOCK_IN_WRAP_BASE_ENSURE(trace)
+
+  static inline int
+  trace_lock_init(trace_lock_t* l, const pthread_mutexattr_t* a)
+  {
+    (void) a;
+    l->base_ready = LOCK_IN_WRAP_BASE_READY;
+    return trace_base_init(&l->base);
+  }
+
+  static inline int
+  trace_lock_destroy(trace_lock_t* l)
+  {
+    if (l->base_ready == LOCK_IN_WRAP_BASE_READY)
+      {
+	return trace_base_destroy(&l->base);
+      }
+    return 0;
+  }
+
+  static inline void
+  trace_event(const uint32_t type, const trace_lock_t* l, const uint32_t arg)
+  {
+    lock_in_trace_thread_t* t = lock_in_trace_me;
+    if (__builtin_expect(t == NULL, 0))
+      {
+	t = lock_in_trace_register(LOCK_IN_NAME);
+      }
+    lock_in_trace_push(t, LOCK_IN_TRACE_WORD(type, l, arg));
+  }
+
+  static inline int
+  trace_lock_lock(trace_lock_t* l)
+  {
+    trace_base_ensure(l);
+    trace_event(LOCK_IN_TRACE_ACQ_START, l, 0);
+    lock_in_trace_cur = l;
+    const int ret = trace_base_lock(&l->base);
+    lock_in_trace_cur = NULL;
+    trace_event(LOCK_IN_TRACE_ACQUIRED, l, 0);
+    return ret;
+  }
+
+  static inline int
+  trace_lock_timedlock(trace_lock_t* l, const struct timespec* ts)
+  {
+    trace_base_ensure(l);
+    trace_event(LOCK_IN_TRACE_ACQ_START, l, 0);
+    lock_in_trace_cur = l;
+    const int ret = trace_base_timedlock(&l->base, ts);
+    lock_in_trace_cur = NULL;
+    trace_event((ret == 0) ? LOCK_IN_TRACE_ACQUIRED : LOCK_IN_TRACE_ACQ_TIMEOUT, l, 0);
+    return ret;
+  }
+
+  static inline int
+  trace_lock_trylock(trace_lock_t* l)
+  {
+    trace_base_ensure(l);
+    const int ret = trace_base_trylock(&l->base);
+    if (ret == 0)
+      {
+	trace_event(LOCK_IN_TRACE_ACQUIRED, l, 1);
+      }
+    return ret;
+  }
+
+  static inline int
+  trace_lock_unlock(trace_lock_t* l)
+  {
+    trace_event(LOCK_IN_TRACE_RELEASE, l, 0);
+    lock_in_trace_cur = l;
+    const int ret = trace_base_unlock(&l->base);
+    lock_in_trace_cur = NULL;
+    return ret;
+  }
+
+  static inline int
+  trace_cond_wait(pthread_cond_t* c, trace_lock_t* l)
+  {
+    trace_event(LOCK_IN_TRACE_RELEASE, l, 1);
+    const int ret = trace_base_cond_wait(c, &l->base);
+    trace_event(LOCK_IN_TRACE_ACQUIRED, l, 0);
+    return ret;
+  }
+
+  static inline int
+  trace_cond_timedwait(pthread_cond_t* c, trace_lock_t* l, const struct timespec* ts)
+  {
+    trace_event(LOCK_IN_TRACE_RELEASE, l, 1);
+    const int ret = trace_base_cond_timedwait(c, &l->base, ts);
+    trace_event(LOCK_IN_TRACE_ACQUIRED, l, 0);
+    return ret;
+  }
+
+#undef  LOCK_IN_WRAP
+#undef  LOCK_IN_WRAP_INITIALIZER
+#define LOCK_IN_WRAP             trace
+#define LOCK_IN_WRAP_INITIALIZER TRACE_LOCK_INITIALIZER
+#define LOCK_IN_WRAP_REDIRECT
+#include "wrap_in.h"
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif	/* _TRACE_IN_H_ */
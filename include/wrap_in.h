@@ -0,0 +1,165 @@
+/*
+ * File: wrap_in.h
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The common parts of the lock wrappers (biased_in.h, gcr_in.h, stats_in.h,
+ *      profile_in.h, trace_in.h), which are stacked on top of the LOCK_IN algorithm:
+ *
+ *        LOCK_IN_WRAP_BASE(p)         p_base_t, the lock underneath (the algorithm or
+ *                                     the previous wrapper), and its p_base_* functions
+ *        LOCK_IN_WRAP_BASE_ENSURE(p)  p_base_ensure(p_lock_t*): initializes the base
+ *                                     of a statically initialized lock by its first user
+ *
+ *      and, included again with LOCK_IN_WRAP_REDIRECT defined, the redirection of
+ *      the pthread_mutex_* and pthread_cond_*wait functions to the LOCK_IN_WRAP ones
+ *      (e.g., trace_lock_lock for LOCK_IN_WRAP trace).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+#ifndef _WRAP_IN_H_
+#define _WRAP_IN_H_
+
+#include <stdint.h>
+#include <pthread.h>
+
+#if !defined(_LOCK_IN_H_)
+#  error wrap_in.h is included by the lock wrappers of lock_in.h
+#endif
+
+#define LOCK_IN_WRAP_CAT_(p, n)   p##_##n
+#define LOCK_IN_WRAP_CAT(p, n)    LOCK_IN_WRAP_CAT_(p, n)
+/* the function n of the outermost wrapper */
+#define LOCK_IN_WRAP_NAME(n)      LOCK_IN_WRAP_CAT(LOCK_IN_WRAP, n)
+
+/* p_lock_t.base_ready */
+#define LOCK_IN_WRAP_BASE_INIT    1
+#define LOCK_IN_WRAP_BASE_READY   2
+
+/* expanded before the wrapper redirects the pthread_* functions, so that
+   the p_base_* functions call the lock underneath */
+#define LOCK_IN_WRAP_BASE(p)						\
+  typedef pthread_mutex_t p##_base_t;					\
+									\
+  static inline int							\
+  p##_base_init(p##_base_t* m)						\
+  {									\
+    return pthread_mutex_init(m, NULL);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_destroy(p##_base_t* m)					\
+  {									\
+    return pthread_mutex_destroy(m);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_lock(p##_base_t* m)						\
+  {									\
+    return pthread_mutex_lock(m);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_timedlock(p##_base_t* m, const struct timespec* ts)		\
+  {									\
+    return pthread_mutex_timedlock(m, ts);				\
+  }									\
+									\
+  static inline int							\
+  p##_base_trylock(p##_base_t* m)					\
+  {									\
+    return pthread_mutex_trylock(m);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_unlock(p##_base_t* m)					\
+  {									\
+    return pthread_mutex_unlock(m);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_cond_wait(pthread_cond_t* c, p##_base_t* m)			\
+  {									\
+    return pthread_cond_wait(c, m);					\
+  }									\
+									\
+  static inline int							\
+  p##_base_cond_timedwait(pthread_cond_t* c, p##_base_t* m, const struct timespec* ts) \
+  {									\
+    return pthread_cond_timedwait(c, m, ts);				\
+  }
+
+/* p_lock_t has a volatile uint32_t base_ready, 0 in the initializer, and a
+   p_base_t base */
+#define LOCK_IN_WRAP_BASE_ENSURE(p)					\
+  static inline void							\
+  p##_base_ensure(p##_lock_t* l)					\
+  {									\
+    if (__builtin_expect(l->base_ready == LOCK_IN_WRAP_BASE_READY, 1))	\
+      {									\
+	return;								\
+      }									\
+    if (__sync_val_compare_and_swap(&l->base_ready, 0, LOCK_IN_WRAP_BASE_INIT) == 0) \
+      {									\
+	p##_base_init(&l->base);					\
+	asm volatile ("" ::: "memory");					\
+	l->base_ready = LOCK_IN_WRAP_BASE_READY;			\
+	return;								\
+      }									\
+    while (l->base_ready != LOCK_IN_WRAP_BASE_READY)			\
+      {									\
+	PAUSE_IN();							\
+      }									\
+  }
+
+#endif	/* _WRAP_IN_H_ */
+
+/* the redirection, at the end of a wrapper: the names resolve to the
+   outermost wrapper (LOCK_IN_WRAP) where they are used, and the base
+   functions of the next wrapper have already been expanded with the
+   previous one */
+#if defined(LOCK_IN_WRAP_REDIRECT)
+#  undef  LOCK_IN_WRAP_REDIRECT
+#  if REPLACE_MUTEX == 1
+#    undef  pthread_mutex_init
+#    undef  pthread_mutex_destroy
+#    undef  pthread_mutex_lock
+#    undef  pthread_mutex_timedlock
+#    undef  pthread_mutex_unlock
+#    undef  pthread_mutex_trylock
+#    undef  pthread_mutex_t
+#    undef  pthread_cond_wait
+#    undef  pthread_cond_timedwait
+#    define pthread_mutex_init    LOCK_IN_WRAP_NAME(lock_init)
+#    define pthread_mutex_destroy LOCK_IN_WRAP_NAME(lock_destroy)
+#    define pthread_mutex_lock    LOCK_IN_WRAP_NAME(lock_lock)
+#    define pthread_mutex_timedlock LOCK_IN_WRAP_NAME(lock_timedlock)
+#    define pthread_mutex_unlock  LOCK_IN_WRAP_NAME(lock_unlock)
+#    define pthread_mutex_trylock LOCK_IN_WRAP_NAME(lock_trylock)
+#    define pthread_mutex_t       LOCK_IN_WRAP_NAME(lock_t)
+#    undef  PTHREAD_MUTEX_INITIALIZER
+#    define PTHREAD_MUTEX_INITIALIZER LOCK_IN_WRAP_INITIALIZER
+
+#    define pthread_cond_wait     LOCK_IN_WRAP_NAME(cond_wait)
+#    define pthread_cond_timedwait LOCK_IN_WRAP_NAME(cond_timedwait)
+#  endif
+#endif
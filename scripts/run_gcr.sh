@@ -0,0 +1,39 @@
+#!/bin/bash
+
+# Throughput of stress_test_in with and without GCR (scripts/make_gcr.sh)
+# from 0.5x to 4x as many threads as hardware contexts.
+
+if [ $# -lt 1 ];
+then
+    echo "Usage: $0 \"LOCKS\" [PARAMETERS]";
+    echo " e.g., $0 \"TICKET MCS CLH TTAS\" -l1 -a100 -d1000";
+    exit;
+fi;
+
+locks="$1";
+shift;
+
+hw=$(nproc);
+threads="$((hw / 2)) $hw $((hw * 2)) $((hw * 3)) $((hw * 4))";
+
+printf "#Thr ";
+for lock in $locks
+do
+    printf "%-14s%-14s" $lock GCR-$lock;
+done;
+echo "";
+
+for n in $threads
+do
+    [ $n -lt 1 ] && continue;
+    printf "%-5d" $n;
+    for lock in $locks
+    do
+	for e in stress_test_in_${lock} stress_test_in_GCR_${lock}
+	do
+	    thr=$(./$e $@ -n$n | awk '/^#acquires/ { print $5 }');
+	    printf "%-14s" $thr;
+	done;
+    done;
+    echo "";
+done;
@@ -0,0 +1,26 @@
+#!/bin/bash
+
+# Ranks the lock algorithms (built with scripts/make_replay.sh) on a
+# recorded workload: replays the trace with each of them and sorts them by
+# makespan.
+# A trace is recorded by building the application with TRACE=1 and
+# exported with `lockin-trace -o replay.bin lockin-trace.<pid>.bin`.
+
+if [ $# -lt 2 ];
+then
+    echo "Usage: $0 REPLAY_FILE \"LOCKS\" [PARAMETERS]";
+    echo " e.g., $0 replay.bin \"MUTEX TICKET MCS MUTEXEE GLK\" -r3";
+    exit;
+fi;
+
+file="$1";
+locks="$2";
+shift 2;
+
+printf "%-12s %14s %14s %12s\n" "#lock" "makespan(ms)" "acquires/s" "wait-avg(us)";
+for lock in $locks
+do
+    ./stress_replay_in_${lock} -f $file $@ | \
+	awk -v lock=$lock '/^#makespan/ { m = $3 } /^#acquires/ { a = $5 } /^#wait-avg/ { w = $3 }
+                           END { printf "%-12s %14s %14s %12s\n", lock, m, a, w }';
+done | sort -g -k2;
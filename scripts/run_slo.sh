@@ -0,0 +1,75 @@
+#!/bin/bash
+
+# Finds, for each lock algorithm (built with scripts/make_ldi.sh), the maximum
+# offered load (open-loop stress_ldi_in -R) whose latency percentile, measured
+# from the intended start of the acquisitions, meets the SLO (in cycles).
+# The rate is doubled until the SLO is missed (or the lock cannot keep up with
+# the offered load), and then bisected.
+
+if [ $# -lt 2 ];
+then
+    echo "Usage: $0 \"LOCKS\" SLO_CYCLES [PERCENTILE] [PARAMETERS]";
+    echo " e.g., $0 \"MUTEX TICKET MCS MUTEXEE\" 100000 p99 -n8 -a500 -d2000";
+    exit;
+fi;
+
+locks="$1";
+slo=$2;
+shift 2;
+perc=p99;
+if [ $# -gt 0 ] && [[ "$1" == p* ]];
+then
+    perc=$1;
+    shift;
+fi;
+start_rate=${START_RATE:-10000};
+steps=${BISECT_STEPS:-5};
+
+# prints the latency percentile of the run at rate $2 with lock $1 and
+# whether the lock kept up with the offered load (1 or 0)
+run()
+{
+    ./stress_ldi_in_$1 -R $2 $params | \
+	awk -v p=$perc '/^#offered/ { a = substr($8, 1, length($8) - 1) + 0 }
+                        /^#latency/ { for (i = 3; i < NF; i += 2) if ($i == p) l = $(i + 1) }
+                        END { print l, (a >= 95) }';
+}
+
+# whether rate $2 meets the SLO with lock $1
+meets()
+{
+    set -- $(run $1 $2);
+    [ "$1" != "" ] && [ $1 -le $slo ] && [ $2 -eq 1 ];
+}
+
+params="$@";
+printf "%-12s %14s %14s\n" "#lock" "max-rate(/s)" "$perc(cycles)";
+for lock in $locks
+do
+    lo=0;
+    hi=$start_rate;
+    while meets $lock $hi;
+    do
+	lo=$hi;
+	hi=$((hi * 2));
+    done;
+
+    for s in $(seq 1 $steps);
+    do
+	mid=$(((lo + hi) / 2));
+	if meets $lock $mid;
+	then
+	    lo=$mid;
+	else
+	    hi=$mid;
+	fi;
+    done;
+
+    lat="-";
+    if [ $lo -gt 0 ];
+    then
+	set -- $(run $lock $lo);
+	lat=$1;
+    fi;
+    printf "%-12s %14s %14s\n" $lock $lo $lat;
+done;
@@ -92,6 +92,123 @@ cdf_calc(const size_t* vals, const size_t val_n)
   return e;
 }
 
+cdf_hist_t*
+cdf_hist_new()
+{
+  cdf_hist_t* h = (cdf_hist_t*) calloc(1, sizeof(cdf_hist_t));
+  assert(h != NULL);
+  h->min = SIZE_MAX;
+  return h;
+}
+
+void
+cdf_hist_merge(cdf_hist_t* dst, const cdf_hist_t* src)
+{
+  size_t b;
+  for (b = 0; b < CDF_HIST_BUCKETS; b++)
+    {
+      dst->counts[b] += src->counts[b];
+    }
+  dst->n += src->n;
+  if (src->min < dst->min)
+    {
+      dst->min = src->min;
+    }
+  if (src->max > dst->max)
+    {
+      dst->max = src->max;
+    }
+  dst->sum += src->sum;
+  dst->sum_sq += src->sum_sq;
+}
+
+/* the lowest value of bucket b */
+static size_t
+cdf_hist_value(const size_t b)
+{
+  const size_t r = b >> CDF_HIST_SUB_BITS;
+  if (r == 0)
+    {
+      return b;
+    }
+  return (CDF_HIST_SUB + (b & (CDF_HIST_SUB - 1))) << (r - 1);
+}
+
+/* the cdf of the histogram, with one pair per non-empty bucket */
+cdf_t*
+cdf_calc_hist(const cdf_hist_t* h)
+{
+  cdf_t* e = (cdf_t*) calloc(1, sizeof(cdf_t));
+  assert(e != NULL);
+
+  size_t b, ps_n = 0;
+  for (b = 0; b < CDF_HIST_BUCKETS; b++)
+    {
+      ps_n += (h->counts[b] > 0);
+    }
+  e->pairs = (cdf_pair_t*) malloc((ps_n + 1) * sizeof(cdf_pair_t));
+  assert(e->pairs != NULL);
+  e->val_n = h->n;
+
+  if (h->n == 0)
+    {
+      e->pairs[0].x = 0;
+      e->pairs[0].cdf = 100.0;
+      e->pair_n = 1;
+      return e;
+    }
+
+  size_t cum = 0;
+  for (b = 0; b < CDF_HIST_BUCKETS; b++)
+    {
+      if (h->counts[b] == 0)
+	{
+	  continue;
+	}
+      cum += h->counts[b];
+      size_t x = cdf_hist_value(b);
+      x = (x < h->min) ? h->min : (x > h->max) ? h->max : x;
+      e->pairs[e->pair_n].x = x;
+      e->pairs[e->pair_n].cdf = ((double) cum / h->n) * 100.0;
+      e->pair_n++;
+    }
+  e->pairs[e->pair_n - 1].x = h->max;
+
+  e->plus.avg = h->sum / h->n;
+  const double var = h->sum_sq / h->n - e->plus.avg * e->plus.avg;
+  e->plus.stdev = (var > 0) ? sqrt(var) : 0;
+  e->plus.stdevp = (e->plus.avg > 0) ? 100 * e->plus.stdev / e->plus.avg : 0;
+  return e;
+}
+
+/* the value at percentile perc (the lowest value of its bucket) */
+size_t
+cdf_hist_percentile(const cdf_hist_t* h, const double perc)
+{
+  if (h->n == 0)
+    {
+      return 0;
+    }
+  const double target = h->n * perc / 100.0;
+  size_t b, cum = 0;
+  for (b = 0; b < CDF_HIST_BUCKETS; b++)
+    {
+      cum += h->counts[b];
+      if (cum > 0 && cum >= target)
+	{
+	  const size_t x = cdf_hist_value(b);
+	  return (x < h->min) ? h->min : (x > h->max) ? h->max : x;
+	}
+    }
+  return h->max;
+}
+
+void
+cdf_hist_destroy(cdf_hist_t* h)
+{
+  free(h);
+}
+
 void
 cdf_print(const cdf_t* e)
 {
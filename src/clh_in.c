@@ -79,7 +79,7 @@ clh_set_local(clh_lock_t* lock, clh_lock_node_t* new)
   lock->local[__clh_id] = new;
 }
 
-inline int
+int
 clh_lock_trylock(clh_lock_t* lock) 
 {
   /* volatile clh_lock_node_t* local = clh_get_local(lock); */
@@ -109,7 +109,7 @@ clh_lock_trylock(clh_lock_t* lock)
   return 1;
 }
 
-inline int
+int
 clh_lock_lock(clh_lock_t* lock) 
 {
   volatile clh_lock_node_t* local = clh_get_local(lock);
@@ -134,7 +134,7 @@ clh_lock_lock(clh_lock_t* lock)
 }
 
 
-inline int
+int
 clh_lock_unlock(clh_lock_t* lock) 
 {
   volatile clh_lock_node_t* local = clh_get_local(lock);
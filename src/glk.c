@@ -81,6 +81,8 @@ static inline int glk_ticket_lock_init(glk_ticket_lock_t* the_lock, const pthrea
 
 
 static inline int glk_mutex_lock(glk_mutex_lock_t* lock);
+static inline int glk_mutex_lock_spin(glk_mutex_lock_t* m);
+static inline int glk_mutex_lock_retry(glk_mutex_lock_t* m);
 static inline int glk_mutex_unlock(glk_mutex_lock_t* m);
 static inline int glk_mutex_lock_trylock(glk_mutex_lock_t* m);
 static inline int glk_mutex_init(glk_mutex_lock_t* m);
@@ -365,6 +367,7 @@ glk_ticket_adap(glk_t* lock, const uint32_t ticket)
 	{
 	  glk_dlog("[%p] %-7s ---> %-7s\n", lock, "TICKET", "MUTEX");
 	  lock->lock_type = MUTEX_LOCK;
+	  LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, MUTEX_LOCK);
 	}
       else
 	{
@@ -379,6 +382,7 @@ glk_ticket_adap(glk_t* lock, const uint32_t ticket)
 		  glk_dlog("[%p] %-7s ---> %-7s : queue_total %-4u - samples %-5u = %f\n",
 			     lock, "TICKET", "MUTEX", lock->queue_total, GLK_SAMPLE_NUM, ratio);
 		  lock->lock_type = MUTEX_LOCK;
+		  LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, MUTEX_LOCK);
 		  return;
 		}
 #endif
@@ -388,6 +392,7 @@ glk_ticket_adap(glk_t* lock, const uint32_t ticket)
 	      lock->queue_total = queue_total_local >> GLK_MEASURE_SHIFT;
 	      lock->num_acquired = GLK_NUM_ACQ_INIT;
 	      lock->lock_type = MCS_LOCK;
+	      LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, MCS_LOCK);
 	    }
 	  else 
 	    {
@@ -413,6 +418,7 @@ glk_mcs_adap(glk_t* lock, const int num_acq)
 	    {
 	      glk_dlog("[%p] %-7s ---> %-7s\n", lock, "MCS", "MUTEX");
 	      lock->lock_type = MUTEX_LOCK;
+	      LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, MUTEX_LOCK);
 	    }
 	  else
 	    {
@@ -424,6 +430,7 @@ glk_mcs_adap(glk_t* lock, const int num_acq)
 		  lock->queue_total = 0;
 		  lock->num_acquired = GLK_NUM_ACQ_INIT;
 		  lock->lock_type = TICKET_LOCK;
+		  LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, TICKET_LOCK);
 		}
 	      else 
 		{
@@ -447,6 +454,7 @@ glk_mutex_adap(glk_t* lock)
 	  lock->queue_total = 0;
 	  lock->num_acquired = 0;
 	  lock->lock_type = GLK_MP_TO_LOCK;
+	  LOCK_IN_TRACE_SYNC(LOCK_IN_TRACE_MODE, lock, GLK_MP_TO_LOCK);
 	  glk_dlog("[%p] %-7s ---> %-7s\n", lock, "MUTEX",
 		     (GLK_MP_TO_LOCK == MCS_LOCK) ? "MCS" : "TICKET");
 	}
@@ -498,6 +506,50 @@ glk_lock(glk_t* lock)
   return ret;
 }
 
+/* GLK acquire for callers that do not want to block in FUTEX_WAIT (see
+   lock_in_uring.h). In TICKET and MCS mode, glk_lock_spin acquires the lock
+   as glk_lock does. In MUTEX mode, it spins and, if the lock is still not
+   acquired, returns EBUSY with the lock marked as contended: the caller must
+   then wait on glk_lock_futex_word(lock) for 257 and call glk_lock_retry
+   after every wake-up. */
+static inline int
+glk_mutex_acquired(glk_t* lock)
+{
+  glk_mutex_adap(lock);
+  if (unlikely(lock->lock_type != MUTEX_LOCK))
+    {
+      glk_mutex_unlock(&lock->mutex_lock);
+      return glk_lock(lock);
+    }
+  return 0;
+}
+
+int
+glk_lock_spin(glk_t* lock)
+{
+  if (lock->lock_type != MUTEX_LOCK)
+    {
+      return glk_lock(lock);
+    }
+
+  glk_thread_cache_set(lock, MUTEX_LOCK);
+  if (glk_mutex_lock_spin(&lock->mutex_lock))
+    {
+      return EBUSY;
+    }
+  return glk_mutex_acquired(lock);
+}
+
+int
+glk_lock_retry(glk_t* lock)
+{
+  if (glk_mutex_lock_retry(&lock->mutex_lock))
+    {
+      return EBUSY;
+    }
+  return glk_mutex_acquired(lock);
+}
+
 int glk_destroy(glk_t *lock) {
   return 0;
 }
@@ -805,6 +857,8 @@ glk_is_free(glk_t* lock)
 static inline int
 sys_futex_glk_mutex(void* addr1, int op, int val1, struct timespec* timeout, void* addr2, int val3)
 {
+  LOCK_IN_TRACE_SYNC((op == FUTEX_WAIT_PRIVATE) ? LOCK_IN_TRACE_FUTEX_WAIT : LOCK_IN_TRACE_FUTEX_WAKE,
+		     addr1, 0);
   return syscall(SYS_futex, addr1, op, val1, timeout, addr2, val3);
 }
 
@@ -863,6 +917,38 @@ glk_mutex_lock(glk_mutex_lock_t* m)
 
 }
 
+/* glk_mutex_lock without the futex wait: returns EBUSY with the lock
+   marked as contended (257) if the caller has to wait */
+static inline int
+glk_mutex_lock_spin(glk_mutex_lock_t* m)
+{
+  if (!xchg_8(&m->l.b.locked, 1))
+    {
+      return 0;
+    }
+
+  const unsigned int time_spin = GLK_MUTEX_SPIN_TRIES_LOCK;
+  GLK_MUTEX_FOR_N_CYCLES(time_spin,
+			     if (!xchg_8(&m->l.b.locked, 1))
+			       {
+				 return 0;
+			       }
+			     PAUSE_IN();
+			     );
+
+  return glk_mutex_lock_retry(m);
+}
+
+static inline int
+glk_mutex_lock_retry(glk_mutex_lock_t* m)
+{
+  if (xchg_32(&m->l.u, 257) & 1)
+    {
+      return EBUSY;
+    }
+  return 0;
+}
+
 static inline int
 glk_mutex_unlock(glk_mutex_lock_t* m)
 {
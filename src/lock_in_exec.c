@@ -0,0 +1,91 @@
+/*
+ * File: lock_in_exec.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Per-thread records of the delegation API (see lock_in_exec.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#define LOCK_IN_EXEC_RECS_ONLY
+#include "lock_in_exec.h"
+
+lock_in_exec_rec_t lock_in_exec_recs[LOCK_IN_EXEC_MAX_THREADS];
+volatile uint32_t lock_in_exec_n = 0;
+__thread lock_in_exec_rec_t* lock_in_exec_me = NULL;
+void* volatile lock_in_exec_served[LOCK_IN_EXEC_MAX_SERVED];
+volatile uint32_t lock_in_exec_n_served = 0;
+volatile int lock_in_exec_server_stop_now = 0;
+
+__thread size_t lock_in_exec_n_ops = 0;
+__thread size_t lock_in_exec_n_batches = 0;
+size_t lock_in_exec_server_n_ops = 0;
+size_t lock_in_exec_server_n_batches = 0;
+
+static pthread_key_t lock_in_exec_key;
+static pthread_once_t lock_in_exec_once = PTHREAD_ONCE_INIT;
+
+static void
+lock_in_exec_unregister(void* rec)
+{
+  lock_in_exec_rec_t* r = (lock_in_exec_rec_t*) rec;
+  r->in_use = 0;
+}
+
+static void
+lock_in_exec_init()
+{
+  pthread_key_create(&lock_in_exec_key, lock_in_exec_unregister);
+}
+
+lock_in_exec_rec_t*
+lock_in_exec_register(void)
+{
+  pthread_once(&lock_in_exec_once, lock_in_exec_init);
+
+  uint32_t i;
+  for (i = 0; i < LOCK_IN_EXEC_MAX_THREADS; i++)
+    {
+      lock_in_exec_rec_t* r = lock_in_exec_recs + i;
+      if (!r->in_use && __sync_val_compare_and_swap(&r->in_use, 0, 1) == 0)
+	{
+	  r->pending = 0;
+	  uint32_t n;
+	  while ((n = lock_in_exec_n) <= i)
+	    {
+	      __sync_val_compare_and_swap(&lock_in_exec_n, n, i + 1);
+	    }
+	  pthread_setspecific(lock_in_exec_key, r);
+	  lock_in_exec_me = r;
+	  return r;
+	}
+    }
+
+  fprintf(stderr, "[LOCK_IN_EXEC] too many threads (max %d)\n", LOCK_IN_EXEC_MAX_THREADS);
+  exit(1);
+}
@@ -0,0 +1,313 @@
+/*
+ * File: lock_in_profile.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The per-thread tables and the dump of the call-site lock profiler
+ *      (see lock_in_profile.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "lock_in_profile.h"
+
+__thread lock_in_prof_thread_t* lock_in_prof_me = NULL;
+__thread uint32_t lock_in_prof_tick = 0;
+__thread uint32_t lock_in_prof_n_held = 0;
+__thread lock_in_prof_held_t lock_in_prof_held[LOCK_IN_PROF_MAX_HELD];
+
+static lock_in_prof_thread_t* volatile lock_in_prof_threads = NULL;
+static volatile int lock_in_prof_n_threads = 0;
+static pthread_once_t lock_in_prof_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t lock_in_prof_dump_lock = PTHREAD_MUTEX_INITIALIZER;
+static sem_t lock_in_prof_sem;
+
+static void
+lock_in_prof_dump_env()
+{
+  const char* path = getenv("LOCKIN_PROFILE");
+  FILE* f = (path != NULL) ? fopen(path, "a") : NULL;
+  lock_in_prof_dump((f != NULL) ? f : stderr);
+  if (f != NULL)
+    {
+      fclose(f);
+    }
+}
+
+static void
+lock_in_prof_sigusr2(int sig)
+{
+  (void) sig;
+  sem_post(&lock_in_prof_sem);	/* async-signal safe */
+}
+
+/* dumps the profile whenever SIGUSR2 arrives */
+static void*
+lock_in_prof_dumper(void* arg)
+{
+  (void) arg;
+  while (1)
+    {
+      if (sem_wait(&lock_in_prof_sem) == 0)
+	{
+	  lock_in_prof_dump_env();
+	}
+    }
+  return NULL;
+}
+
+static void
+lock_in_prof_init()
+{
+  sem_init(&lock_in_prof_sem, 0, 0);
+  struct sigaction sa;
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = lock_in_prof_sigusr2;
+  sa.sa_flags = SA_RESTART;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGUSR2, &sa, NULL);
+
+  pthread_t t;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&t, &attr, lock_in_prof_dumper, NULL) != 0)
+    {
+      fprintf(stderr, "[LOCK_IN_PROFILE] cannot start the SIGUSR2 dumper\n");
+    }
+  pthread_attr_destroy(&attr);
+  atexit(lock_in_prof_dump_env);
+}
+
+lock_in_prof_thread_t*
+lock_in_prof_register(void)
+{
+  pthread_once(&lock_in_prof_once, lock_in_prof_init);
+
+  lock_in_prof_thread_t* t = (lock_in_prof_thread_t*) calloc(1, sizeof(lock_in_prof_thread_t));
+  if (t == NULL)
+    {
+      fprintf(stderr, "[LOCK_IN_PROFILE] out of memory\n");
+      exit(1);
+    }
+  t->id = __sync_fetch_and_add(&lock_in_prof_n_threads, 1);
+  lock_in_prof_thread_t* head;
+  do
+    {
+      head = lock_in_prof_threads;
+      t->next = head;
+    }
+  while (__sync_val_compare_and_swap(&lock_in_prof_threads, head, t) != head);
+  lock_in_prof_me = t;
+  return t;
+}
+
+/* ******************************************************************************** */
+/* dump *************************************************************************** */
+/* ******************************************************************************** */
+
+static int
+lock_in_prof_comp_key(const void* a, const void* b)
+{
+  const lock_in_prof_entry_t* x = (const lock_in_prof_entry_t*) a;
+  const lock_in_prof_entry_t* y = (const lock_in_prof_entry_t*) b;
+  if (x->lock != y->lock) return ((uintptr_t) x->lock < (uintptr_t) y->lock) ? -1 : 1;
+  if (x->site != y->site) return ((uintptr_t) x->site < (uintptr_t) y->site) ? -1 : 1;
+  return 0;
+}
+
+static int
+lock_in_prof_comp_wait(const void* a, const void* b)
+{
+  const lock_in_prof_entry_t* x = (const lock_in_prof_entry_t*) a;
+  const lock_in_prof_entry_t* y = (const lock_in_prof_entry_t*) b;
+  if (x->wait_sum != y->wait_sum) return (x->wait_sum > y->wait_sum) ? -1 : 1;
+  return 0;
+}
+
+static void
+lock_in_prof_add(lock_in_prof_entry_t* d, const lock_in_prof_entry_t* s)
+{
+  d->n_wait += s->n_wait;
+  d->n_hold += s->n_hold;
+  d->wait_sum += s->wait_sum;
+  d->hold_sum += s->hold_sum;
+  int b;
+  for (b = 0; b < LOCK_IN_PROF_BUCKETS; b++)
+    {
+      d->wait_hist[b] += s->wait_hist[b];
+      d->hold_hist[b] += s->hold_hist[b];
+    }
+}
+
+/* upper bound of the bucket that contains the perc-th percentile */
+static uint64_t
+lock_in_prof_perc(const uint64_t* hist, const uint64_t n, const double perc)
+{
+  const uint64_t target = (uint64_t) (n * perc / 100.0);
+  uint64_t sum = 0;
+  int b;
+  for (b = 0; b < LOCK_IN_PROF_BUCKETS; b++)
+    {
+      sum += hist[b];
+      if (sum > target)
+	{
+	  return (b == 0) ? 0 : (1ULL << b);
+	}
+    }
+  return 1ULL << (LOCK_IN_PROF_BUCKETS - 1);
+}
+
+static void
+lock_in_prof_print_hist(FILE* f, const char* what, const uint64_t* hist)
+{
+  fprintf(f, "#   %-5s:", what);
+  int b;
+  for (b = 0; b < LOCK_IN_PROF_BUCKETS; b++)
+    {
+      if (hist[b])
+	{
+	  fprintf(f, " <2^%d:%llu", b, (unsigned long long) hist[b]);
+	}
+    }
+  fprintf(f, "\n");
+}
+
+static void
+lock_in_prof_print_row(FILE* f, const lock_in_prof_entry_t* e, const uint64_t wait_total)
+{
+  const double share = wait_total ? 100.0 * e->wait_sum / wait_total : 0;
+  fprintf(f, "%#-16llx %10llu %6.2f%% %10llu %10llu %10llu %10llu %10llu  ",
+	  (unsigned long long) (uintptr_t) e->lock, 
+	  (unsigned long long) e->n_wait * LOCK_IN_PROF_SAMPLE, share,
+	  (unsigned long long) (e->n_wait ? e->wait_sum / e->n_wait : 0),
+	  (unsigned long long) lock_in_prof_perc(e->wait_hist, e->n_wait, 50),
+	  (unsigned long long) lock_in_prof_perc(e->wait_hist, e->n_wait, 99),
+	  (unsigned long long) (e->n_hold ? e->hold_sum / e->n_hold : 0),
+	  (unsigned long long) lock_in_prof_perc(e->hold_hist, e->n_hold, 99));
+}
+
+void
+lock_in_prof_dump(FILE* f)
+{
+  pthread_mutex_lock(&lock_in_prof_dump_lock);
+
+  size_t n = 0, cap = 0, dropped = 0;
+  lock_in_prof_thread_t* t;
+  for (t = lock_in_prof_threads; t != NULL; t = t->next)
+    {
+      cap += LOCK_IN_PROF_TABLE;
+    }
+  lock_in_prof_entry_t* all = (lock_in_prof_entry_t*) calloc(cap + 1, sizeof(lock_in_prof_entry_t));
+  if (all == NULL)
+    {
+      pthread_mutex_unlock(&lock_in_prof_dump_lock);
+      return;
+    }
+
+  for (t = lock_in_prof_threads; t != NULL && n < cap; t = t->next)
+    {
+      dropped += t->n_dropped;
+      int i;
+      for (i = 0; i < LOCK_IN_PROF_TABLE && n < cap; i++)
+	{
+	  if (t->table[i].lock != NULL)
+	    {
+	      all[n++] = t->table[i];
+	    }
+	}
+    }
+
+  /* merge the entries of the same (lock, site) */
+  qsort(all, n, sizeof(lock_in_prof_entry_t), lock_in_prof_comp_key);
+  size_t m = 0, i;
+  uint64_t wait_total = 0;
+  for (i = 0; i < n; i++)
+    {
+      if (m > 0 && all[m - 1].lock == all[i].lock && all[m - 1].site == all[i].site)
+	{
+	  lock_in_prof_add(all + m - 1, all + i);
+	}
+      else
+	{
+	  all[m++] = all[i];
+	}
+      wait_total += all[i].wait_sum;
+    }
+
+  /* per lock: the sum of its call sites (all is sorted by lock) */
+  lock_in_prof_entry_t* locks = (lock_in_prof_entry_t*) calloc(m + 1, sizeof(lock_in_prof_entry_t));
+  size_t l = 0;
+  if (locks != NULL)
+    {
+      for (i = 0; i < m; i++)
+	{
+	  if (l == 0 || locks[l - 1].lock != all[i].lock)
+	    {
+	      locks[l].lock = all[i].lock;
+	      l++;
+	    }
+	  lock_in_prof_add(locks + l - 1, all + i);
+	}
+      qsort(locks, l, sizeof(lock_in_prof_entry_t), lock_in_prof_comp_wait);
+    }
+  qsort(all, m, sizeof(lock_in_prof_entry_t), lock_in_prof_comp_wait);
+
+  fprintf(f, "## lock profile : pid %d : %d threads : 1/%d acquisitions sampled : %zu dropped : times in cycles\n",
+	  getpid(), lock_in_prof_n_threads, LOCK_IN_PROF_SAMPLE, dropped);
+  const char* header = "%-17s %10s %7s %10s %10s %10s %10s %10s  %s\n";
+  fprintf(f, "#per lock\n");
+  fprintf(f, header, "#lock", "acquires", "wait%", "wait-avg", "wait-p50", "wait-p99",
+	  "hold-avg", "hold-p99", "");
+  for (i = 0; i < l; i++)
+    {
+      lock_in_prof_print_row(f, locks + i, wait_total);
+      fprintf(f, "\n");
+    }
+
+  fprintf(f, "#per call site\n");
+  fprintf(f, header, "#lock", "acquires", "wait%", "wait-avg", "wait-p50", "wait-p99",
+	  "hold-avg", "hold-p99", "site");
+  for (i = 0; i < m; i++)
+    {
+      const lock_in_prof_entry_t* e = all + i;
+      lock_in_prof_print_row(f, e, wait_total);
+      fprintf(f, "%s:%d (%s)\n", e->site->file, e->site->line, e->site->func);
+      lock_in_prof_print_hist(f, "wait", e->wait_hist);
+      lock_in_prof_print_hist(f, "hold", e->hold_hist);
+    }
+  fflush(f);
+
+  free(locks);
+  free(all);
+  pthread_mutex_unlock(&lock_in_prof_dump_lock);
+}
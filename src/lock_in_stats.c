@@ -0,0 +1,147 @@
+/*
+ * File: lock_in_stats.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The shared-memory segment of the per-lock statistics (see lock_in_stats.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "lock_in_stats.h"
+
+lock_in_stats_seg_t* lock_in_stats_seg = NULL;
+
+static pthread_once_t lock_in_stats_once = PTHREAD_ONCE_INIT;
+static char lock_in_stats_name[64];
+static char lock_in_stats_algo[sizeof(((lock_in_stats_seg_t*) 0)->algo)];
+static volatile uint32_t lock_in_stats_live = 0; /* slots currently held */
+
+static void
+lock_in_stats_unlink()
+{
+  shm_unlink(lock_in_stats_name);
+}
+
+static void
+lock_in_stats_init()
+{
+  lock_in_stats_shm_name(lock_in_stats_name, sizeof(lock_in_stats_name), getpid());
+  int fd = shm_open(lock_in_stats_name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+    {
+      perror("[LOCK_IN_STATS] shm_open");
+      return;
+    }
+  if (ftruncate(fd, sizeof(lock_in_stats_seg_t)) != 0)
+    {
+      perror("[LOCK_IN_STATS] ftruncate");
+      close(fd);
+      shm_unlink(lock_in_stats_name);
+      return;
+    }
+  void* m = mmap(NULL, sizeof(lock_in_stats_seg_t), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED)
+    {
+      perror("[LOCK_IN_STATS] mmap");
+      shm_unlink(lock_in_stats_name);
+      return;
+    }
+
+  lock_in_stats_seg_t* s = (lock_in_stats_seg_t*) m;
+  s->version = LOCK_IN_STATS_VERSION;
+  s->n_slots = LOCK_IN_STATS_SLOTS;
+  s->sample = LOCK_IN_STATS_SAMPLE;
+  s->contended = LOCK_IN_STATS_CONTENDED;
+  s->pid = getpid();
+  snprintf(s->algo, sizeof(s->algo), "%s", lock_in_stats_algo);
+  __sync_synchronize();
+  s->magic = LOCK_IN_STATS_MAGIC;
+  lock_in_stats_seg = s;
+  atexit(lock_in_stats_unlink);
+}
+
+lock_in_stats_slot_t*
+lock_in_stats_register(const void* lock, const char* algo)
+{
+  if (lock_in_stats_seg == NULL)
+    {
+      snprintf(lock_in_stats_algo, sizeof(lock_in_stats_algo), "%s", algo);
+      pthread_once(&lock_in_stats_once, lock_in_stats_init);
+    }
+  lock_in_stats_seg_t* s = lock_in_stats_seg;
+  if (s != NULL)
+    {
+      /* reserve a slot first, so that a full segment is not scanned */
+      if (__sync_fetch_and_add(&lock_in_stats_live, 1) >= LOCK_IN_STATS_SLOTS)
+	{
+	  __sync_fetch_and_sub(&lock_in_stats_live, 1);
+	  __sync_fetch_and_add(&s->n_dropped, 1);
+	  return NULL;
+	}
+      uint32_t i;
+      for (i = 0; i < LOCK_IN_STATS_SLOTS; i++)
+	{
+	  lock_in_stats_slot_t* slot = s->slots + i;
+	  if (slot->lock == 0 && __sync_val_compare_and_swap(&slot->lock, 0, (uintptr_t) lock) == 0)
+	    {
+	      slot->n_acq = 0;
+	      slot->n_contended = 0;
+	      slot->n_futex_wait = 0;
+	      slot->n_mode_switch = 0;
+	      slot->wait_ewma = 0;
+	      slot->hold_ewma = 0;
+	      slot->mode = 0;
+	      slot->gen++;
+	      uint32_t n;
+	      while ((n = s->n_used) <= i)
+		{
+		  __sync_val_compare_and_swap(&s->n_used, n, i + 1);
+		}
+	      return slot;
+	    }
+	}
+      __sync_fetch_and_sub(&lock_in_stats_live, 1);
+      __sync_fetch_and_add(&s->n_dropped, 1);
+    }
+  return NULL;
+}
+
+void
+lock_in_stats_unregister(lock_in_stats_slot_t* slot)
+{
+  if (slot != NULL)
+    {
+      slot->lock = 0;
+      __sync_fetch_and_sub(&lock_in_stats_live, 1);
+    }
+}
@@ -0,0 +1,200 @@
+/*
+ * File: lock_in_trace.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The per-thread rings and the background flusher of the lock-event
+ *      tracer (see lock_in_trace.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "lock_in_trace.h"
+
+__thread lock_in_trace_thread_t* lock_in_trace_me = NULL;
+__thread const void* lock_in_trace_cur = NULL;
+
+static lock_in_trace_thread_t* volatile lock_in_trace_threads = NULL;
+static volatile uint32_t lock_in_trace_n_threads = 0;
+static pthread_once_t lock_in_trace_once = PTHREAD_ONCE_INIT;
+static pthread_mutex_t lock_in_trace_flush_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_t lock_in_trace_flusher_thread;
+static volatile int lock_in_trace_stop = 0;
+static FILE* lock_in_trace_file = NULL;
+static const char* lock_in_trace_algo = "";
+static size_t lock_in_trace_n_events = 0;
+static size_t lock_in_trace_n_dropped = 0;
+
+static double
+lock_in_trace_cycles_per_us()
+{
+  struct timespec s, e, d = { 0, 10000000 };
+  clock_gettime(CLOCK_MONOTONIC, &s);
+  const uint64_t t0 = lock_in_trace_ticks();
+  nanosleep(&d, NULL);
+  const uint64_t t1 = lock_in_trace_ticks();
+  clock_gettime(CLOCK_MONOTONIC, &e);
+  const double us = (e.tv_sec - s.tv_sec) * 1e6 + (e.tv_nsec - s.tv_nsec) / 1e3;
+  return (t1 - t0) / us;
+}
+
+static void
+lock_in_trace_write(const void* buf, const size_t size)
+{
+  if (size > 0 && fwrite(buf, size, 1, lock_in_trace_file) != 1)
+    {
+      fprintf(stderr, "[LOCK_IN_TRACE] write error: %s\n", strerror(errno));
+    }
+}
+
+/* moves the events of every ring to the file */
+static void
+lock_in_trace_flush()
+{
+  pthread_mutex_lock(&lock_in_trace_flush_lock);
+  lock_in_trace_thread_t* t;
+  for (t = lock_in_trace_threads; t != NULL; t = t->next)
+    {
+      const uint64_t tail = t->tail;
+      const uint64_t head = t->head;
+      asm volatile ("" ::: "memory");
+      const uint32_t dropped = t->n_dropped;
+      if (head == tail && dropped == t->n_dropped_flushed)
+	{
+	  continue;
+	}
+
+      lock_in_trace_chunk_t c;
+      c.magic = LOCK_IN_TRACE_CHUNK;
+      c.thread = t->id;
+      c.n = (uint32_t) (head - tail);
+      c.n_dropped = dropped - t->n_dropped_flushed;
+      lock_in_trace_write(&c, sizeof(c));
+
+      const uint64_t from = tail & (LOCK_IN_TRACE_RING - 1);
+      const uint64_t first = (from + c.n <= LOCK_IN_TRACE_RING) ? c.n : LOCK_IN_TRACE_RING - from;
+      lock_in_trace_write(t->ring + from, first * sizeof(lock_in_trace_ev_t));
+      lock_in_trace_write(t->ring, (c.n - first) * sizeof(lock_in_trace_ev_t));
+
+      asm volatile ("" ::: "memory");
+      t->tail = head;
+      t->n_dropped_flushed = dropped;
+      lock_in_trace_n_events += c.n;
+      lock_in_trace_n_dropped += c.n_dropped;
+    }
+  pthread_mutex_unlock(&lock_in_trace_flush_lock);
+}
+
+static void*
+lock_in_trace_flusher(void* arg)
+{
+  (void) arg;
+  struct timespec d = { LOCK_IN_TRACE_FLUSH_US / 1000000, (LOCK_IN_TRACE_FLUSH_US % 1000000) * 1000 };
+  while (!lock_in_trace_stop)
+    {
+      nanosleep(&d, NULL);
+      lock_in_trace_flush();
+    }
+  return NULL;
+}
+
+static void
+lock_in_trace_exit()
+{
+  lock_in_trace_stop = 1;
+  pthread_join(lock_in_trace_flusher_thread, NULL);
+  lock_in_trace_flush();
+  fclose(lock_in_trace_file);
+  fprintf(stderr, "[LOCK_IN_TRACE] %zu events (%zu dropped) of %u threads\n",
+	  lock_in_trace_n_events, lock_in_trace_n_dropped, lock_in_trace_n_threads);
+}
+
+static void
+lock_in_trace_init()
+{
+  char name[64];
+  const char* path = getenv("LOCKIN_TRACE");
+  if (path == NULL)
+    {
+      snprintf(name, sizeof(name), "lockin-trace.%d.bin", getpid());
+      path = name;
+    }
+  lock_in_trace_file = fopen(path, "w");
+  if (lock_in_trace_file == NULL)
+    {
+      fprintf(stderr, "[LOCK_IN_TRACE] cannot open %s: %s\n", path, strerror(errno));
+      exit(1);
+    }
+  setvbuf(lock_in_trace_file, NULL, _IOFBF, 1 << 20);
+
+  lock_in_trace_hdr_t h;
+  memset(&h, 0, sizeof(h));
+  h.magic = LOCK_IN_TRACE_MAGIC;
+  h.version = LOCK_IN_TRACE_VERSION;
+  h.ev_size = sizeof(lock_in_trace_ev_t);
+  h.pid = getpid();
+  h.ring = LOCK_IN_TRACE_RING;
+  h.cycles_per_us = lock_in_trace_cycles_per_us();
+  strncpy(h.algo, lock_in_trace_algo, sizeof(h.algo) - 1);
+  lock_in_trace_write(&h, sizeof(h));
+
+  if (pthread_create(&lock_in_trace_flusher_thread, NULL, lock_in_trace_flusher, NULL) != 0)
+    {
+      fprintf(stderr, "[LOCK_IN_TRACE] cannot start the flusher\n");
+      exit(1);
+    }
+  atexit(lock_in_trace_exit);
+}
+
+lock_in_trace_thread_t*
+lock_in_trace_register(const char* algo)
+{
+  lock_in_trace_algo = algo;
+  pthread_once(&lock_in_trace_once, lock_in_trace_init);
+
+  lock_in_trace_thread_t* t = NULL;
+  if (posix_memalign((void**) &t, 64, sizeof(lock_in_trace_thread_t)) != 0)
+    {
+      fprintf(stderr, "[LOCK_IN_TRACE] out of memory\n");
+      exit(1);
+    }
+  memset(t, 0, sizeof(lock_in_trace_thread_t));
+  t->id = __sync_fetch_and_add(&lock_in_trace_n_threads, 1);
+  lock_in_trace_thread_t* head;
+  do
+    {
+      head = lock_in_trace_threads;
+      t->next = head;
+    }
+  while (__sync_val_compare_and_swap(&lock_in_trace_threads, head, t) != head);
+  lock_in_trace_me = t;
+  return t;
+}
@@ -0,0 +1,270 @@
+/*
+ * File: lockin_stat.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      lockin-stat: prints the live per-lock statistics of a process that is built
+ *      with LOCK_IN_STATS=1 (see stats_in.h), from its shared-memory segment.
+ *
+ *        lockin-stat                      lists the processes with a segment
+ *        lockin-stat PID [-i ms] [-t N]   prints the top-N locks (by acquisitions),
+ *                                         every ms milliseconds (rates per second)
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <getopt.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "lock_in_stats.h"
+
+#define LOCKIN_STAT_TOP 20
+
+typedef struct lockin_stat_row
+{
+  uint64_t lock;
+  uint32_t gen;
+  double n_acq;
+  double n_contended;
+  double n_futex_wait;
+  double n_mode_switch;
+  uint64_t wait_ewma;
+  uint64_t hold_ewma;
+  uint32_t mode;
+} lockin_stat_row_t;
+
+static int
+lockin_stat_comp(const void* a, const void* b)
+{
+  const double x = ((const lockin_stat_row_t*) a)->n_acq;
+  const double y = ((const lockin_stat_row_t*) b)->n_acq;
+  if (x < y) return 1;
+  if (x > y) return -1;
+  return 0;
+}
+
+static void
+lockin_stat_list()
+{
+  DIR* d = opendir("/dev/shm");
+  if (d == NULL)
+    {
+      perror("opendir /dev/shm");
+      exit(1);
+    }
+  const char* prefix = LOCK_IN_STATS_SHM_PREFIX + 1;
+  struct dirent* e;
+  int n = 0;
+  while ((e = readdir(d)) != NULL)
+    {
+      if (strncmp(e->d_name, prefix, strlen(prefix)) == 0)
+	{
+	  const int pid = atoi(e->d_name + strlen(prefix));
+	  printf("%-8d %s%s\n", pid, (kill(pid, 0) == 0) ? "" : "(stale) ", e->d_name);
+	  n++;
+	}
+    }
+  closedir(d);
+  if (n == 0)
+    {
+      printf("no LOCK_IN_STATS processes\n");
+    }
+}
+
+static const lock_in_stats_seg_t*
+lockin_stat_open(const int pid)
+{
+  char name[64];
+  lock_in_stats_shm_name(name, sizeof(name), pid);
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    {
+      fprintf(stderr, "no stats segment %s (is the process built with LOCK_IN_STATS=1?)\n", name);
+      exit(1);
+    }
+  void* m = mmap(NULL, sizeof(lock_in_stats_seg_t), PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (m == MAP_FAILED)
+    {
+      perror("mmap");
+      exit(1);
+    }
+  const lock_in_stats_seg_t* s = (const lock_in_stats_seg_t*) m;
+  if (s->magic != LOCK_IN_STATS_MAGIC || s->version != LOCK_IN_STATS_VERSION)
+    {
+      fprintf(stderr, "%s: not a (version %d) stats segment\n", name, LOCK_IN_STATS_VERSION);
+      exit(1);
+    }
+  return s;
+}
+
+/* copies the used slots; the counters are estimated totals */
+static size_t
+lockin_stat_snapshot(const lock_in_stats_seg_t* s, lockin_stat_row_t* rows)
+{
+  size_t n = 0;
+  uint32_t i;
+  for (i = 0; i < s->n_used; i++)
+    {
+      const lock_in_stats_slot_t* slot = s->slots + i;
+      if (slot->lock == 0)
+	{
+	  continue;
+	}
+      lockin_stat_row_t* r = rows + n++;
+      r->lock = slot->lock;
+      r->gen = slot->gen;
+      r->n_acq = (double) slot->n_acq * s->sample;
+      r->n_contended = (double) slot->n_contended * s->sample;
+      r->n_futex_wait = (double) slot->n_futex_wait * s->sample;
+      r->n_mode_switch = (double) slot->n_mode_switch;
+      r->wait_ewma = slot->wait_ewma;
+      r->hold_ewma = slot->hold_ewma;
+      r->mode = slot->mode;
+    }
+  return n;
+}
+
+static const lockin_stat_row_t*
+lockin_stat_find(const lockin_stat_row_t* rows, const size_t n, const lockin_stat_row_t* r)
+{
+  size_t i;
+  for (i = 0; i < n; i++)
+    {
+      if (rows[i].lock == r->lock && rows[i].gen == r->gen)
+	{
+	  return rows + i;
+	}
+    }
+  return NULL;
+}
+
+/* prints cur (or cur - prev per second, if prev != NULL) */
+static void
+lockin_stat_print(const lock_in_stats_seg_t* s, lockin_stat_row_t* cur, const size_t n,
+		  const lockin_stat_row_t* prev, const size_t prev_n, const double secs, 
+		  const int top)
+{
+  lockin_stat_row_t* rows = (lockin_stat_row_t*) malloc((n + 1) * sizeof(lockin_stat_row_t));
+  assert(rows != NULL);
+  size_t i;
+  for (i = 0; i < n; i++)
+    {
+      rows[i] = cur[i];
+      const lockin_stat_row_t* p = (prev != NULL) ? lockin_stat_find(prev, prev_n, cur + i) : NULL;
+      if (prev != NULL)
+	{
+	  rows[i].n_acq = (rows[i].n_acq - (p ? p->n_acq : 0)) / secs;
+	  rows[i].n_contended = (rows[i].n_contended - (p ? p->n_contended : 0)) / secs;
+	  rows[i].n_futex_wait = (rows[i].n_futex_wait - (p ? p->n_futex_wait : 0)) / secs;
+	  rows[i].n_mode_switch = rows[i].n_mode_switch - (p ? p->n_mode_switch : 0);
+	}
+    }
+  qsort(rows, n, sizeof(lockin_stat_row_t), lockin_stat_comp);
+
+  printf("## pid %d : %s : %u locks (%u dropped) : 1/%u acquisitions sampled%s\n",
+	 s->pid, s->algo, (uint32_t) n, s->n_dropped, s->sample, 
+	 (prev != NULL) ? " : per second" : "");
+  printf("#%-17s %14s %9s %12s %6s %6s %10s %10s\n", "lock", "acquires", "contended",
+	 "futex-waits", "modesw", "mode", "wait(cyc)", "hold(cyc)");
+  for (i = 0; i < n && i < top; i++)
+    {
+      const lockin_stat_row_t* r = rows + i;
+      const double cont = (r->n_acq > 0) ? 100.0 * r->n_contended / r->n_acq : 0;
+      printf("%#-18llx %14.0f %8.2f%% %12.0f %6.0f %6u %10llu %10llu\n",
+	     (unsigned long long) r->lock, r->n_acq, cont, r->n_futex_wait, 
+	     r->n_mode_switch, r->mode, 
+	     (unsigned long long) r->wait_ewma, (unsigned long long) r->hold_ewma);
+    }
+  fflush(stdout);
+  free(rows);
+}
+
+int
+main(int argc, char** argv)
+{
+  int interval = 0, top = LOCKIN_STAT_TOP, c;
+  while ((c = getopt(argc, argv, "hi:t:")) != -1)
+    {
+      switch (c)
+	{
+	case 'i':
+	  interval = atoi(optarg);
+	  break;
+	case 't':
+	  top = atoi(optarg);
+	  break;
+	default:
+	  printf("Usage:\n"
+		 "  lockin-stat                    list the processes with stats\n"
+		 "  lockin-stat PID [-i ms] [-t N] print the top-N (default=%d) locks of PID\n"
+		 "                                 (every ms milliseconds, as rates)\n",
+		 LOCKIN_STAT_TOP);
+	  exit(c != 'h');
+	}
+    }
+
+  if (optind >= argc)
+    {
+      lockin_stat_list();
+      return 0;
+    }
+
+  const int pid = atoi(argv[optind]);
+  const lock_in_stats_seg_t* s = lockin_stat_open(pid);
+  lockin_stat_row_t* cur = (lockin_stat_row_t*) malloc(LOCK_IN_STATS_SLOTS * sizeof(lockin_stat_row_t));
+  lockin_stat_row_t* prev = (lockin_stat_row_t*) malloc(LOCK_IN_STATS_SLOTS * sizeof(lockin_stat_row_t));
+  assert(cur != NULL && prev != NULL);
+
+  size_t n = lockin_stat_snapshot(s, cur);
+  if (interval <= 0)
+    {
+      lockin_stat_print(s, cur, n, NULL, 0, 0, top);
+      return 0;
+    }
+
+  struct timespec ts = { .tv_sec = interval / 1000, .tv_nsec = (interval % 1000) * 1000000L };
+  while (kill(pid, 0) == 0)
+    {
+      lockin_stat_row_t* t = prev;
+      prev = cur;
+      cur = t;
+      const size_t prev_n = n;
+      nanosleep(&ts, NULL);
+      n = lockin_stat_snapshot(s, cur);
+      lockin_stat_print(s, cur, n, prev, prev_n, interval / 1000.0, top);
+    }
+
+  free(cur);
+  free(prev);
+  return 0;
+}
@@ -0,0 +1,885 @@
+/*
+ * File: lockin_trace.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      Offline analyzer of the binary lock-event traces of LOCK_IN_TRACE=1
+ *      (see lock_in_trace.h).
+ *
+ *      Replays the events of all threads in TSC order and reports:
+ *        - per lock: acquisitions, utilization (time held / trace span), wait
+ *          and hold times, handoffs (acquisitions by a thread that was already
+ *          waiting at the previous release) and the longest chain of them, futex
+ *          calls, GLK mode switches, and long holds (possible lock-holder
+ *          preemption);
+ *        - convoy episodes: periods of at least -k waiters on a lock that last for
+ *          at least -m acquisitions;
+ *        - the critical path: walking back from the last event, whenever the
+ *          current thread acquired a lock by a handoff, the path jumps to the
+ *          releasing thread at the time of the release. The time on the path is
+ *          split in holds of each lock, handoff latencies of each lock, and the
+ *          rest (outside locks).
+ *
+ *      With -o FILE, the trace is also exported in the replay format of
+ *      stress_replay_in (see lock_in_replay.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <assert.h>
+#include <getopt.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "lock_in_trace.h"
+#include "lock_in_replay.h"
+
+#define LOCKIN_TRACE_TOP       10
+#define LOCKIN_TRACE_WAITERS   2 /* convoy: at least that many waiters */
+#define LOCKIN_TRACE_MIN_ACQ   4 /* ... for at least that many acquisitions */
+#define LOCKIN_TRACE_LONG_US   100 /* long hold */
+#define LOCKIN_TRACE_MAX_HELD  16
+
+typedef struct tr_ev
+{
+  uint64_t tsc;
+  uint64_t word;
+  uint32_t thread;
+  uint32_t seq;
+} tr_ev_t;
+
+typedef struct tr_hold
+{
+  uint32_t lock;
+  uint64_t acquired;
+  uint64_t released;
+} tr_hold_t;
+
+/* thread acquired lock at tsc, by a handoff from thread from at from_tsc */
+typedef struct tr_edge
+{
+  uint64_t tsc;
+  uint64_t from_tsc;
+  uint32_t from;
+  uint32_t lock;
+} tr_edge_t;
+
+typedef struct tr_convoy
+{
+  uint64_t lock;
+  uint32_t max_waiters;
+  uint64_t start;
+  uint64_t duration;
+  uint64_t n_acq;
+} tr_convoy_t;
+
+typedef struct tr_thread
+{
+  uint64_t n_dropped;
+  uint64_t first;
+  uint64_t last;
+  uint64_t max_hold;
+  uint64_t start;		/* of the pending acquire (0 if none) */
+  uint32_t start_lock;
+  uint32_t n_held;
+  tr_hold_t held[LOCKIN_TRACE_MAX_HELD];
+  tr_hold_t* holds;
+  size_t n_holds, size_holds;
+  tr_edge_t* edges;
+  size_t n_edges, size_edges;
+} tr_thread_t;
+
+typedef struct tr_lock
+{
+  uint64_t addr;
+  uint64_t n_acq, n_try, n_handoff, n_futex_wait, n_futex_wake, n_mode, n_long, n_timeout;
+  uint64_t wait_sum, wait_max, hold_sum, hold_max, handoff_sum;
+  uint32_t waiters, max_waiters, chain, max_chain;
+  int64_t last_rel_thread;
+  uint64_t last_rel;
+  /* the current convoy episode */
+  uint64_t cv_start, cv_acq;
+  uint32_t cv_max;
+  /* all the convoy episodes */
+  uint64_t n_convoys, convoy_time;
+  tr_convoy_t longest;
+  /* on the critical path */
+  uint64_t cp_hold, cp_handoff;
+} tr_lock_t;
+
+static tr_thread_t* threads = NULL;
+static uint32_t n_threads = 0;
+static tr_lock_t* locks = NULL;
+static uint32_t n_locks = 0, size_locks = 0;
+static uint32_t* lock_index = NULL;	/* open addressing: lock + 1 (0: empty) */
+static uint32_t size_index = 0;
+static tr_convoy_t* convoys = NULL;
+static size_t n_convoys = 0, size_convoys = 0;
+
+#define GROW(ptr, n, size)						\
+  if ((n) == (size))							\
+    {									\
+      (size) = ((size) == 0) ? 1024 : 2 * (size);			\
+      (ptr) = realloc((ptr), (size) * sizeof(*(ptr)));			\
+      assert((ptr) != NULL);						\
+    }
+
+static tr_thread_t*
+tr_thread(const uint32_t id)
+{
+  if (id >= n_threads)
+    {
+      threads = realloc(threads, (id + 1) * sizeof(tr_thread_t));
+      assert(threads != NULL);
+      memset(threads + n_threads, 0, (id + 1 - n_threads) * sizeof(tr_thread_t));
+      n_threads = id + 1;
+    }
+  return threads + id;
+}
+
+static uint32_t
+tr_hash(const uint64_t addr)
+{
+  uint64_t h = addr >> 3;
+  h ^= h >> 17;
+  h *= 0x9e3779b97f4a7c15ULL;
+  return (uint32_t) (h >> 32);
+}
+
+static void
+tr_index_grow()
+{
+  free(lock_index);
+  size_index = (size_index == 0) ? 1024 : 2 * size_index;
+  lock_index = calloc(size_index, sizeof(uint32_t));
+  assert(lock_index != NULL);
+  uint32_t i;
+  for (i = 0; i < n_locks; i++)
+    {
+      uint32_t h = tr_hash(locks[i].addr) & (size_index - 1);
+      while (lock_index[h] != 0)
+	{
+	  h = (h + 1) & (size_index - 1);
+	}
+      lock_index[h] = i + 1;
+    }
+}
+
+static uint32_t
+tr_lock(const uint64_t addr)
+{
+  if (2 * (n_locks + 1) > size_index)
+    {
+      tr_index_grow();
+    }
+  uint32_t h = tr_hash(addr) & (size_index - 1);
+  while (lock_index[h] != 0)
+    {
+      if (locks[lock_index[h] - 1].addr == addr)
+	{
+	  return lock_index[h] - 1;
+	}
+      h = (h + 1) & (size_index - 1);
+    }
+  GROW(locks, n_locks, size_locks);
+  tr_lock_t* l = locks + n_locks;
+  memset(l, 0, sizeof(tr_lock_t));
+  l->addr = addr;
+  l->last_rel_thread = -1;
+  lock_index[h] = ++n_locks;
+  return n_locks - 1;
+}
+
+static int
+tr_comp_ev(const void* a, const void* b)
+{
+  const tr_ev_t* x = (const tr_ev_t*) a;
+  const tr_ev_t* y = (const tr_ev_t*) b;
+  if (x->tsc != y->tsc)
+    {
+      return (x->tsc < y->tsc) ? -1 : 1;
+    }
+  return (x->seq < y->seq) ? -1 : (x->seq > y->seq);
+}
+
+static tr_ev_t*
+tr_read(const char* path, lock_in_trace_hdr_t* hdr, size_t* n_events)
+{
+  FILE* f = fopen(path, "r");
+  if (f == NULL)
+    {
+      perror(path);
+      exit(1);
+    }
+  if (fread(hdr, sizeof(*hdr), 1, f) != 1 || hdr->magic != LOCK_IN_TRACE_MAGIC ||
+      hdr->version != LOCK_IN_TRACE_VERSION || hdr->ev_size != sizeof(lock_in_trace_ev_t))
+    {
+      fprintf(stderr, "%s: not a (version %d) lock trace\n", path, LOCK_IN_TRACE_VERSION);
+      exit(1);
+    }
+
+  tr_ev_t* evs = NULL;
+  size_t n = 0, size = 0;
+  lock_in_trace_ev_t* buf = malloc(hdr->ring * sizeof(lock_in_trace_ev_t));
+  assert(buf != NULL);
+  lock_in_trace_chunk_t c;
+  while (fread(&c, sizeof(c), 1, f) == 1)
+    {
+      if (c.magic != LOCK_IN_TRACE_CHUNK || c.n > hdr->ring ||
+	  fread(buf, sizeof(lock_in_trace_ev_t), c.n, f) != c.n)
+	{
+	  fprintf(stderr, "%s: truncated trace, ignoring the rest\n", path);
+	  break;
+	}
+      tr_thread(c.thread)->n_dropped += c.n_dropped;
+      uint32_t i;
+      for (i = 0; i < c.n; i++)
+	{
+	  GROW(evs, n, size);
+	  evs[n].tsc = buf[i].tsc;
+	  evs[n].word = buf[i].word;
+	  evs[n].thread = c.thread;
+	  evs[n].seq = (uint32_t) n;
+	  n++;
+	}
+    }
+  free(buf);
+  fclose(f);
+  qsort(evs, n, sizeof(tr_ev_t), tr_comp_ev);
+  *n_events = n;
+  return evs;
+}
+
+static void
+tr_convoy_end(tr_lock_t* l, const uint64_t now, const uint64_t min_acq)
+{
+  if (l->cv_start != 0 && l->cv_acq >= min_acq)
+    {
+      GROW(convoys, n_convoys, size_convoys);
+      tr_convoy_t* c = convoys + n_convoys++;
+      c->lock = l->addr;
+      c->max_waiters = l->cv_max;
+      c->start = l->cv_start;
+      c->duration = now - l->cv_start;
+      c->n_acq = l->cv_acq;
+      l->n_convoys++;
+      l->convoy_time += c->duration;
+      if (c->duration > l->longest.duration)
+	{
+	  l->longest = *c;
+	}
+    }
+  l->cv_start = 0;
+}
+
+static void
+tr_acquired(tr_thread_t* t, const uint32_t id, tr_lock_t* l, const tr_ev_t* e, const int is_try)
+{
+  const uint32_t li = (uint32_t) (l - locks);
+  const uint64_t start = (!is_try && t->start != 0 && t->start_lock == li) ? t->start : e->tsc;
+  if (!is_try && t->start != 0 && t->start_lock == li)
+    {
+      l->waiters--;
+      t->start = 0;
+    }
+  const uint64_t wait = e->tsc - start;
+  l->n_acq++;
+  l->n_try += is_try;
+  l->wait_sum += wait;
+  if (wait > l->wait_max)
+    {
+      l->wait_max = wait;
+    }
+
+  if (l->last_rel_thread >= 0 && l->last_rel_thread != id && start < l->last_rel)
+    {
+      l->n_handoff++;
+      l->handoff_sum += e->tsc - l->last_rel;
+      if (++l->chain > l->max_chain)
+	{
+	  l->max_chain = l->chain;
+	}
+      GROW(t->edges, t->n_edges, t->size_edges);
+      tr_edge_t* ed = t->edges + t->n_edges++;
+      ed->tsc = e->tsc;
+      ed->from_tsc = l->last_rel;
+      ed->from = (uint32_t) l->last_rel_thread;
+      ed->lock = li;
+    }
+  else
+    {
+      l->chain = 0;
+    }
+
+  if (l->cv_start != 0)
+    {
+      l->cv_acq++;
+    }
+
+  if (t->n_held < LOCKIN_TRACE_MAX_HELD)
+    {
+      t->held[t->n_held].lock = li;
+      t->held[t->n_held].acquired = e->tsc;
+      t->n_held++;
+    }
+}
+
+static void
+tr_released(tr_thread_t* t, const uint32_t id, tr_lock_t* l, const tr_ev_t* e,
+	    const uint64_t long_hold)
+{
+  const uint32_t li = (uint32_t) (l - locks);
+  int h;
+  for (h = (int) t->n_held - 1; h >= 0; h--)
+    {
+      if (t->held[h].lock == li)
+	{
+	  break;
+	}
+    }
+  l->last_rel_thread = id;
+  l->last_rel = e->tsc;
+  if (h < 0)
+    {
+      return;			/* acquired before the trace (or dropped) */
+    }
+
+  const uint64_t hold = e->tsc - t->held[h].acquired;
+  l->hold_sum += hold;
+  if (hold > l->hold_max)
+    {
+      l->hold_max = hold;
+    }
+  l->n_long += (hold > long_hold);
+  if (hold > t->max_hold)
+    {
+      t->max_hold = hold;
+    }
+  GROW(t->holds, t->n_holds, t->size_holds);
+  tr_hold_t* r = t->holds + t->n_holds++;
+  r->lock = li;
+  r->acquired = t->held[h].acquired;
+  r->released = e->tsc;
+
+  uint32_t i;
+  for (i = h + 1; i < t->n_held; i++)
+    {
+      t->held[i - 1] = t->held[i];
+    }
+  t->n_held--;
+}
+
+static void
+tr_replay(const tr_ev_t* evs, const size_t n, const uint32_t min_waiters,
+	  const uint64_t min_acq, const uint64_t long_hold)
+{
+  size_t i;
+  for (i = 0; i < n; i++)
+    {
+      const tr_ev_t* e = evs + i;
+      tr_thread_t* t = tr_thread(e->thread);
+      if (t->first == 0)
+	{
+	  t->first = e->tsc;
+	}
+      t->last = e->tsc;
+      const uint32_t li = tr_lock(LOCK_IN_TRACE_EV_LOCK(e->word)); /* might move locks */
+      tr_lock_t* l = locks + li;
+
+      switch (LOCK_IN_TRACE_EV_TYPE(e->word))
+	{
+	case LOCK_IN_TRACE_ACQ_START:
+	  if (t->start != 0)	/* the acquired event was dropped */
+	    {
+	      locks[t->start_lock].waiters--;
+	    }
+	  t->start = e->tsc;
+	  t->start_lock = li;
+	  if (++l->waiters > l->max_waiters)
+	    {
+	      l->max_waiters = l->waiters;
+	    }
+	  if (l->cv_start == 0 && l->waiters >= min_waiters)
+	    {
+	      l->cv_start = e->tsc;
+	      l->cv_acq = 0;
+	      l->cv_max = 0;
+	    }
+	  if (l->waiters > l->cv_max)
+	    {
+	      l->cv_max = l->waiters;
+	    }
+	  break;
+	case LOCK_IN_TRACE_ACQUIRED:
+	  tr_acquired(t, e->thread, l, e, LOCK_IN_TRACE_EV_ARG(e->word) == 1);
+	  if (l->cv_start != 0 && l->waiters < min_waiters)
+	    {
+	      tr_convoy_end(l, e->tsc, min_acq);
+	    }
+	  break;
+	case LOCK_IN_TRACE_ACQ_TIMEOUT:
+	  if (t->start != 0 && t->start_lock == li)
+	    {
+	      l->waiters--;
+	      t->start = 0;
+	    }
+	  l->n_timeout++;
+	  if (l->cv_start != 0 && l->waiters < min_waiters)
+	    {
+	      tr_convoy_end(l, e->tsc, min_acq);
+	    }
+	  break;
+	case LOCK_IN_TRACE_RELEASE:
+	  tr_released(t, e->thread, l, e, long_hold);
+	  break;
+	case LOCK_IN_TRACE_FUTEX_WAIT:
+	  l->n_futex_wait++;
+	  break;
+	case LOCK_IN_TRACE_FUTEX_WAKE:
+	  l->n_futex_wake++;
+	  break;
+	case LOCK_IN_TRACE_MODE:
+	  l->n_mode++;
+	  break;
+	}
+    }
+
+  uint32_t j;
+  for (j = 0; j < n_locks; j++)
+    {
+      tr_convoy_end(locks + j, (n > 0) ? evs[n - 1].tsc : 0, min_acq);
+    }
+}
+
+/* credits the holds of thread t that overlap [from, to] to their locks */
+static uint64_t
+tr_credit_holds(const tr_thread_t* t, const uint64_t from, const uint64_t to)
+{
+  /* the holds are sorted by release time */
+  size_t lo = 0, hi = t->n_holds;
+  while (lo < hi)
+    {
+      const size_t mid = (lo + hi) / 2;
+      if (t->holds[mid].released <= from)
+	{
+	  lo = mid + 1;
+	}
+      else
+	{
+	  hi = mid;
+	}
+    }
+  uint64_t sum = 0;
+  size_t i;
+  for (i = lo; i < t->n_holds && t->holds[i].released <= to + t->max_hold; i++)
+    {
+      const tr_hold_t* h = t->holds + i;
+      const uint64_t a = (h->acquired > from) ? h->acquired : from;
+      const uint64_t b = (h->released < to) ? h->released : to;
+      if (a < b)
+	{
+	  locks[h->lock].cp_hold += b - a;
+	  sum += b - a;
+	}
+    }
+  return sum;
+}
+
+/* the latest handoff edge of t at or before tsc, or NULL */
+static const tr_edge_t*
+tr_edge_before(const tr_thread_t* t, const uint64_t tsc)
+{
+  size_t lo = 0, hi = t->n_edges;
+  while (lo < hi)
+    {
+      const size_t mid = (lo + hi) / 2;
+      if (t->edges[mid].tsc <= tsc)
+	{
+	  lo = mid + 1;
+	}
+      else
+	{
+	  hi = mid;
+	}
+    }
+  return (lo == 0) ? NULL : t->edges + lo - 1;
+}
+
+static void
+tr_critical_path(uint64_t* length, uint64_t* hops, uint64_t* in_locks)
+{
+  *length = *hops = *in_locks = 0;
+  uint32_t cur = 0, i;
+  for (i = 1; i < n_threads; i++)
+    {
+      if (threads[i].last > threads[cur].last)
+	{
+	  cur = i;
+	}
+    }
+  if (n_threads == 0)
+    {
+      return;
+    }
+
+  uint64_t tsc = threads[cur].last;
+  while (1)
+    {
+      const tr_thread_t* t = threads + cur;
+      const tr_edge_t* e = tr_edge_before(t, tsc);
+      if (e == NULL)
+	{
+	  *in_locks += tr_credit_holds(t, t->first, tsc);
+	  *length += tsc - t->first;
+	  break;
+	}
+      *in_locks += tr_credit_holds(t, e->tsc, tsc);
+      locks[e->lock].cp_handoff += e->tsc - e->from_tsc;
+      *in_locks += e->tsc - e->from_tsc;
+      *length += tsc - e->from_tsc;
+      (*hops)++;
+      cur = e->from;
+      tsc = e->from_tsc;
+    }
+}
+
+static uint32_t
+tr_clamp(const uint64_t cycles)
+{
+  return (cycles > UINT32_MAX) ? UINT32_MAX : (uint32_t) cycles;
+}
+
+typedef struct tr_export_thread
+{
+  lock_in_replay_op_t* ops;
+  size_t n_ops, size_ops;
+  uint64_t prev;		/* end of the previous op */
+  uint64_t start;		/* of the pending acquire (0 if none) */
+  uint32_t n_held;
+  uint32_t held[LOCKIN_TRACE_MAX_HELD];
+} tr_export_thread_t;
+
+static lock_in_replay_op_t*
+tr_export_op(tr_export_thread_t* t, const uint32_t lock, const uint64_t delay, const uint64_t wait)
+{
+  GROW(t->ops, t->n_ops, t->size_ops);
+  lock_in_replay_op_t* op = t->ops + t->n_ops++;
+  op->lock = lock;
+  op->delay = tr_clamp(delay);
+  op->wait = tr_clamp(wait);
+  return op;
+}
+
+/* writes the lock/unlock operations of every thread in the replay format
+   (the lock ids are the indices in locks, before any sorting) */
+static void
+tr_export(const char* path, const lock_in_trace_hdr_t* hdr, const tr_ev_t* evs, const size_t n)
+{
+  tr_export_thread_t* ts = calloc(n_threads, sizeof(tr_export_thread_t));
+  assert(ts != NULL);
+  uint32_t i;
+  for (i = 0; i < n_threads; i++)
+    {
+      ts[i].prev = (n > 0) ? evs[0].tsc : 0;
+    }
+
+  size_t k;
+  for (k = 0; k < n; k++)
+    {
+      const tr_ev_t* e = evs + k;
+      tr_export_thread_t* t = ts + e->thread;
+      const uint32_t li = tr_lock(LOCK_IN_TRACE_EV_LOCK(e->word));
+      int h;
+      switch (LOCK_IN_TRACE_EV_TYPE(e->word))
+	{
+	case LOCK_IN_TRACE_ACQ_START:
+	  t->start = e->tsc;
+	  break;
+	case LOCK_IN_TRACE_ACQ_TIMEOUT:
+	  t->start = 0;		/* the wait becomes think time */
+	  break;
+	case LOCK_IN_TRACE_ACQUIRED:
+	  if (t->n_held == LOCKIN_TRACE_MAX_HELD)
+	    {
+	      break;
+	    }
+	  if (t->start == 0 || t->start < t->prev)
+	    {
+	      t->start = t->prev;	/* trylock or condition wait */
+	    }
+	  tr_export_op(t, li, t->start - t->prev, e->tsc - t->start);
+	  t->held[t->n_held++] = li;
+	  t->prev = e->tsc;
+	  t->start = 0;
+	  break;
+	case LOCK_IN_TRACE_RELEASE:
+	  for (h = (int) t->n_held - 1; h >= 0 && t->held[h] != li; h--)
+	    ;
+	  if (h < 0)
+	    {
+	      break;		/* acquired before the trace */
+	    }
+	  for (; h + 1 < (int) t->n_held; h++)
+	    {
+	      t->held[h] = t->held[h + 1];
+	    }
+	  t->n_held--;
+	  tr_export_op(t, li | LOCK_IN_REPLAY_UNLOCK, e->tsc - t->prev, 0);
+	  t->prev = e->tsc;
+	  break;
+	}
+    }
+
+  lock_in_replay_hdr_t rh;
+  memset(&rh, 0, sizeof(rh));
+  rh.magic = LOCK_IN_REPLAY_MAGIC;
+  rh.version = LOCK_IN_REPLAY_VERSION;
+  rh.n_locks = n_locks;
+  rh.span = (n > 0) ? evs[n - 1].tsc - evs[0].tsc : 0;
+  rh.cycles_per_us = hdr->cycles_per_us;
+  memcpy(rh.algo, hdr->algo, sizeof(rh.algo));
+  for (i = 0; i < n_threads; i++)
+    {
+      tr_export_thread_t* t = ts + i;
+      while (t->n_held > 0)	/* still held at the end of the trace */
+	{
+	  tr_export_op(t, t->held[--t->n_held] | LOCK_IN_REPLAY_UNLOCK, 0, 0);
+	}
+      rh.n_threads += (t->n_ops > 0);
+      rh.n_ops += t->n_ops;
+    }
+
+  FILE* f = fopen(path, "w");
+  if (f == NULL)
+    {
+      perror(path);
+      exit(1);
+    }
+  fwrite(&rh, sizeof(rh), 1, f);
+  for (i = 0; i < n_threads; i++)
+    {
+      tr_export_thread_t* t = ts + i;
+      if (t->n_ops > 0)
+	{
+	  lock_in_replay_thread_t th = { .thread = i, .n_ops = (uint32_t) t->n_ops };
+	  fwrite(&th, sizeof(th), 1, f);
+	  fwrite(t->ops, sizeof(lock_in_replay_op_t), t->n_ops, f);
+	}
+      free(t->ops);
+    }
+  if (fclose(f) != 0)
+    {
+      perror(path);
+      exit(1);
+    }
+  free(ts);
+  printf("# exported %llu ops of %u threads on %u locks to %s\n",
+	 (unsigned long long) rh.n_ops, rh.n_threads, rh.n_locks, path);
+}
+
+static int
+tr_comp_util(const void* a, const void* b)
+{
+  const tr_lock_t* x = (const tr_lock_t*) a;
+  const tr_lock_t* y = (const tr_lock_t*) b;
+  if (x->hold_sum != y->hold_sum)
+    {
+      return (x->hold_sum < y->hold_sum) ? 1 : -1;
+    }
+  return (x->n_acq < y->n_acq) ? 1 : (x->n_acq > y->n_acq) ? -1 : 0;
+}
+
+static int
+tr_comp_convoy(const void* a, const void* b)
+{
+  const tr_convoy_t* x = (const tr_convoy_t*) a;
+  const tr_convoy_t* y = (const tr_convoy_t*) b;
+  return (x->duration < y->duration) ? 1 : (x->duration > y->duration) ? -1 : 0;
+}
+
+static int
+tr_comp_cp(const void* a, const void* b)
+{
+  const tr_lock_t* x = (const tr_lock_t*) a;
+  const tr_lock_t* y = (const tr_lock_t*) b;
+  const uint64_t cx = x->cp_hold + x->cp_handoff, cy = y->cp_hold + y->cp_handoff;
+  return (cx < cy) ? 1 : (cx > cy) ? -1 : 0;
+}
+
+int
+main(int argc, char** argv)
+{
+  uint32_t min_waiters = LOCKIN_TRACE_WAITERS;
+  uint64_t min_acq = LOCKIN_TRACE_MIN_ACQ;
+  double long_us = LOCKIN_TRACE_LONG_US;
+  int top = LOCKIN_TRACE_TOP, c;
+  const char* export = NULL;
+  while ((c = getopt(argc, argv, "hk:m:l:t:o:")) != -1)
+    {
+      switch (c)
+	{
+	case 'k':
+	  min_waiters = atoi(optarg);
+	  break;
+	case 'm':
+	  min_acq = atol(optarg);
+	  break;
+	case 'l':
+	  long_us = atof(optarg);
+	  break;
+	case 't':
+	  top = atoi(optarg);
+	  break;
+	case 'o':
+	  export = optarg;
+	  break;
+	default:
+	  printf("Usage:\n"
+		 "  lockin-trace [options...] TRACE\n"
+		 "\n"
+		 "Options:\n"
+		 "  -k <int>    convoy: at least k waiters (default=%d)\n"
+		 "  -m <int>    convoy: for at least m acquisitions (default=%d)\n"
+		 "  -l <us>     holds longer than that are long (default=%d)\n"
+		 "  -t <int>    print the top-t locks and convoys (default=%d)\n"
+		 "  -o <file>   export the trace for stress_replay_in\n",
+		 LOCKIN_TRACE_WAITERS, LOCKIN_TRACE_MIN_ACQ, LOCKIN_TRACE_LONG_US,
+		 LOCKIN_TRACE_TOP);
+	  exit(c != 'h');
+	}
+    }
+  if (optind >= argc)
+    {
+      fprintf(stderr, "no trace file (use -h for help)\n");
+      exit(1);
+    }
+  if (min_waiters < 1)
+    {
+      min_waiters = 1;
+    }
+
+  lock_in_trace_hdr_t hdr;
+  size_t n;
+  tr_ev_t* evs = tr_read(argv[optind], &hdr, &n);
+  const double cpu = hdr.cycles_per_us;
+  tr_replay(evs, n, min_waiters, min_acq, (uint64_t) (long_us * cpu));
+
+  const uint64_t span = (n > 0) ? evs[n - 1].tsc - evs[0].tsc : 0;
+  uint64_t dropped = 0;
+  uint32_t i;
+  for (i = 0; i < n_threads; i++)
+    {
+      dropped += threads[i].n_dropped;
+    }
+  uint64_t cp_length, cp_hops, cp_in_locks;
+  tr_critical_path(&cp_length, &cp_hops, &cp_in_locks);
+
+  printf("## trace %s : %s : pid %u : %u threads : %zu events (%llu dropped) : %.3f ms : %.0f cycles/us\n",
+	 argv[optind], hdr.algo, hdr.pid, n_threads, n, (unsigned long long) dropped,
+	 span / cpu / 1000, cpu);
+  if (dropped > 0)
+    {
+      printf("# warning: events were dropped (full rings); the results are approximate\n");
+    }
+
+  if (export != NULL)
+    {
+      tr_export(export, &hdr, evs, n);
+    }
+
+  qsort(locks, n_locks, sizeof(tr_lock_t), tr_comp_util);
+
+  printf("#per lock (times in us)\n");
+  printf("#%-17s %10s %7s %9s %9s %9s %9s %9s %6s %6s %8s %8s %6s %6s %8s\n",
+	 "lock", "acquires", "util%", "wait-avg", "wait-max", "hold-avg", "hold-max",
+	 "handoffs", "chain", "queue", "fu-wait", "fu-wake", "modesw", "long", "timeouts");
+  int shown = 0;
+  for (i = 0; i < n_locks && shown < top; i++)
+    {
+      const tr_lock_t* l = locks + i;
+      if (l->n_acq == 0)
+	{
+	  continue;		/* e.g., the futex word of a condition variable */
+	}
+      shown++;
+      printf("%#-18llx %10llu %6.2f%% %9.2f %9.2f %9.2f %9.2f %9llu %6u %6u %8llu %8llu %6llu %6llu %8llu\n",
+	     (unsigned long long) l->addr, (unsigned long long) l->n_acq,
+	     (span > 0) ? 100.0 * l->hold_sum / span : 0,
+	     l->wait_sum / cpu / l->n_acq, l->wait_max / cpu,
+	     l->hold_sum / cpu / l->n_acq, l->hold_max / cpu,
+	     (unsigned long long) l->n_handoff, l->max_chain, l->max_waiters,
+	     (unsigned long long) l->n_futex_wait, (unsigned long long) l->n_futex_wake,
+	     (unsigned long long) l->n_mode, (unsigned long long) l->n_long,
+	     (unsigned long long) l->n_timeout);
+    }
+
+  printf("#convoys (>= %u waiters for >= %llu acquisitions)\n", min_waiters,
+	 (unsigned long long) min_acq);
+  printf("#%-17s %9s %7s %12s %12s %8s\n", "lock", "episodes", "time%", "longest(us)",
+	 "longest(acq)", "waiters");
+  for (i = 0; i < n_locks; i++)
+    {
+      const tr_lock_t* l = locks + i;
+      if (l->n_convoys == 0)
+	{
+	  continue;
+	}
+      printf("%#-18llx %9llu %6.2f%% %12.2f %12llu %8u\n",
+	     (unsigned long long) l->addr, (unsigned long long) l->n_convoys,
+	     (span > 0) ? 100.0 * l->convoy_time / span : 0,
+	     l->longest.duration / cpu, (unsigned long long) l->longest.n_acq,
+	     l->longest.max_waiters);
+    }
+  qsort(convoys, n_convoys, sizeof(tr_convoy_t), tr_comp_convoy);
+  printf("#top convoy episodes (%zu in total)\n", n_convoys);
+  printf("#%-17s %10s %12s %12s %8s\n", "lock", "start(ms)", "duration(us)", "acquires", "waiters");
+  size_t k;
+  for (k = 0; k < n_convoys && k < (size_t) top; k++)
+    {
+      const tr_convoy_t* cv = convoys + k;
+      printf("%#-18llx %10.3f %12.2f %12llu %8u\n", (unsigned long long) cv->lock,
+	     (cv->start - evs[0].tsc) / cpu / 1000,
+	     cv->duration / cpu, (unsigned long long) cv->n_acq, cv->max_waiters);
+    }
+
+  printf("#critical path : %.3f ms : %llu handoffs : %.2f%% in locks (holds + handoffs) : %.2f%% outside locks\n",
+	 cp_length / cpu / 1000, (unsigned long long) cp_hops,
+	 (cp_length > 0) ? 100.0 * cp_in_locks / cp_length : 0,
+	 (cp_length > 0) ? 100.0 * (cp_length - (cp_in_locks < cp_length ? cp_in_locks : cp_length)) / cp_length : 0);
+  qsort(locks, n_locks, sizeof(tr_lock_t), tr_comp_cp);
+  printf("#%-17s %9s %9s\n", "lock", "hold%", "handoff%");
+  for (i = 0; i < n_locks && i < (uint32_t) top; i++)
+    {
+      const tr_lock_t* l = locks + i;
+      if (l->cp_hold + l->cp_handoff == 0)
+	{
+	  break;
+	}
+      printf("%#-18llx %8.2f%% %8.2f%%\n", (unsigned long long) l->addr,
+	     100.0 * l->cp_hold / cp_length, 100.0 * l->cp_handoff / cp_length);
+    }
+
+  free(evs);
+  return 0;
+}
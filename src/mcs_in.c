@@ -73,7 +73,7 @@ mcs_get_local(mcs_lock_t* lock)
   return lock->local[__mcs_id];
 }
 
-inline int
+int
 mcs_lock_trylock(mcs_lock_t* lock) 
 {
   if (lock->next != NULL)
@@ -86,7 +86,7 @@ mcs_lock_trylock(mcs_lock_t* lock)
   return __sync_val_compare_and_swap(&lock->next, NULL, local) != NULL;
 }
 
-inline int
+int
 mcs_lock_lock(mcs_lock_t* lock) 
 {
   volatile mcs_lock_t* local = mcs_get_local(lock);
@@ -108,7 +108,7 @@ mcs_lock_lock(mcs_lock_t* lock)
 }
 
 
-inline int
+int
 mcs_lock_unlock(mcs_lock_t* lock) 
 {
   volatile mcs_lock_t* local = lock->local[__mcs_id];
@@ -0,0 +1,234 @@
+/*
+ * File: mutexee_owner.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      On-cpu sampler for the owners of MUTEXEE-OWNER locks (see mutexee_owner.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "mutexee_owner.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <sched.h>
+
+mutexee_owner_rec_t mutexee_owner_recs[MUTEXEE_OWNER_MAX_THREADS];
+__thread uint32_t mutexee_owner_id = 0;
+static __thread int mutexee_owner_full = 0;
+
+static volatile uint32_t mutexee_owner_n = 0; /* high-water mark of used recs */
+static volatile int mutexee_owner_initialized = 0;
+static pthread_key_t mutexee_owner_key;
+
+volatile uint32_t mutexee_owner_demand = 0;
+static volatile uint32_t mutexee_owner_running = 0;
+
+static inline uint64_t
+mutexee_owner_cpu_ns(clockid_t clock)
+{
+  struct timespec ts;
+  if (clock_gettime(clock, &ts) != 0)
+    {
+      return 0;
+    }
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/* the cpu time of the registered threads at the start of a period */
+static void
+mutexee_owner_snapshot()
+{
+  const uint32_t n = mutexee_owner_n;
+  uint32_t i;
+  for (i = 0; i < n; i++)
+    {
+      mutexee_owner_rec_t* r = mutexee_owner_recs + i;
+      if (r->in_use == 2)
+	{
+	  r->cpu_ns = mutexee_owner_cpu_ns(r->clock);
+	}
+    }
+}
+
+static void*
+mutexee_owner_sampler(void* arg)
+{
+  (void) arg;
+  const uint64_t period_ns = MUTEXEE_OWNER_SAMPLE_US * 1000ULL;
+  const uint64_t on_cpu_ns = period_ns >> MUTEXEE_OWNER_ON_CPU_SHIFT;
+  struct timespec timeout = { .tv_sec = 0, .tv_nsec = period_ns };
+
+  /* unpin the thread */
+  cpu_set_t mask;
+  CPU_ZERO(&mask);
+  int c;
+  for (c = 0; c < CPU_SETSIZE; c++)
+    {
+      CPU_SET(c, &mask);
+    }
+  sched_setaffinity(0, sizeof(cpu_set_t), &mask);
+
+  mutexee_owner_snapshot();
+  uint32_t idle = 0;
+  while (1)
+    {
+      nanosleep(&timeout, NULL);
+      const uint32_t n = mutexee_owner_n;
+      uint32_t i;
+
+      if (mutexee_owner_demand)
+	{
+	  mutexee_owner_demand = 0;
+	  idle = 0;
+	}
+      else if (++idle >= MUTEXEE_OWNER_IDLE_PERIODS)
+	{
+	  /* nobody spins: every owner counts as on cpu until the next start */
+	  for (i = 0; i < n; i++)
+	    {
+	      mutexee_owner_recs[i].on_cpu = 1;
+	    }
+	  mutexee_owner_running = 0;
+	  __sync_synchronize();
+	  if (!mutexee_owner_demand
+	      || __sync_val_compare_and_swap(&mutexee_owner_running, 0, 1) != 0)
+	    {
+	      break;
+	    }
+	  mutexee_owner_snapshot();
+	  idle = 0;
+	  continue;
+	}
+
+      for (i = 0; i < n; i++)
+	{
+	  mutexee_owner_rec_t* r = mutexee_owner_recs + i;
+	  if (r->in_use != 2)
+	    {
+	      continue;
+	    }
+	  const uint64_t ns = mutexee_owner_cpu_ns(r->clock);
+	  const uint32_t on_cpu = (ns != 0) && ((ns - r->cpu_ns) > on_cpu_ns);
+	  r->cpu_ns = ns;
+	  if (r->on_cpu != on_cpu)
+	    {
+	      r->on_cpu = on_cpu;
+	    }
+	}
+    }
+  return NULL;
+}
+
+void
+mutexee_owner_want(void)
+{
+  mutexee_owner_demand = 1;
+  __sync_synchronize();
+  if (mutexee_owner_running
+      || __sync_val_compare_and_swap(&mutexee_owner_running, 0, 1) != 0)
+    {
+      return;
+    }
+
+  pthread_t thread;
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setdetachstate(&attr, PTHREAD_CREATE_DETACHED);
+  if (pthread_create(&thread, &attr, mutexee_owner_sampler, NULL) != 0)
+    {
+      fprintf(stderr, "Error creating thread\n");
+      exit(1);
+    }
+  pthread_attr_destroy(&attr);
+}
+
+static void
+mutexee_owner_unregister(void* rec)
+{
+  mutexee_owner_rec_t* r = (mutexee_owner_rec_t*) rec;
+  r->on_cpu = 0;
+  r->in_use = 0;
+}
+
+static void
+mutexee_owner_init()
+{
+  static volatile int initializing = 0;
+  if (__sync_val_compare_and_swap(&initializing, 0, 1) == 1)
+    {
+      while (!mutexee_owner_initialized)
+	{
+	  sched_yield();
+	}
+      return;
+    }
+
+  pthread_key_create(&mutexee_owner_key, mutexee_owner_unregister);
+  mutexee_owner_initialized = 1;
+}
+
+uint32_t
+mutexee_owner_register(void)
+{
+  if (__builtin_expect(!mutexee_owner_initialized, 0))
+    {
+      mutexee_owner_init();
+    }
+
+  if (mutexee_owner_full)
+    {
+      return 0;
+    }
+
+  uint32_t i;
+  for (i = 0; i < MUTEXEE_OWNER_MAX_THREADS; i++)
+    {
+      mutexee_owner_rec_t* r = mutexee_owner_recs + i;
+      if (!r->in_use && __sync_val_compare_and_swap(&r->in_use, 0, 1) == 0)
+	{
+	  if (pthread_getcpuclockid(pthread_self(), &r->clock) != 0)
+	    {
+	      r->in_use = 0;
+	      break;
+	    }
+	  r->cpu_ns = mutexee_owner_cpu_ns(r->clock);
+	  r->on_cpu = 1;
+
+	  uint32_t n;
+	  while ((n = mutexee_owner_n) <= i)
+	    {
+	      __sync_val_compare_and_swap(&mutexee_owner_n, n, i + 1);
+	    }
+
+	  pthread_setspecific(mutexee_owner_key, r);
+	  r->in_use = 2;
+	  mutexee_owner_id = i + 1;
+	  return i + 1;
+	}
+    }
+
+  /* not tracked: waiters will always spin on the locks of this thread */
+  mutexee_owner_full = 1;
+  return 0;
+}
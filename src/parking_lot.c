@@ -0,0 +1,279 @@
+/*
+ * File: parking_lot.c
+ * Author: Vasileios Trigonakis <vasileios.trigonakis@epfl.ch>
+ *
+ * Description: 
+ *      The process-wide parking lot (see parking_lot.h).
+ *
+ * The MIT License (MIT)
+ *
+ * Copyright (c) 2016 Vasileios Trigonakis
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include "parking_lot.h"
+#include <errno.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+#define PARKING_LOT_CACHE_LINE_SIZE 64
+
+typedef struct parking_lot_thread
+{
+  volatile int parked;		/* the futex word: 1 while parked */
+  const void* addr;
+  struct parking_lot_thread* next;
+} parking_lot_thread_t;
+
+typedef struct parking_lot_bucket
+{
+  volatile uint8_t lock;
+  parking_lot_thread_t* head;
+  parking_lot_thread_t* tail;
+  uint8_t padding[PARKING_LOT_CACHE_LINE_SIZE - 3 * sizeof(void*)];
+} __attribute__((aligned(PARKING_LOT_CACHE_LINE_SIZE))) parking_lot_bucket_t;
+
+static parking_lot_bucket_t parking_lot_buckets[PARKING_LOT_BUCKETS];
+static __thread parking_lot_thread_t parking_lot_me;
+
+__thread size_t parking_lot_n_futex_wait = 0;
+__thread size_t parking_lot_n_futex_wake = 0;
+
+static inline parking_lot_bucket_t*
+parking_lot_bucket(const void* addr)
+{
+  uint64_t x = (uintptr_t) addr;
+  x ^= x >> 33;
+  x *= 0xff51afd7ed558ccdULL;
+  x ^= x >> 33;
+  return parking_lot_buckets + (x & (PARKING_LOT_BUCKETS - 1));
+}
+
+static inline void
+parking_lot_bucket_lock(parking_lot_bucket_t* b)
+{
+  while (__sync_lock_test_and_set(&b->lock, 1))
+    {
+      while (b->lock)
+	{
+	  asm volatile ("pause");
+	}
+    }
+}
+
+static inline void
+parking_lot_bucket_unlock(parking_lot_bucket_t* b)
+{
+  __sync_lock_release(&b->lock);
+}
+
+/* remove t (whose predecessor is prev) from the queue of b */
+static inline void
+parking_lot_dequeue(parking_lot_bucket_t* b, parking_lot_thread_t* prev, parking_lot_thread_t* t)
+{
+  if (prev == NULL)
+    {
+      b->head = t->next;
+    }
+  else
+    {
+      prev->next = t->next;
+    }
+  if (b->tail == t)
+    {
+      b->tail = prev;
+    }
+}
+
+static inline int
+parking_lot_futex(volatile int* addr, int op, int val, const struct timespec* timeout)
+{
+  if (op == FUTEX_WAIT_PRIVATE)
+    {
+      parking_lot_n_futex_wait++;
+    }
+  else
+    {
+      parking_lot_n_futex_wake++;
+    }
+  return syscall(SYS_futex, addr, op, val, timeout, NULL, 0);
+}
+
+int
+parking_lot_park(const void* addr, 
+		 parking_lot_validate_t validate, void* validate_arg,
+		 parking_lot_before_sleep_t before_sleep, void* before_sleep_arg,
+		 const struct timespec* timeout)
+{
+  parking_lot_thread_t* me = &parking_lot_me;
+  parking_lot_bucket_t* b = parking_lot_bucket(addr);
+
+  parking_lot_bucket_lock(b);
+  if (validate != NULL && !validate(addr, validate_arg))
+    {
+      parking_lot_bucket_unlock(b);
+      return 0;
+    }
+
+  me->addr = addr;
+  me->next = NULL;
+  me->parked = 1;
+  if (b->tail == NULL)
+    {
+      b->head = me;
+    }
+  else
+    {
+      b->tail->next = me;
+    }
+  b->tail = me;
+  parking_lot_bucket_unlock(b);
+
+  if (before_sleep != NULL)
+    {
+      before_sleep(before_sleep_arg);
+    }
+
+  while (me->parked)
+    {
+      int ret = parking_lot_futex(&me->parked, FUTEX_WAIT_PRIVATE, 1, timeout);
+      if (ret == -1 && errno == ETIMEDOUT)
+	{
+	  break;
+	}
+    }
+
+  if (me->parked)
+    {
+      /* timed out: leave the queue, unless an unparker already removed us */
+      parking_lot_bucket_lock(b);
+      parking_lot_thread_t* prev = NULL, * t = b->head;
+      while (t != NULL && t != me)
+	{
+	  prev = t;
+	  t = t->next;
+	}
+      if (t == me)
+	{
+	  parking_lot_dequeue(b, prev, me);
+	  parking_lot_bucket_unlock(b);
+	  me->parked = 0;
+	  return -1;
+	}
+      parking_lot_bucket_unlock(b);
+
+      while (me->parked)
+	{
+	  parking_lot_futex(&me->parked, FUTEX_WAIT_PRIVATE, 1, NULL);
+	}
+    }
+
+  return 1;
+}
+
+static inline void
+parking_lot_wake(parking_lot_thread_t* t)
+{
+  t->parked = 0;
+  parking_lot_futex(&t->parked, FUTEX_WAKE_PRIVATE, 1, NULL);
+}
+
+int
+parking_lot_unpark_one(const void* addr, parking_lot_callback_t callback, void* arg)
+{
+  parking_lot_bucket_t* b = parking_lot_bucket(addr);
+
+  parking_lot_bucket_lock(b);
+  parking_lot_thread_t* prev = NULL, * t = b->head;
+  while (t != NULL && t->addr != addr)
+    {
+      prev = t;
+      t = t->next;
+    }
+
+  int have_more = 0;
+  if (t != NULL)
+    {
+      parking_lot_dequeue(b, prev, t);
+      parking_lot_thread_t* o;
+      for (o = t->next; o != NULL; o = o->next)
+	{
+	  if (o->addr == addr)
+	    {
+	      have_more = 1;
+	      break;
+	    }
+	}
+    }
+
+  if (callback != NULL)
+    {
+      callback(addr, (t != NULL), have_more, arg);
+    }
+  parking_lot_bucket_unlock(b);
+
+  if (t != NULL)
+    {
+      parking_lot_wake(t);
+      return 1;
+    }
+  return 0;
+}
+
+int
+parking_lot_unpark_all(const void* addr, parking_lot_callback_t callback, void* arg)
+{
+  parking_lot_bucket_t* b = parking_lot_bucket(addr);
+  parking_lot_thread_t* woken = NULL;
+  int n = 0;
+
+  parking_lot_bucket_lock(b);
+  parking_lot_thread_t* prev = NULL, * t = b->head;
+  while (t != NULL)
+    {
+      parking_lot_thread_t* next = t->next;
+      if (t->addr == addr)
+	{
+	  parking_lot_dequeue(b, prev, t);
+	  t->next = woken;
+	  woken = t;
+	  n++;
+	}
+      else
+	{
+	  prev = t;
+	}
+      t = next;
+    }
+
+  if (callback != NULL)
+    {
+      callback(addr, n, 0, arg);
+    }
+  parking_lot_bucket_unlock(b);
+
+  while (woken != NULL)
+    {
+      parking_lot_thread_t* next = woken->next;
+      parking_lot_wake(woken);
+      woken = next;
+    }
+  return n;
+}